@@ -0,0 +1,291 @@
+#ifndef __LOGS_ASYNC_SINK_H__
+#define __LOGS_ASYNC_SINK_H__
+
+/*
+ * async_sink.hpp 带独立队列与工作线程的落地方向
+ * 1. AsyncSink<SinkType> 包装任意落地方向，构造参数转发给被包装的落地方向：
+ *    SinkFactory::create<AsyncSink<FileSink>>("./logs/app.log")
+ *    SinkFactory::create<AsyncSink<StdoutSink>>(AsyncSinkPolicy::dropNewest(1024 * 1024))
+ * 2. 日志先写入有界的双缓冲队列（AsyncLooper），由该落地方向自己的线程批量写出并刷新；
+ *    一个落地方向变慢（终端、管道阻塞）只会让它自己的队列变满，不会拖慢同一日志器的其他落地方向
+ * 3. 队列满时的策略（AsyncSinkPolicy）：
+ *    BLOCK 阻塞等待；DROP_NEWEST 丢弃新的日志；DROP_BELOW_LEVEL 低于指定等级的日志被丢弃，其余阻塞等待；
+ *    SPILL 写入磁盘上的溢出文件，队列清空后由工作线程按顺序读回写出（溢出期间的日志都进入溢出文件，顺序不变）
+ * 4. 丢弃条数、溢出字节数与队列中的字节数（不含溢出文件）记录在统计中（stats()），被包装的落地方向的统计通过 inner().stats() 获取
+ * 5. flush() 不等待队列，工作线程在每批数据写出后刷新被包装的落地方向；析构时队列与溢出文件中的日志全部写出
+*/
+
+#include "sink.hpp"
+#include "looper.hpp"
+#include <string>
+#include <memory>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace cpplogs
+{
+    enum class OverflowPolicy
+    {
+        BLOCK,//阻塞等待
+        DROP_NEWEST,//丢弃新的日志
+        DROP_BELOW_LEVEL,//丢弃低于指定等级的日志，其余阻塞等待
+        SPILL//写入溢出文件
+    };
+
+    struct AsyncSinkPolicy
+    {
+        AsyncSinkPolicy(cpplogs::OverflowPolicy overflow_ = cpplogs::OverflowPolicy::BLOCK,
+            size_t buffer_size_ = DEFAULT_BUFFER_SIZE,
+            cpplogs::LogLevel::value level_ = cpplogs::LogLevel::value::WARN,
+            const std::string& spill_path_ = "",
+            size_t spill_limit_ = 1024 * 1024 * 1024)
+        : overflow(overflow_)
+        , buffer_size(buffer_size_)
+        , level(level_)
+        , spill_path(spill_path_)
+        , spill_limit(spill_limit_)
+        {}
+        static AsyncSinkPolicy block(size_t buffer_size = DEFAULT_BUFFER_SIZE)
+        {
+            return AsyncSinkPolicy(cpplogs::OverflowPolicy::BLOCK, buffer_size);
+        }
+        static AsyncSinkPolicy dropNewest(size_t buffer_size = DEFAULT_BUFFER_SIZE)
+        {
+            return AsyncSinkPolicy(cpplogs::OverflowPolicy::DROP_NEWEST, buffer_size);
+        }
+        static AsyncSinkPolicy dropBelow(cpplogs::LogLevel::value level, size_t buffer_size = DEFAULT_BUFFER_SIZE)
+        {
+            return AsyncSinkPolicy(cpplogs::OverflowPolicy::DROP_BELOW_LEVEL, buffer_size, level);
+        }
+        static AsyncSinkPolicy spill(const std::string& spill_path, size_t buffer_size = DEFAULT_BUFFER_SIZE, size_t spill_limit = 1024 * 1024 * 1024)
+        {
+            return AsyncSinkPolicy(cpplogs::OverflowPolicy::SPILL, buffer_size, cpplogs::LogLevel::value::UNKNOW, spill_path, spill_limit);
+        }
+
+        cpplogs::OverflowPolicy overflow;
+        size_t buffer_size;//队列（每个缓冲区）的大小
+        cpplogs::LogLevel::value level;//DROP_BELOW_LEVEL：不低于该等级的日志不会被丢弃
+        std::string spill_path;//SPILL：溢出文件
+        size_t spill_limit;//SPILL：溢出文件的最大长度，超过后丢弃
+    };
+
+    namespace detail
+    {
+        //第一个参数是否为 AsyncSinkPolicy
+        template<typename ...Args>
+        struct FirstIsPolicy : std::false_type {};
+        template<typename First, typename ...Rest>
+        struct FirstIsPolicy<First, Rest...> : std::is_same<typename std::decay<First>::type, cpplogs::AsyncSinkPolicy> {};
+    }
+
+    template<typename SinkType>
+    class AsyncSink : public LogSink
+    {
+    public:
+        //使用默认策略（BLOCK）
+        template<typename ...Args, typename = typename std::enable_if<!cpplogs::detail::FirstIsPolicy<Args...>::value>::type>
+        AsyncSink(Args&& ...args)
+        : AsyncSink(cpplogs::AsyncSinkPolicy(), std::forward<Args>(args)...)
+        {}
+        template<typename ...Args>
+        AsyncSink(const cpplogs::AsyncSinkPolicy& policy, Args&& ...args)
+        : _policy(policy)
+        , _sink(std::make_shared<SinkType>(std::forward<Args>(args)...))
+        , _spill_fd(-1)
+        , _spilling(false)
+        , _spill_read(0)
+        , _spill_write(0)
+        , _spill_level(cpplogs::LogLevel::value::UNKNOW)
+        {
+            if(_policy.overflow == cpplogs::OverflowPolicy::SPILL)
+            {
+                cpplogs::util::File::createDirectory(cpplogs::util::File::path(_policy.spill_path));
+                _spill_fd = ::open(_policy.spill_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+                if(_spill_fd < 0)
+                {
+                    std::cerr << "[ERROR]cpplogs::AsyncSink::AsyncSink::open " << _policy.spill_path << ": " << strerror(errno) << std::endl;
+                }
+            }
+            _looper = std::make_shared<cpplogs::AsyncLooper>(std::bind(&AsyncSink::realLog, this, std::placeholders::_1),
+                cpplogs::AsyncType::ASYNC_BLOCK, _policy.buffer_size);
+        }
+        ~AsyncSink()
+        {
+            _looper->stop();
+            if(_spill_fd >= 0)
+            {
+                ::close(_spill_fd);
+                unlink(_policy.spill_path.c_str());
+            }
+        }
+
+        void log(const char* data, size_t len) override
+        {
+            log(data, len, cpplogs::LogLevel::value::UNKNOW);
+        }
+        void log(const char* data, size_t len, cpplogs::LogLevel::value level) override
+        {
+            switch(_policy.overflow)
+            {
+            case cpplogs::OverflowPolicy::BLOCK:
+                _looper->push(data, len, level);
+                break;
+            case cpplogs::OverflowPolicy::DROP_NEWEST:
+                if(!_looper->tryPush(data, len, level))
+                {
+                    _stats.onDrop();
+                }
+                break;
+            case cpplogs::OverflowPolicy::DROP_BELOW_LEVEL:
+                if(level >= _policy.level)
+                {
+                    _looper->push(data, len, level);
+                }
+                else if(!_looper->tryPush(data, len, level))
+                {
+                    _stats.onDrop();
+                }
+                break;
+            case cpplogs::OverflowPolicy::SPILL:
+                spill(data, len, level);
+                break;
+            }
+            _stats.setQueued(_looper->pending());
+        }
+        //不等待队列，避免调用者（如异步日志器的工作线程）被慢速的落地方向阻塞
+        void flush() override {}
+        std::string name() const override
+        {
+            return "async:" + _sink->name();
+        }
+
+        //被包装的落地方向
+        SinkType& inner()
+        {
+            return *_sink;
+        }
+
+    private:
+        //溢出期间的日志都写入溢出文件，保证顺序；调用者在 _spill_mutex 内判断，工作线程在同一锁内结束溢出
+        void spill(const char* data, size_t len, cpplogs::LogLevel::value level)
+        {
+            std::unique_lock<std::mutex> lock(_spill_mutex);
+            if(!_spilling && _looper->tryPush(data, len, level))
+            {
+                return;
+            }
+            if(_spill_fd < 0 || _spill_write + len > _policy.spill_limit || !writeAll(data, len))
+            {
+                _stats.onDrop();
+                return;
+            }
+            _spilling = true;
+            _spill_write += len;
+            if(level > _spill_level)
+            {
+                _spill_level = level;
+            }
+            _stats.onSpill(len);
+        }
+
+        bool writeAll(const char* data, size_t len)
+        {
+            while(len > 0)
+            {
+                ssize_t ret = ::write(_spill_fd, data, len);
+                if(ret < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if(ret <= 0)
+                {
+                    std::cerr << "[ERROR]cpplogs::AsyncSink::spill::write: " << strerror(errno) << std::endl;
+                    return false;
+                }
+                data += ret;
+                len -= ret;
+            }
+            return true;
+        }
+
+        //工作线程：写出一批数据；队列已空时读回溢出文件
+        void realLog(cpplogs::Buffer& buf)
+        {
+            //通过基类调用，被包装的类型只重写单条接口时也能传递等级
+            cpplogs::LogSink& sink = *_sink;
+            sink.log(buf.begin(), buf.readAbleSize(), _looper->batchLevel());
+            if(_spill_fd >= 0)
+            {
+                drainSpill();
+            }
+            sink.flush();
+            _stats.setQueued(_looper->pending());
+        }
+
+        //溢出开始之前进入队列的日志必须先写出，队列中仍有数据时等下一批
+        void drainSpill()
+        {
+            std::string chunk;
+            for(;;)
+            {
+                uint64_t begin, end;
+                cpplogs::LogLevel::value level;
+                {
+                    std::unique_lock<std::mutex> lock(_spill_mutex);
+                    if(!_spilling || _looper->pending() != 0)
+                    {
+                        return;
+                    }
+                    if(_spill_read == _spill_write)
+                    {
+                        //已全部读回，截断溢出文件，之后的日志重新进入队列
+                        if(ftruncate(_spill_fd, 0) < 0)
+                        {
+                            std::cerr << "[ERROR]cpplogs::AsyncSink::drainSpill::ftruncate: " << strerror(errno) << std::endl;
+                        }
+                        _spill_read = _spill_write = 0;
+                        _spilling = false;
+                        _spill_level = cpplogs::LogLevel::value::UNKNOW;
+                        return;
+                    }
+                    begin = _spill_read;
+                    end = std::min<uint64_t>(_spill_write, begin + _policy.buffer_size);
+                    level = _spill_level;
+                }
+                //读取与写出不持有锁，生产者可以继续追加
+                chunk.resize(end - begin);
+                ssize_t ret = pread(_spill_fd, &chunk[0], chunk.size(), begin);
+                if(ret <= 0)
+                {
+                    if(ret < 0 && errno == EINTR)
+                    {
+                        continue;
+                    }
+                    std::cerr << "[ERROR]cpplogs::AsyncSink::drainSpill::pread: " << strerror(errno) << std::endl;
+                    _stats.onError();
+                    ret = chunk.size();//跳过无法读回的部分，避免工作线程停滞
+                }
+                else
+                {
+                    static_cast<cpplogs::LogSink&>(*_sink).log(chunk.data(), ret, level);
+                }
+                std::unique_lock<std::mutex> lock(_spill_mutex);
+                _spill_read += ret;
+            }
+        }
+
+    private:
+        cpplogs::AsyncSinkPolicy _policy;
+        std::shared_ptr<SinkType> _sink;//被包装的落地方向
+        std::mutex _spill_mutex;
+        int _spill_fd;
+        bool _spilling;//溢出文件中有尚未读回的日志，受 _spill_mutex 保护
+        uint64_t _spill_read;//已读回的位置
+        uint64_t _spill_write;//已写入的位置
+        cpplogs::LogLevel::value _spill_level;//溢出文件中的最高等级
+        cpplogs::AsyncLooper::ptr _looper;//工作线程，最后构造，析构时先停止
+    };
+}
+
+#endif
@@ -0,0 +1,524 @@
+#include "format.hpp"
+#include "static_format.hpp"
+#include "json_format.hpp"
+#include "logger.hpp"
+#include "cpplogs.hpp"
+#include "parallel.hpp"
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <mutex>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <unordered_map>
+
+/*
+ * bench.cc 性能测试套件（make bench，-O2 -DNDEBUG）
+ * 1. format:   各格式化规则（运行时解析的 Formmatter 与编译期特化的 StaticFormmatter）、JSON/logfmt、1KB 消息的 JSON 转义
+ * 2. logger:   同步日志器的文本模式（printf 与 {} 风格）、二进制模式、等级不足被跳过的调用点宏
+ * 3. sink:     StdoutSink（重定向到 /dev/null）、FileSink、RollSinkBySize（有无稀疏索引）、RollSinkByTime
+ * 4. mode:     同步与异步日志器，1/2/4/8/16 个生产者线程写文件
+ * 5. contention: 1~64 个线程共用一个同步日志器，落地方向无锁与内部加锁两种情况
+ * 6. parallel: 并行格式化的异步日志器，8 个生产者线程，1/2/4/8 个格式化工作线程，落地方向只计数
+ * 7. registry: 按名称获取全局日志器（LoggerManager，线程快照与缓存 + 无锁哈希表）与加锁的 unordered_map 对比，1/8 个线程
+ * 每个用例输出 条/秒、字节/秒 以及单条调用延迟的 p50/p99/p999（ns，含一次取时间的开销）
+ *
+ * 用法: ./bench [--quick] [--csv file] [--json file]
+ *   --quick 每个用例的日志条数减为 1/10，用于快速检查
+ *   结果同时打印到标准输出，CSV/JSON 便于不同版本之间对比
+*/
+
+//一个用例的测试结果
+struct BenchResult
+{
+    std::string group;
+    std::string name;
+    size_t threads;
+    size_t records;
+    size_t bytes;
+    double seconds;
+    double p50;
+    double p99;
+    double p999;
+};
+
+//统计字节数并转发给实际落地方向
+class MeterSink : public cpplogs::LogSink
+{
+public:
+    MeterSink(const cpplogs::LogSink::ptr& sink = cpplogs::LogSink::ptr())
+    : _sink(sink)
+    , _bytes(0)
+    {}
+    void log(const char* data, size_t len) override
+    {
+        _bytes.fetch_add(len, std::memory_order_relaxed);
+        if(_sink)
+        {
+            _sink->log(data, len);
+        }
+    }
+    void log(const char* data, size_t len, cpplogs::LogLevel::value level) override
+    {
+        _bytes.fetch_add(len, std::memory_order_relaxed);
+        if(_sink)
+        {
+            _sink->log(data, len, level);
+        }
+    }
+    void flush() override
+    {
+        if(_sink)
+        {
+            _sink->flush();
+        }
+    }
+    size_t bytes() const
+    {
+        return _bytes.load();
+    }
+private:
+    cpplogs::LogSink::ptr _sink;
+    std::atomic<size_t> _bytes;
+};
+
+//内部加锁的落地方向，模拟需要互斥的文件落地
+class LockedNullSink : public cpplogs::LogSink
+{
+public:
+    LockedNullSink() : _bytes(0) {}
+    void log(const char* data, size_t len) override
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _bytes += len;
+    }
+private:
+    std::mutex _mutex;
+    size_t _bytes;
+};
+
+static uint64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+//各线程的单条延迟样本合并后计算分位数
+static void percentiles(std::vector<uint32_t>& samples, BenchResult& result)
+{
+    if(samples.empty())
+    {
+        result.p50 = result.p99 = result.p999 = 0;
+        return;
+    }
+    auto at = [&samples](double q) {
+        size_t idx = std::min(samples.size() - 1, static_cast<size_t>(q * samples.size()));
+        std::nth_element(samples.begin(), samples.begin() + idx, samples.end());
+        return static_cast<double>(samples[idx]);
+    };
+    result.p50 = at(0.50);
+    result.p99 = at(0.99);
+    result.p999 = at(0.999);
+}
+
+//thread_count 个线程各调用 fn(i) count_per_thread 次，记录每次调用的耗时
+//finish 在所有线程结束后调用（如异步日志器等待落地完成），计入总耗时
+template<typename Fn>
+static BenchResult runThreads(const std::string& group, const std::string& name, size_t thread_count,
+    size_t count_per_thread, Fn fn, std::function<size_t()> finish)
+{
+    std::vector<std::vector<uint32_t>> samples(thread_count, std::vector<uint32_t>(count_per_thread));
+    std::vector<std::thread> threads;
+    std::atomic<size_t> ready(0);
+    std::atomic<bool> go(false);
+    for(size_t t = 0; t < thread_count; t++)
+    {
+        threads.emplace_back([&, t]() {
+            std::vector<uint32_t>& local = samples[t];
+            ready++;
+            while(!go)
+            {
+                std::this_thread::yield();
+            }
+            for(size_t i = 0; i < count_per_thread; i++)
+            {
+                uint64_t begin = nowNs();
+                fn(i);
+                local[i] = static_cast<uint32_t>(std::min<uint64_t>(nowNs() - begin, UINT32_MAX));
+            }
+        });
+    }
+    while(ready < thread_count)
+    {
+        std::this_thread::yield();
+    }
+    uint64_t begin = nowNs();
+    go = true;
+    for(auto& thread : threads)
+    {
+        thread.join();
+    }
+    size_t bytes = finish();
+    uint64_t end = nowNs();
+
+    BenchResult result;
+    result.group = group;
+    result.name = name;
+    result.threads = thread_count;
+    result.records = thread_count * count_per_thread;
+    result.bytes = bytes;
+    result.seconds = (end - begin) / 1e9;
+    std::vector<uint32_t> all;
+    all.reserve(result.records);
+    for(auto& s : samples)
+    {
+        all.insert(all.end(), s.begin(), s.end());
+    }
+    percentiles(all, result);
+    return result;
+}
+
+static BenchResult benchFormat(const std::string& name, cpplogs::Formmatter& fmt, size_t count)
+{
+    cpplogs::LogMsg msg(cpplogs::LogLevel::value::INFO, __LINE__, __FILE__, "root", "benchmark format message payload");
+    cpplogs::Buffer buf(256);
+    size_t bytes = 0;
+    return runThreads("format", name, 1, count, [&](size_t) {
+        buf.reset();
+        fmt.format(buf, msg);
+        bytes += buf.readAbleSize();
+    }, [&]() { return bytes; });
+}
+
+//旧接口：每条格式化结果构造一个 std::string
+static BenchResult benchFormatString(const std::string& name, cpplogs::Formmatter& fmt, size_t count)
+{
+    cpplogs::LogMsg msg(cpplogs::LogLevel::value::INFO, __LINE__, __FILE__, "root", "benchmark format message payload");
+    size_t bytes = 0;
+    return runThreads("format", name, 1, count, [&](size_t) {
+        bytes += fmt.format(msg).size();
+    }, [&]() { return bytes; });
+}
+
+//JSON 转义 1KB 的消息，clean 为 false 时每 64 字节含一个需要转义的字符
+static BenchResult benchEscape(const std::string& name, bool clean, size_t count)
+{
+    std::string payload(1024, 'x');
+    if(!clean)
+    {
+        for(size_t i = 0; i < payload.size(); i += 64)
+        {
+            payload[i] = '"';
+        }
+    }
+    cpplogs::Buffer buf(2048);
+    size_t bytes = 0;
+    return runThreads("format", name, 1, count, [&](size_t) {
+        buf.reset();
+        cpplogs::JsonEscape::escape(buf, payload.data(), payload.size());
+        bytes += buf.readAbleSize();
+    }, [&]() { return bytes; });
+}
+
+enum class LoggerCase
+{
+    PRINTF,
+    BRACE,
+    BINARY,
+    DISABLED
+};
+
+static BenchResult benchLogger(const std::string& name, LoggerCase type, size_t count)
+{
+    std::shared_ptr<MeterSink> meter = std::make_shared<MeterSink>();
+    std::vector<cpplogs::LogSink::ptr> sinks(1, meter);
+    cpplogs::LogLevel::value level = type == LoggerCase::DISABLED ? cpplogs::LogLevel::value::INFO : cpplogs::LogLevel::value::DEBUG;
+    cpplogs::SyncLogger logger("bench", level, std::make_shared<cpplogs::Formmatter>(), sinks);
+    if(type == LoggerCase::BINARY)
+    {
+        logger.enableBinary();
+    }
+    return runThreads("logger", name, 1, count, [&](size_t i) {
+        if(type == LoggerCase::BRACE)
+        {
+            LOG_DEBUG_FMT(&logger, "request id={} user={} latency={} ms", static_cast<int>(i), "benchmark", 1.25);
+        }
+        else
+        {
+            LOG_DEBUG(&logger, "request id=%d user=%s latency=%.3f ms", static_cast<int>(i), "benchmark", 1.25);
+        }
+    }, [&]() { return meter->bytes(); });
+}
+
+//单线程同步日志器写入指定落地方向
+static BenchResult benchSink(const std::string& name, const cpplogs::LogSink::ptr& sink, size_t count)
+{
+    std::shared_ptr<MeterSink> meter = std::make_shared<MeterSink>(sink);
+    std::vector<cpplogs::LogSink::ptr> sinks(1, meter);
+    cpplogs::SyncLogger logger("bench", cpplogs::LogLevel::value::DEBUG, std::make_shared<cpplogs::Formmatter>(), sinks);
+    return runThreads("sink", name, 1, count, [&](size_t i) {
+        LOG_INFO(&logger, "request id=%d user=%s latency=%.3f ms", static_cast<int>(i), "benchmark", 1.25);
+    }, [&]() { meter->flush(); return meter->bytes(); });
+}
+
+//同步/异步日志器，多个生产者线程写文件
+static BenchResult benchMode(bool async, size_t thread_count, size_t count)
+{
+    std::string pathname = std::string("./bench_log/") + (async ? "async" : "sync") + ".log";
+    remove(pathname.c_str());
+    std::shared_ptr<MeterSink> meter = std::make_shared<MeterSink>(std::make_shared<cpplogs::FileSink>(pathname));
+    std::vector<cpplogs::LogSink::ptr> sinks(1, meter);
+    cpplogs::Formmatter::ptr fmt = std::make_shared<cpplogs::Formmatter>();
+    std::unique_ptr<cpplogs::Logger> logger;
+    if(async)
+    {
+        logger.reset(new cpplogs::AsyncLogger("bench", cpplogs::LogLevel::value::DEBUG, fmt, sinks));
+    }
+    else
+    {
+        logger.reset(new cpplogs::SyncLogger("bench", cpplogs::LogLevel::value::DEBUG, fmt, sinks));
+    }
+    return runThreads("mode", async ? "AsyncLogger+FileSink" : "SyncLogger+FileSink", thread_count, count / thread_count,
+        [&](size_t i) {
+            LOG_INFO(logger.get(), "request id=%d user=%s latency=%.3f ms", static_cast<int>(i), "benchmark", 1.25);
+        },
+        [&]() {
+            logger.reset();//异步日志器析构时等待剩余日志落地
+            meter->flush();
+            return meter->bytes();
+        });
+}
+
+//并行格式化：格式化在工作线程中完成，吞吐量随工作线程数（parallel）与调用者线程数（producers）的变化
+//落地方向只计数，不产生 I/O
+static BenchResult benchParallel(const std::string& group, size_t workers, size_t thread_count, size_t count)
+{
+    std::shared_ptr<MeterSink> meter = std::make_shared<MeterSink>();
+    std::vector<cpplogs::LogSink::ptr> sinks(1, meter);
+    std::unique_ptr<cpplogs::Logger> logger(new cpplogs::ParallelAsyncLogger("bench", cpplogs::LogLevel::value::DEBUG,
+        std::make_shared<cpplogs::Formmatter>("[%d{%Y-%m-%d %H:%M:%S.%us}][%t][%c][%f:%l][%p]%T%m%n"), sinks, workers));
+    return runThreads(group, "ParallelAsyncLogger workers=" + std::to_string(workers), thread_count, count / thread_count,
+        [&](size_t i) {
+            LOG_INFO(logger.get(), "request id=%d user=%s latency=%.3f ms", static_cast<int>(i), "benchmark", 1.25);
+        },
+        [&]() {
+            logger.reset();//析构时等待所有批次格式化并写出
+            return meter->bytes();
+        });
+}
+
+static BenchResult benchContention(bool locked, size_t thread_count, size_t count)
+{
+    cpplogs::LogSink::ptr inner;
+    if(locked)
+    {
+        inner = std::make_shared<LockedNullSink>();
+    }
+    std::shared_ptr<MeterSink> meter = std::make_shared<MeterSink>(inner);
+    std::vector<cpplogs::LogSink::ptr> sinks(1, meter);
+    cpplogs::SyncLogger logger("bench", cpplogs::LogLevel::value::DEBUG, std::make_shared<cpplogs::Formmatter>(), sinks);
+    return runThreads("contention", locked ? "locked sink" : "lock-free sink", thread_count, count / thread_count,
+        [&](size_t i) {
+            LOG_INFO(&logger, "request id=%d user=%s", static_cast<int>(i), "benchmark");
+        },
+        [&]() { return meter->bytes(); });
+}
+
+//按名称获取日志器：管理器注册 64 个日志器，records 为查找次数，bytes 为 0
+static BenchResult benchLookup(bool locked, size_t thread_count, size_t count)
+{
+    static const char* names[] = { "net.http", "net.db", "disk", "auth.session" };
+    std::mutex mutex;
+    std::unordered_map<std::string, cpplogs::Logger::ptr> map;
+    for(size_t i = 0; i < 64; i++)
+    {
+        std::string name = i < 4 ? names[i] : "bench.registry." + std::to_string(i);
+        map[name] = cpplogs::GlobalLoggerBuilder().buildLoggerName(name).buildLoggerLevel(cpplogs::LogLevel::value::OFF).build();
+    }
+    std::atomic<size_t> missed(0);//查找结果必须被使用，避免被优化掉
+    return runThreads("registry", locked ? "mutex + unordered_map" : "LoggerManager::getLogger", thread_count, count / thread_count,
+        [&](size_t i) {
+            const char* name = names[i % 4];
+            if(locked)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if(map.find(name) == map.end())
+                {
+                    missed.fetch_add(1, std::memory_order_relaxed);
+                }
+                return;
+            }
+            if(!cpplogs::getLogger(name))
+            {
+                missed.fetch_add(1, std::memory_order_relaxed);
+            }
+        },
+        [&]() { return missed.load(); });
+}
+
+static void printResult(const BenchResult& r)
+{
+    printf("%-11s %-48s %3zu %12.0f %10.2f %8.0f %8.0f %8.0f\n", r.group.c_str(), r.name.c_str(), r.threads,
+        r.records / r.seconds, r.bytes / r.seconds / (1024 * 1024), r.p50, r.p99, r.p999);
+    fflush(stdout);
+}
+
+static void writeCsv(const std::string& pathname, const std::vector<BenchResult>& results)
+{
+    std::ofstream ofs(pathname);
+    ofs << std::fixed << std::setprecision(3);
+    ofs << "group,case,threads,records,bytes,seconds,records_per_sec,bytes_per_sec,p50_ns,p99_ns,p999_ns\n";
+    for(auto& r : results)
+    {
+        ofs << r.group << ",\"" << r.name << "\"," << r.threads << "," << r.records << "," << r.bytes << ","
+            << r.seconds << "," << r.records / r.seconds << "," << r.bytes / r.seconds << ","
+            << r.p50 << "," << r.p99 << "," << r.p999 << "\n";
+    }
+}
+
+static void writeJson(const std::string& pathname, const std::vector<BenchResult>& results)
+{
+    std::ofstream ofs(pathname);
+    ofs << std::fixed << std::setprecision(3);
+    ofs << "{\"time\":" << time(nullptr) << ",\"hardware_threads\":" << std::thread::hardware_concurrency() << ",\"results\":[";
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult& r = results[i];
+        ofs << (i == 0 ? "" : ",") << "\n{\"group\":\"" << r.group << "\",\"case\":\"" << r.name << "\""
+            << ",\"threads\":" << r.threads << ",\"records\":" << r.records << ",\"bytes\":" << r.bytes
+            << ",\"seconds\":" << r.seconds << ",\"records_per_sec\":" << r.records / r.seconds
+            << ",\"bytes_per_sec\":" << r.bytes / r.seconds
+            << ",\"p50_ns\":" << r.p50 << ",\"p99_ns\":" << r.p99 << ",\"p999_ns\":" << r.p999 << "}";
+    }
+    ofs << "\n]}\n";
+}
+
+int main(int argc, char* argv[])
+{
+    size_t count = 1000000;
+    std::string csv_path, json_path;
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if(arg == "--quick")
+        {
+            count /= 10;
+        }
+        else if(arg == "--csv" && i + 1 < argc)
+        {
+            csv_path = argv[++i];
+        }
+        else if(arg == "--json" && i + 1 < argc)
+        {
+            json_path = argv[++i];
+        }
+        else
+        {
+            std::cout << "用法: ./bench [--quick] [--csv file] [--json file]" << std::endl;
+            return arg == "-h" || arg == "--help" ? 0 : 1;
+        }
+    }
+    cpplogs::util::File::createDirectory("./bench_log/");
+
+    std::vector<BenchResult> results;
+    auto add = [&results](const BenchResult& r) {
+        printResult(r);
+        results.push_back(r);
+    };
+    printf("%-11s %-48s %3s %12s %10s %8s %8s %8s\n", "group", "case", "thr", "records/s", "MB/s", "p50", "p99", "p999");
+
+    const char* patterns[] = {
+        "[%d{%H:%M:%S}][%t][%c][%f:%l][%p]%T%m%n",
+        "%m%n",
+        "%d{%Y-%m-%d %H:%M:%S.%ms} %p %c %m%n",
+        "[%d{%H:%M:%S.%us}][%t][%f:%l] %m%n",
+    };
+    for(auto pattern : patterns)
+    {
+        cpplogs::Formmatter fmt(pattern);
+        add(benchFormat(pattern, fmt, count));
+    }
+    CPPLOGS_STATIC_FORMMATTER("[%d{%H:%M:%S}][%t][%c][%f:%l][%p]%T%m%n") static_fmt;
+    add(benchFormat("static [%d{%H:%M:%S}][%t][%c][%f:%l][%p]%T%m%n", static_fmt, count));
+    cpplogs::Formmatter default_fmt;
+    add(benchFormatString("string [%d{%H:%M:%S}][%t][%c][%f:%l][%p]%T%m%n", default_fmt, count));
+    cpplogs::JsonFormmatter json_fmt;
+    add(benchFormat("json", json_fmt, count));
+    cpplogs::LogfmtFormmatter logfmt_fmt;
+    add(benchFormat("logfmt", logfmt_fmt, count));
+    add(benchEscape("json escape 1KB clean", true, count));
+    add(benchEscape("json escape 1KB with quotes", false, count));
+
+    add(benchLogger("printf text", LoggerCase::PRINTF, count));
+    add(benchLogger("{} text", LoggerCase::BRACE, count));
+    add(benchLogger("printf binary", LoggerCase::BINARY, count));
+    add(benchLogger("LOG_DEBUG disabled at runtime", LoggerCase::DISABLED, count));
+
+    //标准输出重定向到 /dev/null，结束后恢复
+    {
+        fflush(stdout);
+        int saved = dup(STDOUT_FILENO);
+        int devnull = open("/dev/null", O_WRONLY);
+        dup2(devnull, STDOUT_FILENO);
+        BenchResult r = benchSink("StdoutSink(/dev/null)", std::make_shared<cpplogs::StdoutSink>(), count);
+        std::cout.flush();
+        dup2(saved, STDOUT_FILENO);
+        close(devnull);
+        close(saved);
+        add(r);
+    }
+    remove("./bench_log/file.log");
+    add(benchSink("FileSink", std::make_shared<cpplogs::FileSink>("./bench_log/file.log"), count));
+    add(benchSink("RollSinkBySize(16M)", std::make_shared<cpplogs::RollSinkBySize>("./bench_log/roll-size-", 16 * 1024 * 1024), count));
+    {
+        std::shared_ptr<cpplogs::RollSinkBySize> indexed = std::make_shared<cpplogs::RollSinkBySize>("./bench_log/roll-index-", 16 * 1024 * 1024);
+        indexed->enableIndex();
+        add(benchSink("RollSinkBySize(16M)+index", indexed, count));
+    }
+    add(benchSink("RollSinkByTime(60s)", std::make_shared<cpplogs::RollSinkByTime>("./bench_log/roll-time-", 60), count));
+
+    for(int async = 0; async <= 1; async++)
+    {
+        for(size_t threads = 1; threads <= 16; threads *= 2)
+        {
+            add(benchMode(async == 1, threads, count));
+        }
+    }
+    for(int locked = 0; locked <= 1; locked++)
+    {
+        for(size_t threads = 1; threads <= 64; threads *= 2)
+        {
+            add(benchContention(locked == 1, threads, count / 2));
+        }
+    }
+
+    for(size_t workers = 1; workers <= 8; workers *= 2)
+    {
+        add(benchParallel("parallel", workers, 8, count));
+    }
+    //调用者按线程分散到暂存分片，调用者增加时不在同一把锁上排队
+    for(size_t threads = 1; threads <= 16; threads *= 2)
+    {
+        add(benchParallel("producers", 4, threads, count));
+    }
+
+    for(int locked = 0; locked <= 1; locked++)
+    {
+        for(size_t threads = 1; threads <= 8; threads *= 8)
+        {
+            add(benchLookup(locked == 1, threads, count));
+        }
+    }
+
+    if(!csv_path.empty())
+    {
+        writeCsv(csv_path, results);
+    }
+    if(!json_path.empty())
+    {
+        writeJson(json_path, results);
+    }
+    return 0;
+}
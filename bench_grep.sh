@@ -0,0 +1,69 @@
+#!/bin/bash
+# bench_grep.sh cpplogs-grep 与 grep -F + sort 的对比测试（make bench-grep）
+# 1. 生成测试语料：4 个日志器各自的滚动文件（默认规则，每个文件 64MB），时间范围相互重叠
+# 2. 分别用 grep -F | sort 与 cpplogs-grep 按文本、等级、日志器 + 时间范围检索，比较耗时与结果行数
+#
+# 用法: ./bench_grep.sh [语料大小MB，默认 2048] [语料目录，默认 ./grep_corpus]
+#   语料已存在且大小相同时直接复用
+
+SIZE_MB=${1:-2048}
+DIR=${2:-./grep_corpus}
+GREP_TOOL=./cpplogs-grep
+export LC_ALL=C
+
+[ -x "$GREP_TOOL" ] || make cpplogs-grep || exit 1
+
+if [ "$(cat "$DIR/.size" 2>/dev/null)" != "$SIZE_MB" ]; then
+    rm -rf "$DIR"
+    mkdir -p "$DIR"
+    echo "生成 ${SIZE_MB}MB 语料到 $DIR ..."
+    for logger in 0 1 2 3; do
+        awk -v size_mb="$SIZE_MB" -v logger="$logger" -v dir="$DIR" 'BEGIN {
+            split("DEBUG INFO INFO INFO INFO INFO WARN INFO DEBUG ERROR", levels, " ");
+            limit = size_mb * 1024 * 1024 / 4;
+            file_limit = 64 * 1024 * 1024;
+            total = 0; written = 0; part = 0;
+            out = sprintf("%s/logger%d-%04d.log", dir, logger, part);
+            for(i = 0; total < limit; i++) {
+                t = int(i / 4000);
+                ts = sprintf("%02d:%02d:%02d", int(t / 3600) % 24, int(t / 60) % 60, t % 60);
+                lv = levels[i % 10 + 1];
+                line = sprintf("[%s][1400%08d][logger-%d][service/module%d.cc:%d][%s]\tuser %d request %d finished in %d us status %d\n",
+                    ts, (i * 7 + logger) % 100000000, logger, i % 17, 100 + i % 300, lv, i % 100000, i, i % 9973, (i % 50 == 0) ? 500 : 200);
+                printf "%s", line > out;
+                total += length(line); written += length(line);
+                if(written >= file_limit) {
+                    close(out); part++; written = 0;
+                    out = sprintf("%s/logger%d-%04d.log", dir, logger, part);
+                }
+            }
+        }' &
+    done
+    wait
+    echo "$SIZE_MB" > "$DIR/.size"
+fi
+FILES=$(ls "$DIR"/*.log | tr '\n' ' ')
+echo "语料: $(du -sh "$DIR" | cut -f1), $(echo $FILES | wc -w) 个文件, $(nproc) 个 CPU"
+
+#丢弃页缓存的影响：先完整读一遍
+cat $FILES > /dev/null
+
+TIMEFORMAT="%R"
+run() {
+    local name="$1"; shift
+    local secs
+    secs=$( { time "$@" > /tmp/bench_grep.out; } 2>&1 )
+    printf "  %-14s %8ss %10s 行\n" "$name" "$secs" "$(wc -l < /tmp/bench_grep.out)"
+}
+
+echo "文本: request 4242"
+run "grep+sort" bash -c "grep -F -h 'request 4242' $FILES | sort -s -t']' -k1,1"
+run "cpplogs-grep" $GREP_TOOL -e 'request 4242' $FILES
+
+echo "等级: ERROR 及以上"
+run "grep+sort" bash -c "grep -F -h -e '[ERROR]' -e '[FATAL]' $FILES | sort -s -t']' -k1,1"
+run "cpplogs-grep" $GREP_TOOL -l ERROR $FILES
+
+echo "日志器 + 时间范围: logger-2, 00:01:00 ~ 00:02:00"
+run "grep+sort" bash -c "grep -F -h '[logger-2]' $FILES | awk '\$0 >= \"[00:01:00]\" && \$0 < \"[00:02:01]\"' | sort -s -t']' -k1,1"
+run "cpplogs-grep" $GREP_TOOL -c logger-2 --from 00:01:00 --to 00:02:00 $FILES
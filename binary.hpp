@@ -0,0 +1,397 @@
+#ifndef __LOGS_BINARY_H__
+#define __LOGS_BINARY_H__
+
+/*
+ * binary.hpp 二进制日志模式
+ * 1. 调用点（文件、行号、格式化字符串、等级、日志器名）首次使用时登记一次，分配调用点ID
+ * 2. 每条日志只记录调用点ID、时间戳、线程ID以及参数的原始字节，不在调用者线程进行文本格式化
+ * 3. 文本格式化由离线工具 cpplogs-decode 完成，使用 Formmatter 规则输出
+ *
+ * 数据格式（本机字节序）：
+ *   调用点登记 'S' u32:site_id u8:level u32:line u16:len file u16:len logger u32:len fmt u16:nargs u8[nargs]:类型
+ *   日志记录   'L' u32:site_id u64:sec u32:nsec u64:tid u32:len 参数字节
+ *   参数字节：INT32 4字节，INT64/POINTER 8字节，DOUBLE 8字节，STRING u32:len + 字节
+ * 调用点登记记录只在该日志器的输出中出现一次，滚动文件需要按顺序一起解码
+ * 无法按参数类型编码的格式化字符串（如 %n、%ls），在调用者线程格式化为文本后以 "%s" 调用点记录
+ * {} 风格接口的日志同样在调用者线程格式化为文本，以 "%s" 调用点记录
+*/
+
+#include "level.hpp"
+#include "buffer.hpp"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstdarg>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+
+namespace cpplogs
+{
+    //参数类型
+    enum class BinaryArg : uint8_t
+    {
+        INT32 = 1,
+        INT64,
+        DOUBLE,
+        LDOUBLE,//long double，按 double 存储
+        STRING,
+        POINTER
+    };
+
+    //格式化字符串中的一个转换说明，例如 "%-8.3lf"
+    struct BinarySpec
+    {
+        size_t begin;//在格式化字符串中的起始位置
+        size_t end;//结束位置（不包含）
+        std::vector<cpplogs::BinaryArg> args;//消耗的参数类型，'*' 宽度/精度在前
+    };
+
+    class BinaryFormat
+    {
+    public:
+        //解析 printf 风格的格式化字符串，得到各转换说明及参数类型；不支持的转换返回 false
+        static bool parse(const char* fmt, std::vector<cpplogs::BinarySpec>& specs)
+        {
+            size_t pos = 0;
+            size_t len = strlen(fmt);
+            while(pos < len)
+            {
+                if(fmt[pos] != '%')
+                {
+                    pos++;
+                    continue;
+                }
+                if(pos + 1 < len && fmt[pos + 1] == '%')
+                {
+                    pos += 2;
+                    continue;
+                }
+                cpplogs::BinarySpec spec;
+                spec.begin = pos++;
+                while(pos < len && strchr("-+ #0'", fmt[pos]) != nullptr)//标志
+                {
+                    pos++;
+                }
+                if(pos < len && fmt[pos] == '*')//宽度
+                {
+                    spec.args.push_back(cpplogs::BinaryArg::INT32);
+                    pos++;
+                }
+                while(pos < len && fmt[pos] >= '0' && fmt[pos] <= '9')
+                {
+                    pos++;
+                }
+                if(pos < len && fmt[pos] == '.')//精度
+                {
+                    pos++;
+                    if(pos < len && fmt[pos] == '*')
+                    {
+                        spec.args.push_back(cpplogs::BinaryArg::INT32);
+                        pos++;
+                    }
+                    while(pos < len && fmt[pos] >= '0' && fmt[pos] <= '9')
+                    {
+                        pos++;
+                    }
+                }
+                size_t arg_size = sizeof(int);//长度修饰
+                bool long_double = false;
+                while(pos < len && strchr("hlLqjzt", fmt[pos]) != nullptr)
+                {
+                    switch(fmt[pos])
+                    {
+                    case 'l':
+                        arg_size = (arg_size == sizeof(long)) ? sizeof(long long) : sizeof(long);
+                        break;
+                    case 'q':
+                        arg_size = sizeof(long long);
+                        break;
+                    case 'j':
+                        arg_size = sizeof(intmax_t);
+                        break;
+                    case 'z':
+                        arg_size = sizeof(size_t);
+                        break;
+                    case 't':
+                        arg_size = sizeof(ptrdiff_t);
+                        break;
+                    case 'L':
+                        long_double = true;
+                        break;
+                    default://'h' 'hh' 经过默认参数提升后为 int
+                        break;
+                    }
+                    pos++;
+                }
+                if(pos == len)
+                {
+                    return false;
+                }
+                switch(fmt[pos])
+                {
+                case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+                    spec.args.push_back(arg_size == 8 ? cpplogs::BinaryArg::INT64 : cpplogs::BinaryArg::INT32);
+                    break;
+                case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+                    spec.args.push_back(long_double ? cpplogs::BinaryArg::LDOUBLE : cpplogs::BinaryArg::DOUBLE);
+                    break;
+                case 's':
+                    if(arg_size != sizeof(int))//宽字符串不支持
+                    {
+                        return false;
+                    }
+                    spec.args.push_back(cpplogs::BinaryArg::STRING);
+                    break;
+                case 'p':
+                    spec.args.push_back(cpplogs::BinaryArg::POINTER);
+                    break;
+                default://%n 及未知转换
+                    return false;
+                }
+                spec.end = ++pos;
+                specs.push_back(spec);
+            }
+            return true;
+        }
+    };
+
+    //二进制日志编码器，每个日志器一个
+    class BinaryEncoder
+    {
+    public:
+        using ptr = std::shared_ptr<cpplogs::BinaryEncoder>;
+        //登记记录的输出函数，由日志器提供，保证登记记录先于使用它的日志记录落地
+        using Output = std::function<void(const char*, size_t)>;
+
+        BinaryEncoder(const std::string& logger_name, const Output& output)
+        : _id(nextId())
+        , _logger_name(logger_name)
+        , _output(output)
+        {}
+
+        //将一条日志编码到 out
+        void encode(cpplogs::Buffer& out, cpplogs::LogLevel::value level, const char* file, size_t line,
+            const char* fmt, va_list ap, time_t sec, uint32_t nsec, uint64_t tid)
+        {
+            const Site* site = findSite(level, file, line, fmt);
+            out.push('L');
+            pushValue(out, site->id);
+            pushValue(out, static_cast<uint64_t>(sec));
+            pushValue(out, nsec);
+            pushValue(out, tid);
+            //参数长度先占位，写完参数后回填
+            size_t len_pos = out.readAbleSize();
+            pushValue(out, static_cast<uint32_t>(0));
+            va_list ap_copy;
+            va_copy(ap_copy, ap);
+            if(site->preformat)
+            {
+                pushFormatted(out, fmt, ap_copy);
+            }
+            for(auto type : site->args)
+            {
+                switch(type)
+                {
+                case cpplogs::BinaryArg::INT32:
+                    pushValue(out, static_cast<int32_t>(va_arg(ap_copy, int)));
+                    break;
+                case cpplogs::BinaryArg::INT64:
+                    pushValue(out, static_cast<int64_t>(va_arg(ap_copy, long long)));
+                    break;
+                case cpplogs::BinaryArg::DOUBLE:
+                    pushValue(out, va_arg(ap_copy, double));
+                    break;
+                case cpplogs::BinaryArg::LDOUBLE:
+                    pushValue(out, static_cast<double>(va_arg(ap_copy, long double)));
+                    break;
+                case cpplogs::BinaryArg::STRING:
+                {
+                    const char* str = va_arg(ap_copy, const char*);
+                    if(str == nullptr)
+                    {
+                        str = "(null)";
+                    }
+                    uint32_t str_len = static_cast<uint32_t>(strlen(str));
+                    pushValue(out, str_len);
+                    out.push(str, str_len);
+                    break;
+                }
+                case cpplogs::BinaryArg::POINTER:
+                    pushValue(out, reinterpret_cast<uint64_t>(va_arg(ap_copy, void*)));
+                    break;
+                }
+            }
+            va_end(ap_copy);
+            uint32_t args_len = static_cast<uint32_t>(out.readAbleSize() - len_pos - sizeof(uint32_t));
+            memcpy(const_cast<char*>(out.begin()) + len_pos, &args_len, sizeof(args_len));
+        }
+
+        //将已格式化的文本编码到 out，fmt 仅用于区分调用点
+        void encodeText(cpplogs::Buffer& out, cpplogs::LogLevel::value level, const char* file, size_t line,
+            const char* fmt, const char* text, size_t len, time_t sec, uint32_t nsec, uint64_t tid)
+        {
+            const Site* site = findSite(level, file, line, fmt, true);
+            out.push('L');
+            pushValue(out, site->id);
+            pushValue(out, static_cast<uint64_t>(sec));
+            pushValue(out, nsec);
+            pushValue(out, tid);
+            pushValue(out, static_cast<uint32_t>(sizeof(uint32_t) + len));
+            pushString<uint32_t>(out, text, len);
+        }
+
+        template<typename T>
+        static void pushValue(cpplogs::Buffer& out, const T& value)
+        {
+            out.push(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+    private:
+        struct Site
+        {
+            uint32_t id;
+            bool preformat;//无法按类型编码，整体格式化为一个字符串参数
+            std::vector<cpplogs::BinaryArg> args;
+        };
+        struct SiteKey
+        {
+            const char* file;
+            const char* fmt;
+            size_t line;
+            cpplogs::LogLevel::value level;
+            bool text;//已格式化为文本的调用点
+            bool operator==(const SiteKey& key) const
+            {
+                return file == key.file && fmt == key.fmt && line == key.line && level == key.level && text == key.text;
+            }
+        };
+        struct SiteKeyHash
+        {
+            size_t operator()(const SiteKey& key) const
+            {
+                size_t h = reinterpret_cast<size_t>(key.fmt) * 31 + key.line;
+                return h ^ (reinterpret_cast<size_t>(key.file) >> 4) ^ static_cast<size_t>(key.level);
+            }
+        };
+        //线程私有的调用点缓存，命中时无需加锁
+        struct CacheEntry
+        {
+            size_t encoder_id;
+            SiteKey key;
+            const Site* site;
+        };
+        static const size_t CACHE_SIZE = 256;
+
+        const Site* findSite(cpplogs::LogLevel::value level, const char* file, size_t line, const char* fmt, bool text = false)
+        {
+            SiteKey key = { file, fmt, line, level, text };
+            static thread_local CacheEntry cache[CACHE_SIZE];
+            CacheEntry& entry = cache[SiteKeyHash()(key) % CACHE_SIZE];
+            if(entry.encoder_id == _id && entry.key == key)
+            {
+                return entry.site;
+            }
+            const Site* site = registerSite(key);
+            entry.encoder_id = _id;
+            entry.key = key;
+            entry.site = site;
+            return site;
+        }
+
+        //登记调用点：在锁内输出登记记录，其它线程只有在登记记录落地后才能拿到该调用点ID
+        const Site* registerSite(const SiteKey& key)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            auto it = _sites.find(key);
+            if(it != _sites.end())
+            {
+                return it->second.get();
+            }
+            std::vector<cpplogs::BinarySpec> specs;
+            std::unique_ptr<Site> site(new Site());
+            site->id = static_cast<uint32_t>(_sites.size() + 1);
+            site->preformat = key.text || !cpplogs::BinaryFormat::parse(key.fmt, specs);
+            const char* fmt = site->preformat ? "%s" : key.fmt;
+            if(!site->preformat)
+            {
+                for(auto& spec : specs)
+                {
+                    site->args.insert(site->args.end(), spec.args.begin(), spec.args.end());
+                }
+            }
+
+            cpplogs::Buffer buf(256);
+            buf.push('S');
+            pushValue(buf, site->id);
+            pushValue(buf, static_cast<uint8_t>(key.level));
+            pushValue(buf, static_cast<uint32_t>(key.line));
+            pushString<uint16_t>(buf, key.file, strlen(key.file));
+            pushString<uint16_t>(buf, _logger_name.c_str(), _logger_name.size());
+            pushString<uint32_t>(buf, fmt, strlen(fmt));
+            pushValue(buf, static_cast<uint16_t>(site->preformat ? 1 : site->args.size()));
+            if(site->preformat)
+            {
+                pushValue(buf, static_cast<uint8_t>(cpplogs::BinaryArg::STRING));
+            }
+            for(auto type : site->args)
+            {
+                pushValue(buf, static_cast<uint8_t>(type));
+            }
+            _output(buf.begin(), buf.readAbleSize());
+
+            const Site* ret = site.get();
+            _sites[key] = std::move(site);
+            return ret;
+        }
+
+        //在调用者线程格式化为文本，作为一个字符串参数写入
+        static void pushFormatted(cpplogs::Buffer& out, const char* fmt, va_list ap)
+        {
+            size_t len_pos = out.readAbleSize();
+            pushValue(out, static_cast<uint32_t>(0));
+            va_list ap_copy;
+            va_copy(ap_copy, ap);
+            int ret = vsnprintf(out.writeBegin(), out.writeAbleSize(), fmt, ap_copy);
+            va_end(ap_copy);
+            if(ret < 0)
+            {
+                ret = 0;
+            }
+            else if(static_cast<size_t>(ret) >= out.writeAbleSize())
+            {
+                out.ensureEnoughSize(ret + 1);
+                vsnprintf(out.writeBegin(), out.writeAbleSize(), fmt, ap);
+            }
+            out.moveWriter(ret);
+            uint32_t str_len = static_cast<uint32_t>(ret);
+            memcpy(const_cast<char*>(out.begin()) + len_pos, &str_len, sizeof(str_len));
+        }
+
+        template<typename LenType>
+        static void pushString(cpplogs::Buffer& out, const char* str, size_t len)
+        {
+            pushValue(out, static_cast<LenType>(len));
+            out.push(str, len);
+        }
+
+        static size_t nextId()
+        {
+            static std::atomic<size_t> id(0);
+            return ++id;
+        }
+
+    private:
+        size_t _id;//编码器编号，用于区分线程缓存中不同编码器的调用点
+        std::string _logger_name;
+        Output _output;
+        std::mutex _mutex;
+        std::unordered_map<SiteKey, std::unique_ptr<Site>, SiteKeyHash> _sites;
+    };
+}
+
+#endif
@@ -0,0 +1,298 @@
+#ifndef __LOGS_BRACE_FMT_H__
+#define __LOGS_BRACE_FMT_H__
+
+/*
+ * brace_format.hpp 类型安全的 {} 格式化
+ * 1. 格式化字符串中的 {} 依次被参数替换，{{ 与 }} 输出为 { 与 }
+ * 2. 参数按类型转换后直接写入输出缓冲区，不经过 vsnprintf 与临时字符串
+ *    整数使用两位一组的查表转换，浮点数默认保留 6 位小数并去掉末尾的 0（过大或过小的值使用 %g）
+ * 3. 通过特化 cpplogs::Formatter<T> 支持自定义类型:
+ *      template<> struct cpplogs::Formatter<Point>
+ *      {
+ *          static void format(cpplogs::Buffer& out, const Point& p) { ... }
+ *      };
+ * 4. cpplogs::detail::countPlaceholders 为 constexpr 函数，调用点宏（LOG_INFO_FMT 等）在编译期检查占位符与参数个数
+ *    占位符多于参数时多出的 {} 原样输出，参数多于占位符时多出的参数被忽略
+*/
+
+#include "buffer.hpp"
+#include "util.hpp"
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <type_traits>
+
+namespace cpplogs
+{
+    namespace detail
+    {
+        template<typename T>
+        struct dependent_false : std::false_type {};
+
+        //格式化字符串非法（出现单独的 { 或 }）时的返回值
+        constexpr size_t INVALID_PLACEHOLDERS = static_cast<size_t>(-1);
+
+        //编译期统计占位符个数
+        constexpr size_t countPlaceholders(const char* s, size_t n = 0)
+        {
+            return *s == '\0' ? n
+                : (s[0] == '{' && s[1] == '{') || (s[0] == '}' && s[1] == '}') ? countPlaceholders(s + 2, n)
+                : (s[0] == '{' && s[1] == '}') ? countPlaceholders(s + 2, n + 1)
+                : (s[0] == '{' || s[0] == '}') ? INVALID_PLACEHOLDERS
+                : countPlaceholders(s + 1, n);
+        }
+
+        //参数个数，只在 decltype 中使用，参数不会被求值
+        template<typename... Args>
+        std::integral_constant<size_t, sizeof...(Args)> countArgs(const Args&...);
+    }
+
+    //类型格式化器，未特化的类型在编译期报错
+    template<typename T, typename Enable = void>
+    struct Formatter
+    {
+        static_assert(cpplogs::detail::dependent_false<T>::value, "cpplogs: 该类型没有 cpplogs::Formatter 特化.");
+    };
+
+    //整数（bool 与 char 除外）
+    template<typename T>
+    struct Formatter<T, typename std::enable_if<std::is_integral<T>::value
+        && !std::is_same<T, bool>::value && !std::is_same<T, char>::value>::type>
+    {
+        static void format(cpplogs::Buffer& out, T value)
+        {
+            out.ensureEnoughSize(21);
+            size_t len = std::is_signed<T>::value
+                ? cpplogs::util::Number::toChars(out.writeBegin(), static_cast<int64_t>(value))
+                : cpplogs::util::Number::toChars(out.writeBegin(), static_cast<uint64_t>(value));
+            out.moveWriter(len);
+        }
+    };
+
+    template<>
+    struct Formatter<bool>
+    {
+        static void format(cpplogs::Buffer& out, bool value)
+        {
+            value ? out.push("true", 4) : out.push("false", 5);
+        }
+    };
+
+    template<>
+    struct Formatter<char>
+    {
+        static void format(cpplogs::Buffer& out, char value)
+        {
+            out.push(value);
+        }
+    };
+
+    //浮点数
+    template<typename T>
+    struct Formatter<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+    {
+        static void format(cpplogs::Buffer& out, T value)
+        {
+            double v = static_cast<double>(value);
+            out.ensureEnoughSize(32);
+            char* p = out.writeBegin();
+            double a = std::fabs(v);
+            if(std::isnan(v))
+            {
+                out.push("nan", 3);
+                return;
+            }
+            if(std::isinf(v))
+            {
+                v < 0 ? out.push("-inf", 4) : out.push("inf", 3);
+                return;
+            }
+            if(a != 0 && (a < 1e-4 || a >= 1e12))//定点表示会丢失精度或溢出，使用 %g
+            {
+                int ret = snprintf(p, 32, "%g", v);
+                out.moveWriter(ret > 0 ? ret : 0);
+                return;
+            }
+            //定点：6 位小数，四舍五入，去掉末尾的 0
+            uint64_t scaled = static_cast<uint64_t>(a * 1e6 + 0.5);
+            uint64_t int_part = scaled / 1000000;
+            uint64_t frac_part = scaled % 1000000;
+            size_t len = 0;
+            if(std::signbit(v) && scaled != 0)
+            {
+                p[len++] = '-';
+            }
+            len += cpplogs::util::Number::toChars(p + len, int_part);
+            if(frac_part != 0)
+            {
+                p[len++] = '.';
+                for(uint64_t div = 100000; div > 0 && frac_part != 0; div /= 10)
+                {
+                    p[len++] = static_cast<char>('0' + frac_part / div);
+                    frac_part %= div;
+                }
+            }
+            out.moveWriter(len);
+        }
+    };
+
+    //C 字符串
+    template<>
+    struct Formatter<const char*>
+    {
+        static void format(cpplogs::Buffer& out, const char* value)
+        {
+            if(value == nullptr)
+            {
+                value = "(null)";
+            }
+            out.push(value, strlen(value));
+        }
+    };
+    template<>
+    struct Formatter<char*> : Formatter<const char*> {};
+
+    template<>
+    struct Formatter<std::string>
+    {
+        static void format(cpplogs::Buffer& out, const std::string& value)
+        {
+            out.push(value.data(), value.size());
+        }
+    };
+
+    //指针（字符指针除外），十六进制输出
+    template<typename T>
+    struct Formatter<T*, typename std::enable_if<!std::is_same<typename std::remove_cv<T>::type, char>::value>::type>
+    {
+        static void format(cpplogs::Buffer& out, const T* value)
+        {
+            static const char hex[] = "0123456789abcdef";
+            uintptr_t v = reinterpret_cast<uintptr_t>(value);
+            char tmp[2 + sizeof(uintptr_t) * 2];
+            char* p = tmp + sizeof(tmp);
+            do
+            {
+                *--p = hex[v & 0xf];
+                v >>= 4;
+            } while(v != 0);
+            *--p = 'x';
+            *--p = '0';
+            out.push(p, tmp + sizeof(tmp) - p);
+        }
+    };
+
+    //类型擦除后的参数，格式化循环不随参数类型展开
+    struct FormatArg
+    {
+        const void* value;
+        void (*format)(cpplogs::Buffer&, const void*);
+    };
+
+    namespace detail
+    {
+        template<typename T>
+        void formatValue(cpplogs::Buffer& out, const void* value)
+        {
+            cpplogs::Formatter<T>::format(out, *static_cast<const T*>(value));
+        }
+        inline void formatCString(cpplogs::Buffer& out, const void* value)
+        {
+            cpplogs::Formatter<const char*>::format(out, static_cast<const char*>(value));
+        }
+    }
+
+    template<typename T>
+    cpplogs::FormatArg makeFormatArg(const T& value)
+    {
+        cpplogs::FormatArg arg = { &value, &cpplogs::detail::formatValue<T> };
+        return arg;
+    }
+    //字符数组（字符串字面量）按 C 字符串输出
+    template<size_t N>
+    cpplogs::FormatArg makeFormatArg(const char (&value)[N])
+    {
+        cpplogs::FormatArg arg = { value, &cpplogs::detail::formatCString };
+        return arg;
+    }
+
+    //带调用点信息的格式化字符串，用于区分 {} 接口与 printf 风格的接口
+    //file/line 默认取构造处的调用点（GCC/Clang 内建函数）
+    class Fmt
+    {
+    public:
+        template<size_t N>
+        explicit Fmt(const char (&fmt)[N], const char* file = __builtin_FILE(), size_t line = __builtin_LINE())
+        : _fmt(fmt)
+        , _len(N - 1)
+        , _file(file)
+        , _line(line)
+        {}
+        //运行时构造的格式化字符串
+        Fmt(const char* fmt, size_t len, const char* file, size_t line)
+        : _fmt(fmt)
+        , _len(len)
+        , _file(file)
+        , _line(line)
+        {}
+
+        const char* _fmt;
+        size_t _len;
+        const char* _file;
+        size_t _line;
+    };
+
+    class BraceFormat
+    {
+    public:
+        //按格式化字符串将参数写入 out
+        static void format(cpplogs::Buffer& out, const char* fmt, size_t len, const cpplogs::FormatArg* args, size_t nargs)
+        {
+            const char* p = fmt;
+            const char* end = fmt + len;
+            const char* lit = p;//尚未输出的原始字符起点
+            size_t idx = 0;
+            while(p < end)
+            {
+                if(p + 1 < end && (*p == '{' || *p == '}'))
+                {
+                    if(p[0] == p[1])//{{ 或 }}
+                    {
+                        out.push(lit, p + 1 - lit);
+                        p += 2;
+                        lit = p;
+                        continue;
+                    }
+                    if(p[0] == '{' && p[1] == '}')
+                    {
+                        out.push(lit, p - lit);
+                        if(idx < nargs)
+                        {
+                            args[idx].format(out, args[idx].value);
+                        }
+                        else
+                        {
+                            out.push("{}", 2);
+                        }
+                        idx++;
+                        p += 2;
+                        lit = p;
+                        continue;
+                    }
+                }
+                p++;
+            }
+            out.push(lit, end - lit);
+        }
+
+        template<size_t N, typename... Args>
+        static void format(cpplogs::Buffer& out, const char (&fmt)[N], const Args&... args)
+        {
+            const cpplogs::FormatArg list[] = { cpplogs::makeFormatArg(args)..., cpplogs::FormatArg() };
+            format(out, fmt, N - 1, list, sizeof...(Args));
+        }
+    };
+}
+
+#endif
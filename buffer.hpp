@@ -0,0 +1,127 @@
+#ifndef __LOGS_BUFFER_H__
+#define __LOGS_BUFFER_H__
+
+/*
+ * buffer.hpp 异步日志缓冲区
+ * 1. 预先分配一块连续内存，生产者将格式化后的日志追加到其中
+ * 2. 提供读写位置管理，消费者按可读区域整体落地
+ * 3. 支持与另一块缓冲区交换（双缓冲），减少生产者与消费者的锁冲突
+*/
+
+#include <vector>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+namespace cpplogs
+{
+    #define DEFAULT_BUFFER_SIZE (1 * 1024 * 1024)//默认缓冲区大小 1M
+    #define THRESHOLD_BUFFER_SIZE (8 * 1024 * 1024)//阈值，小于阈值翻倍增长，大于阈值线性增长
+    #define INCREMENT_BUFFER_SIZE (1 * 1024 * 1024)//超过阈值后每次增长的大小
+
+    class Buffer
+    {
+    public:
+        Buffer(size_t capacity = DEFAULT_BUFFER_SIZE)
+        : _buffer(capacity)
+        , _reader_idx(0)
+        , _writer_idx(0)
+        {}
+
+        //向缓冲区写入数据，空间不足时扩容（是否允许写入由上层决定）
+        void push(const char* data, size_t len)
+        {
+            ensureEnoughSize(len);
+            std::copy(data, data + len, _buffer.data() + _writer_idx);
+            moveWriter(len);
+        }
+        void push(char ch)
+        {
+            ensureEnoughSize(1);
+            _buffer[_writer_idx++] = ch;
+        }
+        //可写空间大小
+        size_t writeAbleSize() const
+        {
+            return _buffer.size() - _writer_idx;
+        }
+        //可读数据大小
+        size_t readAbleSize() const
+        {
+            return _writer_idx - _reader_idx;
+        }
+        //缓冲区总容量
+        size_t capacity() const
+        {
+            return _buffer.size();
+        }
+        //可读数据起始地址
+        const char* begin() const
+        {
+            return _buffer.data() + _reader_idx;
+        }
+        //可写区域起始地址，配合 ensureEnoughSize 与 moveWriter 直接在缓冲区内写入
+        char* writeBegin()
+        {
+            return _buffer.data() + _writer_idx;
+        }
+        //移动读指针
+        void moveReader(size_t len)
+        {
+            assert(len <= readAbleSize());
+            _reader_idx += len;
+        }
+        //重置读写位置，缓冲区内存保留复用
+        void reset()
+        {
+            _reader_idx = 0;
+            _writer_idx = 0;
+        }
+        //交换两个缓冲区
+        void swap(cpplogs::Buffer& buffer)
+        {
+            _buffer.swap(buffer._buffer);
+            std::swap(_reader_idx, buffer._reader_idx);
+            std::swap(_writer_idx, buffer._writer_idx);
+        }
+        bool empty() const
+        {
+            return _reader_idx == _writer_idx;
+        }
+
+        //保证可写空间足够，不足则扩容
+        void ensureEnoughSize(size_t len)
+        {
+            if(len <= writeAbleSize())
+            {
+                return;
+            }
+            size_t new_size = _buffer.size();
+            while(new_size - _writer_idx < len)
+            {
+                if(new_size < THRESHOLD_BUFFER_SIZE)
+                {
+                    new_size = new_size == 0 ? len : new_size * 2;//小于阈值，翻倍增长
+                }
+                else
+                {
+                    new_size += INCREMENT_BUFFER_SIZE;//大于阈值，线性增长
+                }
+            }
+            _buffer.resize(new_size);
+        }
+        //移动写指针
+        void moveWriter(size_t len)
+        {
+            assert(len <= writeAbleSize());
+            _writer_idx += len;
+        }
+
+    private:
+        std::vector<char> _buffer;
+        size_t _reader_idx;//当前可读数据的起始位置
+        size_t _writer_idx;//当前可写数据的起始位置
+    };
+}
+
+#endif
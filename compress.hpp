@@ -0,0 +1,350 @@
+#ifndef __LOGS_COMPRESS_H__
+#define __LOGS_COMPRESS_H__
+
+/*
+ * compress.hpp 日志文件压缩（依赖 zlib，链接时需要 -lz）
+ * 1. Compressor: 后台低优先级线程，将滚动落地方向切换出来的旧文件流式压缩为 gzip
+ *    先写入临时文件 xxx.log.gz.tmp，完成后原子重命名为 xxx.log.gz 再删除原文件，任何时刻都不会出现不完整的 .gz
+ * 2. 提交任务不阻塞落地线程，队列有上限，队列满时放弃压缩该文件（原文件保留）并计数
+ * 3. GzipFileSink: 边写边压缩的落地方向，每次写出的数据压缩为一个独立的 gzip 成员
+ *    多个成员直接拼接仍是合法的 gzip 文件（zcat/gunzip 可直接读取），进程崩溃最多丢失未写出的一帧
+*/
+
+#include "sink.hpp"
+#include <zlib.h>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+namespace cpplogs
+{
+    #define DEFAULT_COMPRESS_QUEUE_SIZE 64//压缩队列默认上限
+    #define DEFAULT_GZIP_FRAME_SIZE (256 * 1024)//边写边压缩时每帧的默认大小
+
+    //压缩统计信息
+    struct CompressStats
+    {
+        size_t submitted;//已提交的文件数
+        size_t compressed;//压缩完成的文件数
+        size_t failed;//压缩失败的文件数（原文件保留）
+        size_t dropped;//队列满被放弃的文件数（原文件保留）
+        size_t queued;//当前排队的文件数
+        size_t bytes_in;//压缩前的总字节数
+        size_t bytes_out;//压缩后的总字节数
+    };
+
+    class Compressor
+    {
+    public:
+        using ptr = std::shared_ptr<cpplogs::Compressor>;
+
+        Compressor(size_t max_queue = DEFAULT_COMPRESS_QUEUE_SIZE, int level = Z_DEFAULT_COMPRESSION)
+        : _stop(false)
+        , _busy(false)
+        , _max_queue(max_queue == 0 ? 1 : max_queue)
+        , _level(level)
+        , _submitted(0)
+        , _compressed(0)
+        , _failed(0)
+        , _dropped(0)
+        , _bytes_in(0)
+        , _bytes_out(0)
+        , _thread(std::thread(&Compressor::threadEntry, this))
+        {}
+        //析构时处理完队列中剩余的文件再退出
+        ~Compressor()
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _cond.notify_all();
+            _thread.join();
+        }
+
+        //提交一个已写完的文件，不阻塞；队列满时返回 false，原文件保持不压缩
+        bool submit(const std::string& pathname)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if(_stop || _queue.size() >= _max_queue)
+                {
+                    _dropped++;
+                    return false;
+                }
+                _queue.push_back(pathname);
+                _submitted++;
+            }
+            _cond.notify_one();
+            return true;
+        }
+
+        //作为滚动落地方向的滚动回调
+        //回调持有 Compressor 的弱引用，Compressor 先于落地方向销毁时回调不再提交
+        static cpplogs::RollCallback rollCallback(const cpplogs::Compressor::ptr& compressor)
+        {
+            std::weak_ptr<cpplogs::Compressor> weak = compressor;
+            return [weak](const std::string& pathname) {
+                cpplogs::Compressor::ptr c = weak.lock();
+                if(c)
+                {
+                    c->submit(pathname);
+                }
+            };
+        }
+
+        cpplogs::CompressStats stats()
+        {
+            cpplogs::CompressStats st;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                st.queued = _queue.size();
+            }
+            st.submitted = _submitted;
+            st.compressed = _compressed;
+            st.failed = _failed;
+            st.dropped = _dropped;
+            st.bytes_in = _bytes_in;
+            st.bytes_out = _bytes_out;
+            return st;
+        }
+
+        //等待当前队列中的文件全部处理完毕
+        void wait()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cond_idle.wait(lock, [&](){ return _queue.empty() && !_busy; });
+        }
+
+        //将 src 流式压缩为 dst（gzip 格式），成功返回 true，in/out 返回压缩前后的字节数
+        static bool compressFile(const std::string& src, const std::string& dst, int level, size_t& in, size_t& out)
+        {
+            in = out = 0;
+            int fd = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+            if(fd < 0)
+            {
+                std::cerr << "[ERROR]cpplogs::Compressor::compressFile::打开文件失败: " << src << std::endl;
+                return false;
+            }
+            char mode[8] = "wb";
+            if(level >= 0 && level <= 9)
+            {
+                mode[2] = static_cast<char>('0' + level);
+                mode[3] = '\0';
+            }
+            gzFile gz = gzopen(dst.c_str(), mode);
+            if(gz == nullptr)
+            {
+                std::cerr << "[ERROR]cpplogs::Compressor::compressFile::创建文件失败: " << dst << std::endl;
+                ::close(fd);
+                return false;
+            }
+            gzbuffer(gz, 128 * 1024);
+            std::vector<char> buf(128 * 1024);
+            bool ok = true;
+            while(true)
+            {
+                ssize_t n = ::read(fd, buf.data(), buf.size());
+                if(n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if(n <= 0)
+                {
+                    ok = (n == 0);
+                    break;
+                }
+                if(gzwrite(gz, buf.data(), static_cast<unsigned>(n)) != n)
+                {
+                    ok = false;
+                    break;
+                }
+                in += n;
+            }
+            ::close(fd);
+            if(gzclose(gz) != Z_OK)
+            {
+                ok = false;
+            }
+            struct stat st;
+            if(ok && stat(dst.c_str(), &st) == 0)
+            {
+                out = st.st_size;
+            }
+            return ok;
+        }
+
+    private:
+        void threadEntry()
+        {
+            //降低压缩线程的调度优先级，避免与业务线程争抢 CPU（Linux 下对单个线程生效）
+            setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+            while(true)
+            {
+                std::string pathname;
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _busy = false;
+                    if(_queue.empty())
+                    {
+                        _cond_idle.notify_all();
+                    }
+                    _cond.wait(lock, [&](){ return _stop || !_queue.empty(); });
+                    if(_queue.empty())//已停止且无剩余任务
+                    {
+                        return;
+                    }
+                    pathname = _queue.front();
+                    _queue.pop_front();
+                    _busy = true;
+                }
+                compressOne(pathname);
+            }
+        }
+
+        //压缩到临时文件，重命名为最终文件名后删除原文件
+        void compressOne(const std::string& pathname)
+        {
+            std::string dst = pathname + ".gz";
+            std::string tmp = dst + ".tmp";
+            size_t in = 0, out = 0;
+            if(!compressFile(pathname, tmp, _level, in, out) || rename(tmp.c_str(), dst.c_str()) != 0)
+            {
+                std::cerr << "[ERROR]cpplogs::Compressor::compressOne::压缩失败, 保留原文件: " << pathname << std::endl;
+                unlink(tmp.c_str());
+                _failed++;
+                return;
+            }
+            unlink(pathname.c_str());
+            _bytes_in += in;
+            _bytes_out += out;
+            _compressed++;
+        }
+
+    private:
+        bool _stop;
+        bool _busy;//工作线程是否正在压缩
+        size_t _max_queue;
+        int _level;//压缩等级
+        std::deque<std::string> _queue;//待压缩的文件
+        std::mutex _mutex;
+        std::condition_variable _cond;
+        std::condition_variable _cond_idle;
+        std::atomic<size_t> _submitted;
+        std::atomic<size_t> _compressed;
+        std::atomic<size_t> _failed;
+        std::atomic<size_t> _dropped;
+        std::atomic<size_t> _bytes_in;
+        std::atomic<size_t> _bytes_out;
+        std::thread _thread;
+    };
+
+    //落地方向: 指定文件（边写边压缩，gzip）
+    //刷新策略决定每帧的大小，帧越大压缩率越高，进程崩溃时丢失的数据也越多
+    class GzipFileSink : public LogSink
+    {
+    public:
+        GzipFileSink(const std::string& pathname,
+            const cpplogs::FlushPolicy& policy = cpplogs::FlushPolicy(DEFAULT_GZIP_FRAME_SIZE),
+            int level = Z_DEFAULT_COMPRESSION)
+        : _pathname(pathname)
+        , _policy(policy)
+        , _file(cpplogs::FlushPolicy::immediate())
+        , _pending(policy.bytes == 0 ? 4096 : policy.bytes)
+        , _frame(4096)
+        , _pending_records(0)
+        {
+            memset(&_zs, 0, sizeof(_zs));
+            //windowBits 为 15 + 16 表示输出 gzip 格式
+            int ret = deflateInit2(&_zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+            assert(ret == Z_OK);
+            (void)ret;
+            cpplogs::util::File::createDirectory(cpplogs::util::File::path(_pathname));
+            _file.setStats(&_stats);
+            _file.open(_pathname);
+            assert(_file.isOpen());
+        }
+        ~GzipFileSink()
+        {
+            flush();
+            deflateEnd(&_zs);
+        }
+        std::string name() const override
+        {
+            return "gzip-file:" + _pathname;
+        }
+
+        void log(const char* data, size_t len) override
+        {
+            log(data, len, cpplogs::LogLevel::value::UNKNOW);
+        }
+        void log(const char* data, size_t len, cpplogs::LogLevel::value level) override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if(!_pending.empty() && _pending.writeAbleSize() < len)//剩余空间不足，先压缩写出
+            {
+                flushFrame();
+            }
+            _pending.push(data, len);
+            _pending_records++;
+            if(_pending.readAbleSize() >= _policy.bytes
+                || (_policy.records != 0 && _pending_records >= _policy.records)
+                || (_policy.level != cpplogs::LogLevel::value::OFF && level >= _policy.level))
+            {
+                flushFrame();
+            }
+        }
+        void flush() override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            flushFrame();
+        }
+
+    private:
+        //将缓存的数据压缩为一个 gzip 成员写入文件
+        void flushFrame()
+        {
+            if(_pending.empty())
+            {
+                return;
+            }
+            size_t bound = deflateBound(&_zs, _pending.readAbleSize());
+            _frame.reset();
+            _frame.ensureEnoughSize(bound);
+            _zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(_pending.begin()));
+            _zs.avail_in = static_cast<uInt>(_pending.readAbleSize());
+            _zs.next_out = reinterpret_cast<Bytef*>(_frame.writeBegin());
+            _zs.avail_out = static_cast<uInt>(_frame.writeAbleSize());
+            int ret = deflate(&_zs, Z_FINISH);
+            if(ret != Z_STREAM_END)
+            {
+                std::cerr << "[ERROR]cpplogs::GzipFileSink::flush::压缩失败: " << ret << std::endl;
+                _stats.onError();
+            }
+            else
+            {
+                _frame.moveWriter(_frame.writeAbleSize() - _zs.avail_out);
+                _file.write(_frame.begin(), _frame.readAbleSize(), cpplogs::LogLevel::value::UNKNOW);
+            }
+            deflateReset(&_zs);//下一帧重新开始一个独立的 gzip 成员
+            _pending.reset();
+            _pending_records = 0;
+        }
+
+    private:
+        std::mutex _mutex;
+        const std::string _pathname;
+        cpplogs::FlushPolicy _policy;
+        cpplogs::FdFile _file;
+        cpplogs::Buffer _pending;//尚未压缩的数据
+        cpplogs::Buffer _frame;//压缩后的一帧
+        size_t _pending_records;
+        z_stream _zs;
+    };
+}
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef __LOGS_CPPLOGS_H__
+#define __LOGS_CPPLOGS_H__
+
+/*
+ * cpplogs.hpp 对外使用的头文件
+ * 1. 包含日志器及落地方向等模块
+ * 2. 提供调用点宏 LOG_DEBUG/LOG_INFO/LOG_WARN/LOG_ERROR/LOG_FATAL(logger, fmt, ...)
+ *    自动填入 __FILE__ 与 __LINE__（const char* 与整数，不构造临时对象）
+ * 3. 编译期裁剪：低于 CPPLOGS_ACTIVE_LEVEL 的宏展开为空语句，参数不会被求值
+ *    例如在 release 构建中 -DCPPLOGS_ACTIVE_LEVEL=CPPLOGS_LEVEL_INFO 去掉所有调试日志
+ * 4. 运行期快速判断：宏先内联检查日志器的限制等级，等级不足时直接跳过，参数同样不会被求值
+ * 5. {} 风格的调用点宏 LOG_DEBUG_FMT ... LOG_FATAL_FMT(logger, "user {} took {} ms", id, dur)
+ *    fmt 必须是字符串字面量，编译期检查 {} 的个数与参数个数是否一致
+ * 6. 全局日志器：GlobalLoggerBuilder 构造并注册，cpplogs::getLogger("name") / cpplogs::rootLogger() 获取（见 manager.hpp）
+*/
+
+#include "logger.hpp"
+#include "manager.hpp"
+
+#define CPPLOGS_LEVEL_DEBUG 1
+#define CPPLOGS_LEVEL_INFO 2
+#define CPPLOGS_LEVEL_WARN 3
+#define CPPLOGS_LEVEL_ERROR 4
+#define CPPLOGS_LEVEL_FATAL 5
+#define CPPLOGS_LEVEL_OFF 6
+
+#ifndef CPPLOGS_ACTIVE_LEVEL
+#define CPPLOGS_ACTIVE_LEVEL CPPLOGS_LEVEL_DEBUG
+#endif
+
+#define CPPLOGS_LIKELY(x) __builtin_expect(!!(x), 1)
+#define CPPLOGS_UNLIKELY(x) __builtin_expect(!!(x), 0)
+
+//logger 可以是 Logger 指针或 Logger::ptr，只求值一次
+//日志调用标记为冷路径，不影响调用点所在函数热路径的代码布局
+#define CPPLOGS_LOG_CALL(logger, lv, method, fmt, ...) \
+    do { \
+        auto&& cpplogs_logger_ = (logger); \
+        if(CPPLOGS_UNLIKELY(cpplogs_logger_->shouldLog(cpplogs::LogLevel::value::lv))) \
+        { \
+            cpplogs_logger_->method(__FILE__, __LINE__, fmt, ##__VA_ARGS__); \
+        } \
+        else \
+        { \
+            cpplogs_logger_->onFiltered(cpplogs::LogLevel::value::lv); \
+        } \
+    } while(0)
+
+#define CPPLOGS_FMT_CALL(logger, lv, method, fmt, ...) \
+    do { \
+        static_assert(cpplogs::detail::countPlaceholders(fmt) != cpplogs::detail::INVALID_PLACEHOLDERS, \
+            "cpplogs: 格式化字符串中存在未配对的 { 或 }."); \
+        static_assert(cpplogs::detail::countPlaceholders(fmt) == decltype(cpplogs::detail::countArgs(__VA_ARGS__))::value, \
+            "cpplogs: {} 的个数与参数个数不一致."); \
+        auto&& cpplogs_logger_ = (logger); \
+        if(CPPLOGS_UNLIKELY(cpplogs_logger_->shouldLog(cpplogs::LogLevel::value::lv))) \
+        { \
+            cpplogs_logger_->method(cpplogs::Fmt(fmt, __FILE__, __LINE__), ##__VA_ARGS__); \
+        } \
+        else \
+        { \
+            cpplogs_logger_->onFiltered(cpplogs::LogLevel::value::lv); \
+        } \
+    } while(0)
+
+#define CPPLOGS_LOG_NONE() do { } while(0)
+
+#if CPPLOGS_ACTIVE_LEVEL <= CPPLOGS_LEVEL_DEBUG
+#define LOG_DEBUG(logger, fmt, ...) CPPLOGS_LOG_CALL(logger, DEBUG, debug, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG_FMT(logger, fmt, ...) CPPLOGS_FMT_CALL(logger, DEBUG, debug, fmt, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(logger, fmt, ...) CPPLOGS_LOG_NONE()
+#define LOG_DEBUG_FMT(logger, fmt, ...) CPPLOGS_LOG_NONE()
+#endif
+
+#if CPPLOGS_ACTIVE_LEVEL <= CPPLOGS_LEVEL_INFO
+#define LOG_INFO(logger, fmt, ...) CPPLOGS_LOG_CALL(logger, INFO, info, fmt, ##__VA_ARGS__)
+#define LOG_INFO_FMT(logger, fmt, ...) CPPLOGS_FMT_CALL(logger, INFO, info, fmt, ##__VA_ARGS__)
+#else
+#define LOG_INFO(logger, fmt, ...) CPPLOGS_LOG_NONE()
+#define LOG_INFO_FMT(logger, fmt, ...) CPPLOGS_LOG_NONE()
+#endif
+
+#if CPPLOGS_ACTIVE_LEVEL <= CPPLOGS_LEVEL_WARN
+#define LOG_WARN(logger, fmt, ...) CPPLOGS_LOG_CALL(logger, WARN, warn, fmt, ##__VA_ARGS__)
+#define LOG_WARN_FMT(logger, fmt, ...) CPPLOGS_FMT_CALL(logger, WARN, warn, fmt, ##__VA_ARGS__)
+#else
+#define LOG_WARN(logger, fmt, ...) CPPLOGS_LOG_NONE()
+#define LOG_WARN_FMT(logger, fmt, ...) CPPLOGS_LOG_NONE()
+#endif
+
+#if CPPLOGS_ACTIVE_LEVEL <= CPPLOGS_LEVEL_ERROR
+#define LOG_ERROR(logger, fmt, ...) CPPLOGS_LOG_CALL(logger, ERROR, error, fmt, ##__VA_ARGS__)
+#define LOG_ERROR_FMT(logger, fmt, ...) CPPLOGS_FMT_CALL(logger, ERROR, error, fmt, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(logger, fmt, ...) CPPLOGS_LOG_NONE()
+#define LOG_ERROR_FMT(logger, fmt, ...) CPPLOGS_LOG_NONE()
+#endif
+
+#if CPPLOGS_ACTIVE_LEVEL <= CPPLOGS_LEVEL_FATAL
+#define LOG_FATAL(logger, fmt, ...) CPPLOGS_LOG_CALL(logger, FATAL, fatal, fmt, ##__VA_ARGS__)
+#define LOG_FATAL_FMT(logger, fmt, ...) CPPLOGS_FMT_CALL(logger, FATAL, fatal, fmt, ##__VA_ARGS__)
+#else
+#define LOG_FATAL(logger, fmt, ...) CPPLOGS_LOG_NONE()
+#define LOG_FATAL_FMT(logger, fmt, ...) CPPLOGS_LOG_NONE()
+#endif
+
+#endif
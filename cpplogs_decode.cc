@@ -0,0 +1,360 @@
+#include "format.hpp"
+#include "binary.hpp"
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+#include <cstdio>
+
+/*
+ * cpplogs_decode.cc 二进制日志离线解码工具
+ * 1. 按顺序读取二进制日志文件（滚动文件需要按产生顺序一起传入），未指定文件时读取标准输入
+ * 2. 根据调用点登记记录还原格式化字符串，逐个转换说明格式化参数
+ * 3. 使用 Formmatter 规则输出文本日志
+ *
+ * 用法: cpplogs-decode [-p pattern] [file...]
+*/
+
+struct DecodeSite
+{
+    cpplogs::LogLevel::value level;
+    size_t line;
+    std::string file;
+    std::string logger;
+    std::string fmt;
+    std::vector<cpplogs::BinarySpec> specs;
+};
+
+//带边界检查的读取器
+class Reader
+{
+public:
+    Reader(const char* data, size_t len)
+    : _data(data)
+    , _len(len)
+    , _pos(0)
+    {}
+    template<typename T>
+    bool read(T& value)
+    {
+        if(_len - _pos < sizeof(T))
+        {
+            return false;
+        }
+        memcpy(&value, _data + _pos, sizeof(T));
+        _pos += sizeof(T);
+        return true;
+    }
+    bool read(std::string& str, size_t len)
+    {
+        if(_len - _pos < len)
+        {
+            return false;
+        }
+        str.assign(_data + _pos, len);
+        _pos += len;
+        return true;
+    }
+    template<typename LenType>
+    bool readString(std::string& str)
+    {
+        LenType len;
+        return read(len) && read(str, len);
+    }
+    size_t pos() const
+    {
+        return _pos;
+    }
+    void seek(size_t pos)
+    {
+        _pos = pos;
+    }
+    size_t remain() const
+    {
+        return _len - _pos;
+    }
+private:
+    const char* _data;
+    size_t _len;
+    size_t _pos;
+};
+
+//按转换说明格式化一个参数，'*' 宽度/精度作为前置的 int 参数
+template<typename T>
+static void appendSpec(std::string& out, const std::string& spec, const std::vector<int>& stars, T value)
+{
+    char tmp[512];
+    int ret = 0;
+    if(stars.size() == 0)
+    {
+        ret = snprintf(tmp, sizeof(tmp), spec.c_str(), value);
+    }
+    else if(stars.size() == 1)
+    {
+        ret = snprintf(tmp, sizeof(tmp), spec.c_str(), stars[0], value);
+    }
+    else
+    {
+        ret = snprintf(tmp, sizeof(tmp), spec.c_str(), stars[0], stars[1], value);
+    }
+    if(ret < 0)
+    {
+        return;
+    }
+    if(static_cast<size_t>(ret) < sizeof(tmp))
+    {
+        out.append(tmp, ret);
+        return;
+    }
+    std::vector<char> big(ret + 1);
+    if(stars.size() == 0)
+    {
+        snprintf(big.data(), big.size(), spec.c_str(), value);
+    }
+    else if(stars.size() == 1)
+    {
+        snprintf(big.data(), big.size(), spec.c_str(), stars[0], value);
+    }
+    else
+    {
+        snprintf(big.data(), big.size(), spec.c_str(), stars[0], stars[1], value);
+    }
+    out.append(big.data(), ret);
+}
+
+//还原主体消息
+static bool renderPayload(const DecodeSite& site, Reader& args, std::string& out)
+{
+    out.clear();
+    size_t pos = 0;
+    for(auto& spec : site.specs)
+    {
+        //转换说明之前的原始字符，%% 为 '%'
+        for(size_t i = pos; i < spec.begin; i++)
+        {
+            out.push_back(site.fmt[i]);
+            if(site.fmt[i] == '%' && i + 1 < spec.begin && site.fmt[i + 1] == '%')
+            {
+                i++;
+            }
+        }
+        pos = spec.end;
+        std::string spec_str = site.fmt.substr(spec.begin, spec.end - spec.begin);
+        std::vector<int> stars;
+        for(size_t i = 0; i < spec.args.size(); i++)
+        {
+            bool last = (i + 1 == spec.args.size());
+            switch(spec.args[i])
+            {
+            case cpplogs::BinaryArg::INT32:
+            {
+                int32_t value;
+                if(!args.read(value))
+                {
+                    return false;
+                }
+                if(!last)
+                {
+                    stars.push_back(value);
+                }
+                else
+                {
+                    appendSpec(out, spec_str, stars, static_cast<int>(value));
+                }
+                break;
+            }
+            case cpplogs::BinaryArg::INT64:
+            {
+                int64_t value;
+                if(!args.read(value))
+                {
+                    return false;
+                }
+                appendSpec(out, spec_str, stars, static_cast<long long>(value));
+                break;
+            }
+            case cpplogs::BinaryArg::DOUBLE:
+            case cpplogs::BinaryArg::LDOUBLE:
+            {
+                double value;
+                if(!args.read(value))
+                {
+                    return false;
+                }
+                if(spec.args[i] == cpplogs::BinaryArg::LDOUBLE)//按 double 存储，去掉 L 修饰
+                {
+                    spec_str.erase(spec_str.find('L'), 1);
+                }
+                appendSpec(out, spec_str, stars, value);
+                break;
+            }
+            case cpplogs::BinaryArg::STRING:
+            {
+                std::string value;
+                if(!args.readString<uint32_t>(value))
+                {
+                    return false;
+                }
+                appendSpec(out, spec_str, stars, value.c_str());
+                break;
+            }
+            case cpplogs::BinaryArg::POINTER:
+            {
+                uint64_t value;
+                if(!args.read(value))
+                {
+                    return false;
+                }
+                appendSpec(out, spec_str, stars, reinterpret_cast<void*>(value));
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+    }
+    for(size_t i = pos; i < site.fmt.size(); i++)
+    {
+        out.push_back(site.fmt[i]);
+        if(site.fmt[i] == '%' && i + 1 < site.fmt.size() && site.fmt[i + 1] == '%')
+        {
+            i++;
+        }
+    }
+    return true;
+}
+
+//解码 data 中的完整记录，返回已处理的字节数（末尾不完整的记录留待与下一个文件拼接）
+static size_t decode(const std::string& data, std::unordered_map<uint32_t, DecodeSite>& sites,
+    cpplogs::Formmatter& fmt, cpplogs::Buffer& out)
+{
+    Reader reader(data.data(), data.size());
+    std::string payload;
+    while(reader.remain() > 0)
+    {
+        size_t begin = reader.pos();
+        char type;
+        reader.read(type);
+        if(type == 'S')
+        {
+            uint32_t id;
+            uint8_t level;
+            uint32_t line;
+            uint16_t nargs;
+            DecodeSite site;
+            if(!reader.read(id) || !reader.read(level) || !reader.read(line)
+                || !reader.readString<uint16_t>(site.file) || !reader.readString<uint16_t>(site.logger)
+                || !reader.readString<uint32_t>(site.fmt) || !reader.read(nargs))
+            {
+                reader.seek(begin);
+                break;
+            }
+            std::string types;
+            if(!reader.read(types, nargs))
+            {
+                reader.seek(begin);
+                break;
+            }
+            site.level = static_cast<cpplogs::LogLevel::value>(level);
+            site.line = line;
+            if(!cpplogs::BinaryFormat::parse(site.fmt.c_str(), site.specs))
+            {
+                std::cerr << "[WARN]cpplogs-decode::无法解析的格式化字符串: " << site.fmt << std::endl;
+            }
+            sites[id] = site;
+        }
+        else if(type == 'L')
+        {
+            uint32_t id;
+            uint64_t sec;
+            uint32_t nsec;
+            uint64_t tid;
+            uint32_t len;
+            std::string args;
+            if(!reader.read(id) || !reader.read(sec) || !reader.read(nsec) || !reader.read(tid)
+                || !reader.read(len) || !reader.read(args, len))
+            {
+                reader.seek(begin);
+                break;
+            }
+            auto it = sites.find(id);
+            if(it == sites.end())
+            {
+                std::cerr << "[WARN]cpplogs-decode::未登记的调用点: " << id << std::endl;
+                continue;
+            }
+            Reader args_reader(args.data(), args.size());
+            if(!renderPayload(it->second, args_reader, payload))
+            {
+                std::cerr << "[WARN]cpplogs-decode::参数数据不完整, 调用点: " << id << std::endl;
+            }
+            cpplogs::LogMsg msg(it->second.level, it->second.line, it->second.file.c_str(),
+                it->second.logger.c_str(), payload.data(), payload.size());
+            msg._ctime = static_cast<time_t>(sec);
+            msg._nsec = nsec;
+            msg._tid = tid;
+            fmt.format(out, msg);
+            if(out.readAbleSize() >= 64 * 1024)
+            {
+                fwrite(out.begin(), 1, out.readAbleSize(), stdout);
+                out.reset();
+            }
+        }
+        else
+        {
+            std::cerr << "[ERROR]cpplogs-decode::无效的记录类型, 偏移: " << begin << std::endl;
+            return data.size();
+        }
+    }
+    return reader.pos();
+}
+
+int main(int argc, char* argv[])
+{
+    std::string pattern = "[%d{%H:%M:%S}][%t][%c][%f:%l][%p]%T%m%n";
+    std::vector<std::string> files;
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if(arg == "-p" && i + 1 < argc)
+        {
+            pattern = argv[++i];
+        }
+        else if(arg == "-h" || arg == "--help")
+        {
+            std::cout << "用法: cpplogs-decode [-p pattern] [file...]" << std::endl;
+            return 0;
+        }
+        else
+        {
+            files.push_back(arg);
+        }
+    }
+
+    cpplogs::Formmatter fmt(pattern);
+    cpplogs::Buffer out(64 * 1024);
+    std::unordered_map<uint32_t, DecodeSite> sites;
+    std::string data;
+    if(files.empty())
+    {
+        data.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+        decode(data, sites, fmt, out);
+    }
+    for(auto& file : files)
+    {
+        std::ifstream ifs(file, std::ios::binary);
+        if(!ifs.is_open())
+        {
+            std::cerr << "[ERROR]cpplogs-decode::打开文件失败: " << file << std::endl;
+            return 1;
+        }
+        //上一个文件末尾不完整的记录与当前文件拼接
+        data.append(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+        data.erase(0, decode(data, sites, fmt, out));
+    }
+    fwrite(out.begin(), 1, out.readAbleSize(), stdout);
+    if(!data.empty() && !files.empty())
+    {
+        std::cerr << "[WARN]cpplogs-decode::末尾存在不完整的记录, " << data.size() << " 字节." << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,830 @@
+#include "level.hpp"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/*
+ * cpplogs_grep.cc 按 Formmatter 输出格式检索文本日志（多个滚动文件）
+ * 1. 按格式规则（-p，默认与 Formmatter 的默认规则相同）解析每一行的时间、等级、线程、日志器、文件与行号
+ * 2. 文件通过 mmap 映射，按行边界切分为若干块，由多个工作线程并行检索
+ * 3. 预过滤：先用 SIMD 子串查找（同时比较子串首尾两个字符）定位包含 -e 文本、日志器名称或等级的行，
+ *    只对候选行进行完整的解析与过滤
+ * 4. 过滤条件：文本（-e）、最低等级（-l）、日志器名称（-c）、调用点（-s file 或 file:line）、时间范围（--from/--to）
+ * 5. 所有匹配的行按时间戳排序后输出，时间相同时保持文件的传入顺序与文件内的顺序
+ *    时间戳只包含格式规则中出现的字段（默认规则只有时分秒），--from/--to 需使用同样的字段，如 12:00:00 或 2024-01-01 12:00:00.123
+ *    不符合格式规则的行（多行消息的后续行）使用前一条记录的时间戳，只参与 -e 的匹配
+ *
+ * 用法: cpplogs-grep [-p pattern] [-e text] [-l level] [-c logger] [-s file[:line]]
+ *                    [--from time] [--to time] [-j threads] [-H] file...
+ *   -H 在每一行前输出文件名
+*/
+
+//格式规则中的一项：key 为 0 表示原始字符串
+struct PatternItem
+{
+    char key;
+    std::string text;//原始字符串，或 %d 的子格式
+};
+
+//时间戳：sec 为按 年/月/日/时/分/秒 单调编码的秒数（格式规则中没有的字段为 0）
+struct TimeKey
+{
+    uint64_t sec;
+    uint32_t nsec;
+    bool operator<(const TimeKey& other) const
+    {
+        return sec < other.sec || (sec == other.sec && nsec < other.nsec);
+    }
+};
+
+//一行解析得到的字段
+struct LineFields
+{
+    TimeKey time;
+    int level;
+    const char* logger;
+    size_t logger_len;
+    const char* file;
+    size_t file_len;
+    size_t line;
+};
+
+//与 Formmatter::parsePattern 相同的规则，%T 与 %n 转换为原始字符串
+static bool parsePattern(const std::string& pattern, std::vector<PatternItem>& items)
+{
+    size_t pos = 0;
+    std::string literal;
+    while(pos < pattern.size())
+    {
+        if(pattern[pos] != '%')
+        {
+            literal.push_back(pattern[pos++]);
+            continue;
+        }
+        if(pos + 1 >= pattern.size())
+        {
+            std::cerr << "[ERROR]cpplogs-grep::未匹配的%." << std::endl;
+            return false;
+        }
+        char key = pattern[pos + 1];
+        pos += 2;
+        std::string sub;
+        if(pos < pattern.size() && pattern[pos] == '{')
+        {
+            size_t close = pattern.find('}', pos);
+            if(close == std::string::npos)
+            {
+                std::cerr << "[ERROR]cpplogs-grep::子格式{}匹配出错." << std::endl;
+                return false;
+            }
+            sub = pattern.substr(pos + 1, close - pos - 1);
+            pos = close + 1;
+        }
+        if(key == '%' || key == 'T' || key == 'n')
+        {
+            literal.push_back(key == '%' ? '%' : (key == 'T' ? '\t' : '\n'));
+            continue;
+        }
+        if(!literal.empty())
+        {
+            items.push_back(PatternItem{0, literal});
+            literal.clear();
+        }
+        if(key == 'd' && sub.empty())
+        {
+            sub = "%H:%M:%S";
+        }
+        items.push_back(PatternItem{key, sub});
+    }
+    //行尾的换行不参与解析
+    while(!literal.empty() && literal.back() == '\n')
+    {
+        literal.pop_back();
+    }
+    if(!literal.empty())
+    {
+        items.push_back(PatternItem{0, literal});
+    }
+    return true;
+}
+
+//SIMD 子串查找：同时比较候选位置的首字符与尾字符，两者都相等时再比较中间部分
+static const char* findSubstr(const char* s, size_t n, const char* needle, size_t m)
+{
+    if(m == 0)
+    {
+        return s;
+    }
+    if(n < m)
+    {
+        return nullptr;
+    }
+    if(m == 1)
+    {
+        return static_cast<const char*>(memchr(s, needle[0], n));
+    }
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i first32 = _mm256_set1_epi8(needle[0]);
+    const __m256i last32 = _mm256_set1_epi8(needle[m - 1]);
+    for(; i + m - 1 + 32 <= n; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + m - 1));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(a, first32), _mm256_cmpeq_epi8(b, last32))));
+        while(mask != 0)
+        {
+            size_t bit = __builtin_ctz(mask);
+            if(memcmp(s + i + bit + 1, needle + 1, m - 2) == 0)
+            {
+                return s + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+#if defined(__SSE2__) || defined(__AVX2__)
+    const __m128i first16 = _mm_set1_epi8(needle[0]);
+    const __m128i last16 = _mm_set1_epi8(needle[m - 1]);
+    for(; i + m - 1 + 16 <= n; i += 16)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + m - 1));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(a, first16), _mm_cmpeq_epi8(b, last16))));
+        while(mask != 0)
+        {
+            size_t bit = __builtin_ctz(mask);
+            if(memcmp(s + i + bit + 1, needle + 1, m - 2) == 0)
+            {
+                return s + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+    return static_cast<const char*>(memmem(s + i, n - i, needle, m));
+}
+
+//解析 digits 位十进制数字
+static bool readDigits(const char*& p, const char* end, int digits, uint64_t& value)
+{
+    if(end - p < digits)
+    {
+        return false;
+    }
+    value = 0;
+    for(int i = 0; i < digits; i++)
+    {
+        if(p[i] < '0' || p[i] > '9')
+        {
+            return false;
+        }
+        value = value * 10 + (p[i] - '0');
+    }
+    p += digits;
+    return true;
+}
+
+//按 strftime 子格式解析时间，支持 %Y %m %d %H %M %S 与 %ms/%us/%ns
+static bool parseTime(const std::string& fmt, const char*& p, const char* end, TimeKey& key)
+{
+    uint64_t year = 0, mon = 0, day = 0, hour = 0, min = 0, sec = 0, frac = 0;
+    int frac_digits = 0;
+    for(size_t i = 0; i < fmt.size(); i++)
+    {
+        if(fmt[i] != '%' || i + 1 >= fmt.size())
+        {
+            if(p >= end || *p != fmt[i])
+            {
+                return false;
+            }
+            p++;
+            continue;
+        }
+        char c = fmt[++i];
+        bool ok;
+        if((c == 'm' || c == 'u' || c == 'n') && i + 1 < fmt.size() && fmt[i + 1] == 's')
+        {
+            frac_digits = c == 'm' ? 3 : (c == 'u' ? 6 : 9);
+            ok = readDigits(p, end, frac_digits, frac);
+            i++;
+        }
+        else if(c == 'Y') ok = readDigits(p, end, 4, year);
+        else if(c == 'm') ok = readDigits(p, end, 2, mon);
+        else if(c == 'd') ok = readDigits(p, end, 2, day);
+        else if(c == 'H') ok = readDigits(p, end, 2, hour);
+        else if(c == 'M') ok = readDigits(p, end, 2, min);
+        else if(c == 'S') ok = readDigits(p, end, 2, sec);
+        else if(c == '%') ok = p < end && *p++ == '%';
+        else ok = false;//不支持的转换说明
+        if(!ok)
+        {
+            return false;
+        }
+    }
+    key.sec = ((((year * 13 + mon) * 32 + day) * 24 + hour) * 60 + min) * 60 + sec;
+    for(int i = frac_digits; i < 9; i++)
+    {
+        frac *= 10;
+    }
+    key.nsec = static_cast<uint32_t>(frac);
+    return true;
+}
+
+//解析命令行中的时间：[YYYY-MM-DD ]HH:MM:SS[.frac]
+static bool parseTimeArg(const std::string& arg, TimeKey& key)
+{
+    std::string fmt = arg.size() > 10 && arg[4] == '-' ? "%Y-%m-%d %H:%M:%S" : "%H:%M:%S";
+    size_t dot = arg.find('.');
+    std::string frac;
+    if(dot != std::string::npos)
+    {
+        frac = arg.substr(dot + 1);
+        frac.resize(9, '0');
+    }
+    std::string head = arg.substr(0, dot);
+    const char* p = head.c_str();
+    if(!parseTime(fmt, p, head.c_str() + head.size(), key) || *p != '\0')
+    {
+        return false;
+    }
+    key.nsec = frac.empty() ? 0 : static_cast<uint32_t>(strtoul(frac.c_str(), nullptr, 10));
+    return true;
+}
+
+static int parseLevel(const char* s, size_t len)
+{
+    for(int i = static_cast<int>(cpplogs::LogLevel::value::DEBUG); i <= static_cast<int>(cpplogs::LogLevel::value::FATAL); i++)
+    {
+        const char* name = cpplogs::LogLevel::toString(static_cast<cpplogs::LogLevel::value>(i));
+        if(strlen(name) == len && memcmp(name, s, len) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+//按格式规则解析一行（不含换行）
+class LineParser
+{
+public:
+    LineParser(const std::vector<PatternItem>& items)
+    : _items(items)
+    {}
+
+    bool parse(const char* p, const char* end, LineFields& fields) const
+    {
+        fields.time.sec = 0;
+        fields.time.nsec = 0;
+        fields.level = -1;
+        fields.logger = fields.file = nullptr;
+        fields.logger_len = fields.file_len = 0;
+        fields.line = 0;
+        for(size_t i = 0; i < _items.size(); i++)
+        {
+            const PatternItem& item = _items[i];
+            if(item.key == 0)
+            {
+                if(static_cast<size_t>(end - p) < item.text.size() || memcmp(p, item.text.data(), item.text.size()) != 0)
+                {
+                    return false;
+                }
+                p += item.text.size();
+                continue;
+            }
+            if(item.key == 'd')
+            {
+                if(!parseTime(item.text, p, end, fields.time))
+                {
+                    return false;
+                }
+                continue;
+            }
+            //字段到下一项原始字符串为止，最后一项到行尾
+            const char* value_end = end;
+            if(item.key != 'm' && i + 1 < _items.size())
+            {
+                const PatternItem& next = _items[i + 1];
+                if(next.key != 0)
+                {
+                    return false;//两个字段相邻，无法确定边界
+                }
+                value_end = findSubstr(p, end - p, next.text.data(), next.text.size());
+                if(value_end == nullptr)
+                {
+                    return false;
+                }
+            }
+            size_t len = value_end - p;
+            switch(item.key)
+            {
+            case 'p':
+                fields.level = parseLevel(p, len);
+                break;
+            case 'c':
+                fields.logger = p;
+                fields.logger_len = len;
+                break;
+            case 'f':
+                fields.file = p;
+                fields.file_len = len;
+                break;
+            case 'l':
+                for(size_t k = 0; k < len && p[k] >= '0' && p[k] <= '9'; k++)
+                {
+                    fields.line = fields.line * 10 + (p[k] - '0');
+                }
+                break;
+            case 'm':
+                //主体消息之后还有原始字符串时，消息到最后一次出现为止
+                if(i + 1 < _items.size())
+                {
+                    return true;
+                }
+                break;
+            default:
+                break;
+            }
+            p = value_end;
+        }
+        return true;
+    }
+
+private:
+    std::vector<PatternItem> _items;
+};
+
+//检索条件
+struct Filter
+{
+    std::string text;
+    int min_level = -1;
+    std::string logger;
+    std::string file;
+    size_t line = 0;
+    bool has_from = false;
+    bool has_to = false;
+    TimeKey from;
+    TimeKey to;
+
+    bool needFields() const
+    {
+        return min_level >= 0 || !logger.empty() || !file.empty() || has_from || has_to;
+    }
+    bool match(const LineFields& f) const
+    {
+        if(min_level >= 0 && f.level < min_level)
+        {
+            return false;
+        }
+        if(!logger.empty() && (f.logger_len != logger.size() || memcmp(f.logger, logger.data(), logger.size()) != 0))
+        {
+            return false;
+        }
+        if(!file.empty() && (f.file_len != file.size() || memcmp(f.file, file.data(), file.size()) != 0))
+        {
+            return false;
+        }
+        if(line != 0 && f.line != line)
+        {
+            return false;
+        }
+        if(has_from && f.time < from)
+        {
+            return false;
+        }
+        if(has_to && to < f.time)
+        {
+            return false;
+        }
+        return true;
+    }
+};
+
+struct MappedFile
+{
+    std::string path;
+    const char* data;
+    size_t size;
+};
+
+//一个检索块：某个文件中按行边界对齐的区间
+struct Chunk
+{
+    size_t file;
+    size_t begin;
+    size_t end;
+};
+
+struct Match
+{
+    TimeKey time;
+    uint32_t file;
+    size_t offset;
+    size_t len;
+    bool operator<(const Match& other) const
+    {
+        if(time < other.time) return true;
+        if(other.time < time) return false;
+        return file < other.file || (file == other.file && offset < other.offset);
+    }
+};
+
+class Searcher
+{
+public:
+    Searcher(const std::vector<PatternItem>& items, const Filter& filter)
+    : _parser(items)
+    , _filter(filter)
+    {
+        //预过滤使用的子串：-e 文本，其次是带两侧原始字符串的日志器名称，最后是允许的各等级名称
+        if(!filter.text.empty())
+        {
+            _needles.push_back(filter.text);
+        }
+        else if(!filter.logger.empty())
+        {
+            _needles.push_back(wrap(items, 'c', filter.logger));
+        }
+        else if(filter.min_level > static_cast<int>(cpplogs::LogLevel::value::DEBUG))
+        {
+            for(int i = filter.min_level; i <= static_cast<int>(cpplogs::LogLevel::value::FATAL); i++)
+            {
+                _needles.push_back(wrap(items, 'p', cpplogs::LogLevel::toString(static_cast<cpplogs::LogLevel::value>(i))));
+            }
+        }
+    }
+
+    //检索一个块，匹配的行追加到 out
+    void search(const MappedFile& file, const Chunk& chunk, std::vector<Match>& out) const
+    {
+        const char* base = file.data;
+        if(_needles.empty())
+        {
+            size_t pos = chunk.begin;
+            while(pos < chunk.end)
+            {
+                size_t end = lineEnd(base, pos, chunk.end);
+                check(base, chunk, pos, end, out);
+                pos = end + 1;
+            }
+            return;
+        }
+        std::vector<size_t> starts;
+        for(auto& needle : _needles)
+        {
+            size_t pos = chunk.begin;
+            while(pos < chunk.end)
+            {
+                const char* hit = findSubstr(base + pos, chunk.end - pos, needle.data(), needle.size());
+                if(hit == nullptr)
+                {
+                    break;
+                }
+                size_t start = lineStart(base, chunk.begin, hit - base);
+                starts.push_back(start);
+                pos = lineEnd(base, hit - base, chunk.end) + 1;
+            }
+        }
+        if(_needles.size() > 1)
+        {
+            std::sort(starts.begin(), starts.end());
+            starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+        }
+        for(size_t start : starts)
+        {
+            check(base, chunk, start, lineEnd(base, start, chunk.end), out);
+        }
+    }
+
+private:
+    //字段值两侧加上格式规则中相邻的原始字符串，减少误匹配
+    static std::string wrap(const std::vector<PatternItem>& items, char key, const std::string& value)
+    {
+        for(size_t i = 0; i < items.size(); i++)
+        {
+            if(items[i].key == key)
+            {
+                std::string ret = value;
+                if(i > 0 && items[i - 1].key == 0)
+                {
+                    ret = items[i - 1].text.substr(items[i - 1].text.size() - 1) + ret;
+                }
+                if(i + 1 < items.size() && items[i + 1].key == 0)
+                {
+                    ret += items[i + 1].text.substr(0, 1);
+                }
+                return ret;
+            }
+        }
+        return value;
+    }
+    static size_t lineStart(const char* base, size_t begin, size_t pos)
+    {
+        while(pos > begin && base[pos - 1] != '\n')
+        {
+            pos--;
+        }
+        return pos;
+    }
+    static size_t lineEnd(const char* base, size_t pos, size_t end)
+    {
+        const char* nl = static_cast<const char*>(memchr(base + pos, '\n', end - pos));
+        return nl == nullptr ? end : nl - base;
+    }
+
+    void check(const char* base, const Chunk& chunk, size_t start, size_t end, std::vector<Match>& out) const
+    {
+        //有 -e 文本时预过滤使用的就是该文本，候选行一定包含它
+        const char* p = base + start;
+        LineFields fields;
+        Match m;
+        m.file = static_cast<uint32_t>(chunk.file);
+        m.offset = start;
+        m.len = end - start;
+        if(_parser.parse(p, base + end, fields))
+        {
+            if(!_filter.match(fields))
+            {
+                return;
+            }
+            m.time = fields.time;
+        }
+        else
+        {
+            //多行消息的后续行：无法按字段过滤，使用前一条可以解析的记录的时间戳
+            if(_filter.needFields())
+            {
+                return;
+            }
+            if(!previousTime(base, chunk.begin, start, m.time))
+            {
+                m.time.sec = 0;
+                m.time.nsec = 0;
+            }
+        }
+        out.push_back(m);
+    }
+    bool previousTime(const char* base, size_t begin, size_t start, TimeKey& time) const
+    {
+        LineFields fields;
+        for(int i = 0; i < 64 && start > begin; i++)
+        {
+            size_t end = start - 1;
+            start = lineStart(base, begin, end);
+            if(_parser.parse(base + start, base + end, fields))
+            {
+                time = fields.time;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    LineParser _parser;
+    const Filter& _filter;
+    std::vector<std::string> _needles;
+};
+
+static bool mapFile(const std::string& path, MappedFile& file)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+    {
+        std::cerr << "[ERROR]cpplogs-grep::打开文件失败: " << path << std::endl;
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) < 0)
+    {
+        close(fd);
+        return false;
+    }
+    file.path = path;
+    file.size = st.st_size;
+    file.data = nullptr;
+    if(file.size != 0)
+    {
+        void* addr = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(addr == MAP_FAILED)
+        {
+            std::cerr << "[ERROR]cpplogs-grep::mmap 失败: " << path << std::endl;
+            close(fd);
+            return false;
+        }
+        madvise(addr, file.size, MADV_SEQUENTIAL);
+        file.data = static_cast<const char*>(addr);
+    }
+    close(fd);
+    return true;
+}
+
+//按行边界切分文件
+static void splitChunks(const std::vector<MappedFile>& files, size_t chunk_size, std::vector<Chunk>& chunks)
+{
+    for(size_t i = 0; i < files.size(); i++)
+    {
+        size_t pos = 0;
+        while(pos < files[i].size)
+        {
+            size_t end = pos + chunk_size;
+            if(end >= files[i].size)
+            {
+                end = files[i].size;
+            }
+            else
+            {
+                const char* nl = static_cast<const char*>(memchr(files[i].data + end, '\n', files[i].size - end));
+                end = nl == nullptr ? files[i].size : nl - files[i].data + 1;
+            }
+            chunks.push_back(Chunk{i, pos, end});
+            pos = end;
+        }
+    }
+}
+
+static void usage()
+{
+    std::cout << "用法: cpplogs-grep [-p pattern] [-e text] [-l level] [-c logger] [-s file[:line]]" << std::endl
+        << "                    [--from time] [--to time] [-j threads] [-H] file..." << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string pattern = "[%d{%H:%M:%S}][%t][%c][%f:%l][%p]%T%m%n";
+    Filter filter;
+    size_t threads = std::thread::hardware_concurrency();
+    bool with_name = false;
+    std::vector<std::string> paths;
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if(arg == "-p" && has_value)
+        {
+            pattern = argv[++i];
+        }
+        else if(arg == "-e" && has_value)
+        {
+            filter.text = argv[++i];
+        }
+        else if(arg == "-l" && has_value)
+        {
+            std::string level = argv[++i];
+            filter.min_level = parseLevel(level.data(), level.size());
+            if(filter.min_level < 0)
+            {
+                std::cerr << "[ERROR]cpplogs-grep::无效的等级: " << level << std::endl;
+                return 1;
+            }
+        }
+        else if(arg == "-c" && has_value)
+        {
+            filter.logger = argv[++i];
+        }
+        else if(arg == "-s" && has_value)
+        {
+            filter.file = argv[++i];
+            size_t colon = filter.file.rfind(':');
+            if(colon != std::string::npos)
+            {
+                filter.line = strtoul(filter.file.c_str() + colon + 1, nullptr, 10);
+                filter.file.erase(colon);
+            }
+        }
+        else if((arg == "--from" || arg == "--to") && has_value)
+        {
+            TimeKey& key = arg == "--from" ? filter.from : filter.to;
+            (arg == "--from" ? filter.has_from : filter.has_to) = true;
+            if(!parseTimeArg(argv[++i], key))
+            {
+                std::cerr << "[ERROR]cpplogs-grep::无效的时间: " << argv[i] << std::endl;
+                return 1;
+            }
+        }
+        else if(arg == "-j" && has_value)
+        {
+            threads = strtoul(argv[++i], nullptr, 10);
+        }
+        else if(arg == "-H")
+        {
+            with_name = true;
+        }
+        else if(arg == "-h" || arg == "--help")
+        {
+            usage();
+            return 0;
+        }
+        else
+        {
+            paths.push_back(arg);
+        }
+    }
+    if(paths.empty())
+    {
+        usage();
+        return 1;
+    }
+    if(threads == 0)
+    {
+        threads = 1;
+    }
+
+    std::vector<PatternItem> items;
+    if(!parsePattern(pattern, items))
+    {
+        return 1;
+    }
+    std::vector<MappedFile> files;
+    for(auto& path : paths)
+    {
+        MappedFile file;
+        if(!mapFile(path, file))
+        {
+            return 1;
+        }
+        files.push_back(file);
+    }
+    std::vector<Chunk> chunks;
+    splitChunks(files, 8 * 1024 * 1024, chunks);
+
+    //工作线程依次领取块，每个块的结果单独保存
+    Searcher searcher(items, filter);
+    std::vector<std::vector<Match>> results(chunks.size());
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for(size_t t = 0; t < std::min(threads, chunks.size()); t++)
+    {
+        workers.emplace_back([&]() {
+            for(size_t i = next++; i < chunks.size(); i = next++)
+            {
+                searcher.search(files[chunks[i].file], chunks[i], results[i]);
+            }
+        });
+    }
+    for(auto& th : workers)
+    {
+        th.join();
+    }
+
+    std::vector<Match> all;
+    size_t total = 0;
+    for(auto& r : results)
+    {
+        total += r.size();
+    }
+    all.reserve(total);
+    for(auto& r : results)
+    {
+        all.insert(all.end(), r.begin(), r.end());
+        std::vector<Match>().swap(r);
+    }
+    //块内大多已按时间有序，排序开销很小
+    std::sort(all.begin(), all.end());
+
+    std::vector<char> out;
+    out.reserve(1024 * 1024);
+    for(auto& m : all)
+    {
+        const MappedFile& file = files[m.file];
+        if(with_name)
+        {
+            out.insert(out.end(), file.path.begin(), file.path.end());
+            out.push_back(':');
+        }
+        out.insert(out.end(), file.data + m.offset, file.data + m.offset + m.len);
+        out.push_back('\n');
+        if(out.size() >= 1024 * 1024)
+        {
+            fwrite(out.data(), 1, out.size(), stdout);
+            out.clear();
+        }
+    }
+    fwrite(out.data(), 1, out.size(), stdout);
+    for(auto& file : files)
+    {
+        if(file.data != nullptr)
+        {
+            munmap(const_cast<char*>(file.data), file.size);
+        }
+    }
+    return 0;
+}
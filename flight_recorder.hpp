@@ -0,0 +1,396 @@
+#ifndef __LOGS_FLIGHT_RECORDER_H__
+#define __LOGS_FLIGHT_RECORDER_H__
+
+/*
+ * flight_recorder.hpp 飞行记录仪：在内存中保留最近的日志，出错时才写出
+ * 1. FlightRecorderSink 作为日志器的一个落地方向，把日志保存在环形缓冲区中，只保留最近 capacity 字节、
+ *    最多 max_records 条日志（0 表示只按字节数限制），平时没有任何 I/O
+ * 2. 触发条件：日志等级不低于 trigger_level、显式调用 trigger()；触发时按顺序把保留的日志写到真正的落地方向并清空
+ *    异步日志器按批落地，一批日志作为一条记录保存，批内的最高等级决定是否触发
+ * 3. 缓冲区位于文件的共享映射中（MAP_SHARED），进程崩溃后数据仍在页缓存/文件中；
+ *    下次以同一文件启动时，上次未写出的日志先被写到落地方向（前面附带一条恢复说明）
+ * 4. 致命信号（installCrashHandler）：落地方向的写入不是异步信号安全的，信号处理函数只把映射区同步到磁盘
+ *    （防止随后的系统崩溃丢失数据）并标记崩溃的信号，然后恢复安装前的处理方式：原有的处理函数直接调用，
+ *    默认处理重新发送信号；保留的日志在下次启动时写出
+ * 5. 正常析构时清空缓冲区，下次启动不会重复写出
+*/
+
+#include "sink.hpp"
+#include <vector>
+#include <string>
+#include <atomic>
+#include <cstdio>
+#include <csignal>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+namespace cpplogs
+{
+    #define CPPLOGS_FLIGHT_RECORDERS 16//可同时注册崩溃处理的飞行记录仪数量
+
+    class FlightRecorderSink : public LogSink
+    {
+    public:
+        using ptr = std::shared_ptr<FlightRecorderSink>;
+        FlightRecorderSink(const std::string& pathname, size_t capacity, size_t max_records,
+            const std::vector<cpplogs::LogSink::ptr>& sinks,
+            cpplogs::LogLevel::value trigger_level = cpplogs::LogLevel::value::ERROR)
+        : _pathname(pathname)
+        , _sinks(sinks)
+        , _trigger_level(trigger_level)
+        , _max_records(max_records)
+        , _fd(-1)
+        , _header(nullptr)
+        , _ring(nullptr)
+        , _capacity(capacity < 4096 ? 4096 : capacity)
+        {
+            cpplogs::util::File::createDirectory(cpplogs::util::File::path(_pathname));
+            bool ret = open();
+            assert(ret);
+            (void)ret;
+            registry(this, true);
+        }
+        ~FlightRecorderSink()
+        {
+            registry(this, false);
+            if(_header != nullptr)
+            {
+                //正常退出：保留的日志不需要恢复
+                _header->tail.store(_header->head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                _header->count.store(0, std::memory_order_relaxed);
+                munmap(_header, sizeof(Header) + _capacity);
+            }
+            if(_fd >= 0)
+            {
+                ::close(_fd);
+            }
+        }
+
+        void log(const char* data, size_t len) override
+        {
+            log(data, len, cpplogs::LogLevel::value::UNKNOW);
+        }
+        void log(const char* data, size_t len, cpplogs::LogLevel::value level) override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            append(data, len, level);
+            if(level != cpplogs::LogLevel::value::UNKNOW && level >= _trigger_level)
+            {
+                dump();
+            }
+        }
+        void flush() override
+        {
+            for(auto& sink : _sinks)
+            {
+                sink->flush();
+            }
+        }
+        std::string name() const override
+        {
+            return "flight-recorder:" + _pathname;
+        }
+
+        //立即把保留的日志写到落地方向
+        void trigger()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            dump();
+        }
+
+        //当前保留的日志条数与字节数（含记录头）
+        size_t records() const
+        {
+            return _header->count.load(std::memory_order_relaxed);
+        }
+        size_t bytes() const
+        {
+            return _header->head.load(std::memory_order_relaxed) - _header->tail.load(std::memory_order_relaxed);
+        }
+
+        //为致命信号（SIGSEGV、SIGBUS、SIGFPE、SIGILL、SIGABRT）安装处理函数，保存原有的处理方式，处理后交给它
+        //重复调用不会覆盖保存的处理方式；应在启动时调用，不与其他线程修改信号处理同时进行
+        static void installCrashHandler()
+        {
+            static const int signals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+            for(int signo : signals)
+            {
+                struct sigaction current;
+                if(sigaction(signo, nullptr, &current) < 0)
+                {
+                    std::cerr << "[ERROR]cpplogs::FlightRecorderSink::installCrashHandler::sigaction: " << strerror(errno) << std::endl;
+                    continue;
+                }
+                if((current.sa_flags & SA_SIGINFO) && current.sa_sigaction == onCrash)
+                {
+                    continue;
+                }
+                previous()[signo] = current;
+                struct sigaction action;
+                memset(&action, 0, sizeof(action));
+                action.sa_sigaction = onCrash;
+                sigemptyset(&action.sa_mask);
+                action.sa_flags = SA_SIGINFO;
+                sigaction(signo, &action, nullptr);
+            }
+        }
+
+    private:
+        //映射文件的头部，之后是 capacity 字节的环形缓冲区
+        struct Header
+        {
+            char magic[8];
+            uint64_t capacity;
+            std::atomic<uint64_t> head;//写入位置（累计字节数，取模后为缓冲区偏移）
+            std::atomic<uint64_t> tail;//最早保留的记录的位置
+            std::atomic<uint64_t> count;//保留的记录条数
+            std::atomic<uint64_t> crash_signal;//上次崩溃的信号，0 表示没有
+        };
+        //每条记录的头部
+        struct Record
+        {
+            uint32_t len;
+            uint32_t level;
+        };
+
+        bool open()
+        {
+            _fd = ::open(_pathname.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            if(_fd < 0)
+            {
+                std::cerr << "[ERROR]cpplogs::FlightRecorderSink::open::" << _pathname << ": " << strerror(errno) << std::endl;
+                return false;
+            }
+            std::vector<std::pair<std::string, uint32_t>> recovered;
+            uint64_t crash_signal = recover(recovered);
+            size_t size = sizeof(Header) + _capacity;
+            //预留磁盘块，避免磁盘满时访问映射区域触发 SIGBUS
+            if(ftruncate(_fd, 0) < 0 || (posix_fallocate(_fd, 0, size) != 0 && ftruncate(_fd, size) < 0))
+            {
+                std::cerr << "[ERROR]cpplogs::FlightRecorderSink::open::扩展文件失败: " << strerror(errno) << std::endl;
+                return false;
+            }
+            void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+            if(addr == MAP_FAILED)
+            {
+                std::cerr << "[ERROR]cpplogs::FlightRecorderSink::open::映射失败: " << strerror(errno) << std::endl;
+                return false;
+            }
+            _header = static_cast<Header*>(addr);
+            _ring = static_cast<char*>(addr) + sizeof(Header);
+            memcpy(_header->magic, magic(), sizeof(_header->magic));
+            _header->capacity = _capacity;
+            _header->head.store(0, std::memory_order_relaxed);
+            _header->tail.store(0, std::memory_order_relaxed);
+            _header->count.store(0, std::memory_order_relaxed);
+            _header->crash_signal.store(0, std::memory_order_relaxed);
+            if(!recovered.empty())
+            {
+                char note[128];
+                int len = snprintf(note, sizeof(note), "[cpplogs flight recorder] recovered %zu records from previous run (signal %llu)\n",
+                    recovered.size(), static_cast<unsigned long long>(crash_signal));
+                for(auto& sink : _sinks)
+                {
+                    sink->log(note, len, cpplogs::LogLevel::value::UNKNOW);
+                    for(auto& record : recovered)
+                    {
+                        sink->log(record.first.data(), record.first.size(), static_cast<cpplogs::LogLevel::value>(record.second));
+                    }
+                    sink->flush();
+                }
+            }
+            return true;
+        }
+
+        //读取上次运行残留的记录，返回上次崩溃的信号；文件格式不符时忽略
+        uint64_t recover(std::vector<std::pair<std::string, uint32_t>>& recovered)
+        {
+            struct stat st;
+            if(fstat(_fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header))
+            {
+                return 0;
+            }
+            void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, _fd, 0);
+            if(addr == MAP_FAILED)
+            {
+                return 0;
+            }
+            const Header* header = static_cast<const Header*>(addr);
+            const char* ring = static_cast<const char*>(addr) + sizeof(Header);
+            uint64_t capacity = header->capacity;
+            uint64_t head = header->head.load(std::memory_order_relaxed);
+            uint64_t tail = header->tail.load(std::memory_order_relaxed);
+            uint64_t crash_signal = header->crash_signal.load(std::memory_order_relaxed);
+            if(memcmp(header->magic, magic(), sizeof(header->magic)) == 0 && capacity + sizeof(Header) == static_cast<uint64_t>(st.st_size)
+                && tail <= head && head - tail <= capacity)
+            {
+                //逐条校验长度，遇到不合法的记录（写入时崩溃）停止
+                while(head - tail >= sizeof(Record))
+                {
+                    Record record;
+                    copyOut(ring, capacity, tail, reinterpret_cast<char*>(&record), sizeof(record));
+                    if(record.len > head - tail - sizeof(Record) || record.level > static_cast<uint32_t>(cpplogs::LogLevel::value::OFF))
+                    {
+                        break;
+                    }
+                    std::string data(record.len, '\0');
+                    copyOut(ring, capacity, tail + sizeof(Record), &data[0], record.len);
+                    recovered.push_back(std::make_pair(data, record.level));
+                    tail += sizeof(Record) + record.len;
+                }
+            }
+            munmap(addr, st.st_size);
+            return crash_signal;
+        }
+
+        //写入一条记录，空间或条数不足时丢弃最早的记录；超过缓冲区大小的记录被截断
+        void append(const char* data, size_t len, cpplogs::LogLevel::value level)
+        {
+            if(len > _capacity - sizeof(Record))
+            {
+                len = _capacity - sizeof(Record);
+                _stats.onError();
+            }
+            size_t need = sizeof(Record) + len;
+            uint64_t head = _header->head.load(std::memory_order_relaxed);
+            uint64_t tail = _header->tail.load(std::memory_order_relaxed);
+            uint64_t count = _header->count.load(std::memory_order_relaxed);
+            while(count > 0 && (head + need - tail > _capacity || (_max_records != 0 && count >= _max_records)))
+            {
+                Record oldest;
+                copyOut(_ring, _capacity, tail, reinterpret_cast<char*>(&oldest), sizeof(oldest));
+                tail += sizeof(Record) + oldest.len;
+                count--;
+            }
+            //先推进 tail 再覆盖数据，最后推进 head：任意时刻崩溃，[tail, head) 内都是完整的记录
+            _header->tail.store(tail, std::memory_order_release);
+            Record record;
+            record.len = static_cast<uint32_t>(len);
+            record.level = static_cast<uint32_t>(level);
+            copyIn(head, reinterpret_cast<const char*>(&record), sizeof(record));
+            copyIn(head + sizeof(Record), data, len);
+            _header->count.store(count + 1, std::memory_order_relaxed);
+            _header->head.store(head + need, std::memory_order_release);
+            _stats.onWrite(len);
+        }
+
+        //按顺序写出保留的日志并清空；不跨越缓冲区末尾的记录直接从映射区写出
+        void dump()
+        {
+            uint64_t head = _header->head.load(std::memory_order_relaxed);
+            uint64_t tail = _header->tail.load(std::memory_order_relaxed);
+            std::string wrapped;
+            while(tail < head)
+            {
+                Record record;
+                copyOut(_ring, _capacity, tail, reinterpret_cast<char*>(&record), sizeof(record));
+                uint64_t begin = (tail + sizeof(Record)) % _capacity;
+                const char* data = _ring + begin;
+                if(begin + record.len > _capacity)
+                {
+                    wrapped.resize(record.len);
+                    copyOut(_ring, _capacity, tail + sizeof(Record), &wrapped[0], record.len);
+                    data = wrapped.data();
+                }
+                for(auto& sink : _sinks)
+                {
+                    sink->log(data, record.len, static_cast<cpplogs::LogLevel::value>(record.level));
+                }
+                tail += sizeof(Record) + record.len;
+            }
+            for(auto& sink : _sinks)
+            {
+                sink->flush();
+            }
+            _header->tail.store(head, std::memory_order_release);
+            _header->count.store(0, std::memory_order_relaxed);
+        }
+
+        void copyIn(uint64_t pos, const char* src, size_t len)
+        {
+            size_t off = pos % _capacity;
+            size_t first = std::min(len, _capacity - off);
+            memcpy(_ring + off, src, first);
+            memcpy(_ring, src + first, len - first);
+        }
+        static void copyOut(const char* ring, uint64_t capacity, uint64_t pos, char* dst, size_t len)
+        {
+            size_t off = pos % capacity;
+            size_t first = std::min<uint64_t>(len, capacity - off);
+            memcpy(dst, ring + off, first);
+            memcpy(dst + first, ring, len - first);
+        }
+
+        static const char* magic()
+        {
+            return "CPLFR01";//含结尾的 '\0' 共 8 字节
+        }
+
+        //崩溃处理函数可见的飞行记录仪
+        static std::atomic<FlightRecorderSink*>* recorders()
+        {
+            static std::atomic<FlightRecorderSink*> slots[CPPLOGS_FLIGHT_RECORDERS];
+            return slots;
+        }
+        static void registry(FlightRecorderSink* recorder, bool add)
+        {
+            std::atomic<FlightRecorderSink*>* slots = recorders();
+            for(size_t i = 0; i < CPPLOGS_FLIGHT_RECORDERS; i++)
+            {
+                FlightRecorderSink* expected = add ? nullptr : recorder;
+                if(slots[i].compare_exchange_strong(expected, add ? recorder : nullptr))
+                {
+                    return;
+                }
+            }
+        }
+        //安装前各信号的处理方式，按信号值索引（零初始化，信号处理函数中可以直接读取）
+        static struct sigaction* previous()
+        {
+            static struct sigaction actions[NSIG];
+            return actions;
+        }
+        //只调用异步信号安全的函数：msync、sigaction、raise
+        static void onCrash(int signo, siginfo_t* info, void* context)
+        {
+            std::atomic<FlightRecorderSink*>* slots = recorders();
+            for(size_t i = 0; i < CPPLOGS_FLIGHT_RECORDERS; i++)
+            {
+                FlightRecorderSink* recorder = slots[i].load(std::memory_order_acquire);
+                if(recorder != nullptr && recorder->_header != nullptr)
+                {
+                    recorder->_header->crash_signal.store(signo, std::memory_order_relaxed);
+                    msync(recorder->_header, sizeof(Header) + recorder->_capacity, MS_SYNC);
+                }
+            }
+            //恢复原有的处理方式：处理函数直接调用（保留 siginfo），默认处理在本函数返回后由重新发送的信号触发
+            const struct sigaction& prev = previous()[signo];
+            sigaction(signo, &prev, nullptr);
+            if(prev.sa_flags & SA_SIGINFO)
+            {
+                prev.sa_sigaction(signo, info, context);
+            }
+            else if(prev.sa_handler == SIG_DFL)
+            {
+                raise(signo);
+            }
+            else if(prev.sa_handler != SIG_IGN)
+            {
+                prev.sa_handler(signo);
+            }
+        }
+
+    private:
+        std::mutex _mutex;
+        const std::string _pathname;
+        std::vector<cpplogs::LogSink::ptr> _sinks;//触发时写出的落地方向
+        cpplogs::LogLevel::value _trigger_level;
+        size_t _max_records;
+        int _fd;
+        Header* _header;
+        char* _ring;
+        size_t _capacity;
+    };
+}
+
+#endif
@@ -3,15 +3,20 @@
 
 /* 格式化类
  * 从日志中取出指定的元素，追加到一块内存空间中
+ * 1. format(std::ostream&) 输出到流
+ * 2. format(Buffer&) 直接追加字节到可复用的缓冲区，不经过 ostream，稳定状态下不分配内存
 */
 
 #include "level.hpp"
 #include "message.hpp"
+#include "buffer.hpp"
 #include <memory>
 #include <ctime>
 #include <vector>
 #include <cassert>
 #include <sstream>
+#include <cstring>
+#include <atomic>
 
 namespace cpplogs
 {
@@ -20,7 +25,9 @@ namespace cpplogs
     {
     public:
         using ptr = std::shared_ptr<FormatItem>;
+        virtual ~FormatItem() {}
         virtual void format(std::ostream& out, const cpplogs::LogMsg& msg) = 0;
+        virtual void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg) = 0;
     };
 
     //派生格式化子类 -- 消息，等级，时间，文件名，行号，线程ID，日志器名，制表符，换行，其它
@@ -29,7 +36,11 @@ namespace cpplogs
     public:
         void format(std::ostream& out, const cpplogs::LogMsg& msg) override
         {
-            out << msg._payload;
+            out.write(msg._payload, msg._payload_len);
+        }
+        void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg) override
+        {
+            out.push(msg._payload, msg._payload_len);
         }
     };
 
@@ -40,25 +51,152 @@ namespace cpplogs
         {
             out << cpplogs::LogLevel::toString(msg._level);
         }
+        void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg) override
+        {
+            const char* level = cpplogs::LogLevel::toString(msg._level);
+            out.push(level, strlen(level));
+        }
+    };
+
+    /* 时间渲染
+     * 1. 子格式除 strftime 的格式外，支持秒内小数：%ms 毫秒(3位)，%us 微秒(6位)，%ns 纳秒(9位)
+     * 2. localtime_r + strftime 的结果按线程缓存，秒数不变时只替换小数部分的数字
+     */
+    class TimeRender
+    {
+    public:
+        static const size_t MAX_TIME_SIZE = 64;//单个时间子项输出的最大长度
+
+        TimeRender(const std::string& fmt)
+        : _id(nextId())
+        {
+            std::string strf;
+            size_t pos = 0;
+            while(pos < fmt.size())
+            {
+                if(fmt[pos] == '%' && pos + 2 < fmt.size() && fmt[pos + 2] == 's'
+                    && (fmt[pos + 1] == 'm' || fmt[pos + 1] == 'u' || fmt[pos + 1] == 'n'))
+                {
+                    _segments.push_back(Segment(strf, 0));
+                    strf.clear();
+                    _segments.push_back(Segment("", fmt[pos + 1] == 'm' ? 3 : (fmt[pos + 1] == 'u' ? 6 : 9)));
+                    pos += 3;
+                }
+                else if(fmt[pos] == '%' && pos + 1 < fmt.size())//其它格式字符（包括 %%）整体交给 strftime
+                {
+                    strf.append(fmt, pos, 2);
+                    pos += 2;
+                }
+                else
+                {
+                    strf.push_back(fmt[pos++]);
+                }
+            }
+            _segments.push_back(Segment(strf, 0));
+        }
+
+        //渲染到 dst（至少 MAX_TIME_SIZE 字节），返回写入长度
+        size_t render(char* dst, time_t sec, long nsec) const
+        {
+            static thread_local Entry cache[CACHE_SIZE];
+            Entry& entry = cache[_id % CACHE_SIZE];
+            if(entry.id != _id || entry.sec != sec)//秒数变化，重新进行日历转换
+            {
+                struct tm t;
+                localtime_r(&sec, &t);
+                entry.len = 0;
+                entry.nfrac = 0;
+                for(auto& seg : _segments)
+                {
+                    if(seg.digits == 0)
+                    {
+                        if(!seg.strf.empty())
+                        {
+                            entry.len += strftime(entry.str + entry.len, MAX_TIME_SIZE - entry.len, seg.strf.c_str(), &t);
+                        }
+                    }
+                    else if(entry.len + seg.digits <= MAX_TIME_SIZE && entry.nfrac < MAX_FRAC)
+                    {
+                        entry.frac_pos[entry.nfrac] = entry.len;
+                        entry.frac_digits[entry.nfrac] = seg.digits;
+                        entry.nfrac++;
+                        memset(entry.str + entry.len, '0', seg.digits);
+                        entry.len += seg.digits;
+                    }
+                }
+                entry.id = _id;
+                entry.sec = sec;
+            }
+            memcpy(dst, entry.str, entry.len);
+            for(int i = 0; i < entry.nfrac; i++)
+            {
+                //取纳秒的前 digits 位，从低位向高位补齐
+                long value = nsec;
+                for(int d = entry.frac_digits[i]; d < 9; d++)
+                {
+                    value /= 10;
+                }
+                char* p = dst + entry.frac_pos[i] + entry.frac_digits[i];
+                for(int d = 0; d < entry.frac_digits[i]; d++)
+                {
+                    *--p = static_cast<char>('0' + value % 10);
+                    value /= 10;
+                }
+            }
+            return entry.len;
+        }
+
+    private:
+        struct Segment
+        {
+            std::string strf;//strftime 格式，digits 为 0 时有效
+            int digits;//秒内小数的位数
+            Segment(const std::string& s, int d) : strf(s), digits(d) {}
+        };
+        static const size_t CACHE_SIZE = 4;
+        static const int MAX_FRAC = 4;
+        struct Entry
+        {
+            size_t id;//所属 TimeRender 的编号，0 表示空
+            time_t sec;
+            size_t len;
+            int nfrac;
+            size_t frac_pos[MAX_FRAC];
+            int frac_digits[MAX_FRAC];
+            char str[MAX_TIME_SIZE];
+            Entry() : id(0), sec(0), len(0), nfrac(0) {}
+        };
+        //每个 TimeRender 有唯一编号，避免对象地址被复用时读到其它格式的缓存
+        static size_t nextId()
+        {
+            static std::atomic<size_t> id(0);
+            return ++id;
+        }
+
+    private:
+        size_t _id;
+        std::vector<Segment> _segments;
     };
 
     class TimeFormatItem : public FormatItem
     {
     public:
         TimeFormatItem(const std::string& fmt = "%H:%M:%S")
-        : _time_fmt(fmt)
+        : _render(fmt)
         {}
         void format(std::ostream& out, const cpplogs::LogMsg& msg) override
         {
-            struct tm t;
-            localtime_r(&(msg._ctime), &t);
-            char tmp[32] = { 0 };
-            strftime(tmp, 31, _time_fmt.c_str(), &t);
-
-            out << tmp;
+            char tmp[cpplogs::TimeRender::MAX_TIME_SIZE];
+            out.write(tmp, _render.render(tmp, msg._ctime, msg._nsec));
+        }
+        void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg) override
+        {
+            //直接格式化到缓冲区的可写区域
+            out.ensureEnoughSize(cpplogs::TimeRender::MAX_TIME_SIZE);
+            out.moveWriter(_render.render(out.writeBegin(), msg._ctime, msg._nsec));
         }
     private:
-        std::string _time_fmt;
+        cpplogs::TimeRender _render;
     };
 
     class FileFormatItem : public FormatItem
@@ -68,6 +206,10 @@ namespace cpplogs
         {
             out << msg._file;
         }
+        void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg) override
+        {
+            out.push(msg._file, strlen(msg._file));
+        }
     };
 
     class LineFormatItem : public FormatItem
@@ -77,6 +219,11 @@ namespace cpplogs
         {
             out << msg._line;
         }
+        void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg) override
+        {
+            out.ensureEnoughSize(20);
+            out.moveWriter(cpplogs::util::Number::toChars(out.writeBegin(), static_cast<uint64_t>(msg._line)));
+        }
     };
 
     class ThreadFormatItem : public FormatItem
@@ -86,6 +233,11 @@ namespace cpplogs
         {
             out << msg._tid;
         }
+        void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg) override
+        {
+            out.ensureEnoughSize(20);
+            out.moveWriter(cpplogs::util::Number::toChars(out.writeBegin(), msg._tid));
+        }
     };
 
     class LoggerFormatItem : public FormatItem
@@ -95,6 +247,10 @@ namespace cpplogs
         {
             out << msg._logger;
         }
+        void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg) override
+        {
+            out.push(msg._logger, strlen(msg._logger));
+        }
     };
 
     class TabFormatItem : public FormatItem
@@ -104,6 +260,10 @@ namespace cpplogs
         {
             out << "\t";
         }
+        void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg) override
+        {
+            out.push('\t');
+        }
     };
 
     class NewLineFormatItem : public FormatItem
@@ -113,6 +273,10 @@ namespace cpplogs
         {
             out << "\n";
         }
+        void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg) override
+        {
+            out.push('\n');
+        }
     };
 
     class OtherFormatItem : public FormatItem
@@ -125,6 +289,10 @@ namespace cpplogs
         {
             out << _str;
         }
+        void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg) override
+        {
+            out.push(_str.data(), _str.size());
+        }
     private:
         std::string _str;
     };
@@ -136,7 +304,7 @@ namespace cpplogs
         using ptr = std::shared_ptr<cpplogs::Formmatter>;
 
         /* 格式说明:
-         * %d 表示日期，其中包含子格式 {%H:%M:%S}
+         * %d 表示日期，其中包含子格式 {%H:%M:%S}，子格式中 %ms/%us/%ns 表示毫秒/微秒/纳秒
          * %t 表示线程ID
          * %c 表示日志器名称
          * %f 表示源码文件名
@@ -149,7 +317,16 @@ namespace cpplogs
         Formmatter(const std::string pattern = "[%d{%H:%M:%S}][%t][%c][%f:%l][%p]%T%m%n")
         : _pattern(pattern)
         {
-            assert(parsePattern());
+            //解析不能放在 assert 中，否则定义 NDEBUG 后不会执行
+            bool ret = parsePattern();
+            assert(ret);
+            (void)ret;
+        }
+        virtual ~Formmatter() {}
+
+        const std::string& pattern() const
+        {
+            return _pattern;
         }
 
         //对msg进行格式化
@@ -159,13 +336,28 @@ namespace cpplogs
             format(ss, msg);
             return ss.str();
         }
-        void format(std::ostream& out, const cpplogs::LogMsg& msg)
+        virtual void format(std::ostream& out, const cpplogs::LogMsg& msg)
         {
             for(auto& item : _items)
             {
                 item->format(out, msg);
             }
         }
+        //追加到调用者提供的缓冲区，缓冲区由调用者复用
+        virtual void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg)
+        {
+            for(auto& item : _items)
+            {
+                item->format(out, msg);
+            }
+        }
+
+    protected:
+        //供编译期特化的格式化器使用，只记录规则字符串，不进行运行时解析
+        struct NoParse {};
+        Formmatter(const std::string& pattern, NoParse)
+        : _pattern(pattern)
+        {}
 
     private:
         //对格式化规则字符串进行解析
@@ -241,7 +433,8 @@ namespace cpplogs
         {
             if(key == "d")
             {
-                return std::make_shared<cpplogs::TimeFormatItem>(val);
+                //%d 未指定子格式时使用默认时间格式
+                return val.empty() ? std::make_shared<cpplogs::TimeFormatItem>() : std::make_shared<cpplogs::TimeFormatItem>(val);
             }
             else if(key == "t")
             {
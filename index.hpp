@@ -0,0 +1,285 @@
+#ifndef __LOGS_INDEX_H__
+#define __LOGS_INDEX_H__
+
+/*
+ * index.hpp 滚动文件的稀疏索引
+ * 1. 索引文件与日志文件同名，追加 .idx 后缀；每写入 interval_bytes 字节或经过 interval_ms 毫秒结束一个块，
+ *    每个块一条定长记录：块内第一次写入的时间（ms）、块在日志文件中的偏移与长度、块内的最高等级
+ * 2. IndexWriter 由滚动落地方向在持有自身锁时调用，写入路径上只有计数与比较；
+ *    块记录先缓存在内存中，缓存满、落地方向刷新或切换文件时一次写出
+ * 3. LogIndex 读取索引，按时间范围与最低等级返回需要读取的字节区间，跳过不可能包含目标日志的块
+ *    最高等级为 UNKNOW 的块（写入时未提供等级）不会按等级被跳过；尚未写入索引的文件末尾总是被返回
+ * 4. 块的时间是写入时间，异步日志器批量写入时日志的时间戳可能略早于写入时间，查询时按 slack_ms 放宽
+*/
+
+#include "level.hpp"
+#include "util.hpp"
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace cpplogs
+{
+    //索引记录，定长 24 字节，按本机字节序存储
+    struct IndexEntry
+    {
+        uint64_t time_ms;//块内第一次写入的时间（自 1970 年起的毫秒数）
+        uint64_t offset;//块在日志文件中的起始偏移
+        uint32_t length;//块长度
+        uint32_t max_level;//块内的最高等级，UNKNOW 表示未知
+    };
+
+    //日志文件中的一段字节区间 [begin, end)
+    struct IndexRange
+    {
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    class IndexWriter
+    {
+    public:
+        IndexWriter(size_t interval_bytes = 64 * 1024, size_t interval_ms = 1000)
+        : _fd(-1)
+        , _interval_bytes(interval_bytes == 0 ? 64 * 1024 : interval_bytes)
+        , _interval_ms(interval_ms == 0 ? 1000 : interval_ms)
+        , _offset(0)
+        , _pending_count(0)
+        {
+            _block.length = 0;
+        }
+        ~IndexWriter()
+        {
+            close();
+        }
+
+        //日志文件打开后调用：日志文件已存在时从其末尾开始建立索引
+        bool open(const std::string& log_pathname)
+        {
+            close();
+            std::string pathname = log_pathname + ".idx";
+            _fd = ::open(pathname.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if(_fd < 0)
+            {
+                std::cerr << "[ERROR]cpplogs::IndexWriter::open::" << pathname << ": " << strerror(errno) << std::endl;
+                return false;
+            }
+            struct stat st;
+            _offset = stat(log_pathname.c_str(), &st) == 0 ? st.st_size : 0;
+            _block.length = 0;
+            return true;
+        }
+
+        //即将向日志文件写入 len 字节
+        void onWrite(size_t len, cpplogs::LogLevel::value level)
+        {
+            if(_fd < 0)
+            {
+                return;
+            }
+            uint64_t now = nowMs();
+            if(_block.length != 0 && (_block.length >= _interval_bytes || now - _block.time_ms >= _interval_ms))
+            {
+                endBlock();
+            }
+            if(_block.length == 0)
+            {
+                _block.time_ms = now;
+                _block.offset = _offset;
+                _block.max_level = static_cast<uint32_t>(cpplogs::LogLevel::value::UNKNOW);
+            }
+            if(static_cast<uint32_t>(level) > _block.max_level)
+            {
+                _block.max_level = static_cast<uint32_t>(level);
+            }
+            _block.length += static_cast<uint32_t>(len);
+            _offset += len;
+        }
+
+        //写出缓存的块记录，当前块仍保持打开
+        void flush()
+        {
+            if(_fd < 0 || _pending_count == 0)
+            {
+                return;
+            }
+            const char* data = reinterpret_cast<const char*>(_pending);
+            size_t len = _pending_count * sizeof(cpplogs::IndexEntry);
+            while(len > 0)
+            {
+                ssize_t ret = ::write(_fd, data, len);
+                if(ret < 0)
+                {
+                    if(errno == EINTR)
+                    {
+                        continue;
+                    }
+                    std::cerr << "[ERROR]cpplogs::IndexWriter::flush::write: " << strerror(errno) << std::endl;
+                    break;
+                }
+                data += ret;
+                len -= ret;
+            }
+            _pending_count = 0;
+        }
+
+        //结束当前块并关闭索引文件（切换日志文件前调用）
+        void close()
+        {
+            if(_fd < 0)
+            {
+                return;
+            }
+            if(_block.length != 0)
+            {
+                endBlock();
+            }
+            flush();
+            ::close(_fd);
+            _fd = -1;
+        }
+
+    private:
+        void endBlock()
+        {
+            _pending[_pending_count++] = _block;
+            _block.length = 0;
+            if(_pending_count == PENDING_SIZE)
+            {
+                flush();
+            }
+        }
+        static uint64_t nowMs()
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+            return static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+        }
+
+    private:
+        static const size_t PENDING_SIZE = 64;
+        int _fd;
+        size_t _interval_bytes;
+        size_t _interval_ms;
+        uint64_t _offset;//日志文件的当前长度
+        cpplogs::IndexEntry _block;//当前块，length 为 0 表示没有打开的块
+        cpplogs::IndexEntry _pending[PENDING_SIZE];//尚未写出的块记录
+        size_t _pending_count;
+    };
+
+    class LogIndex
+    {
+    public:
+        //读取日志文件对应的索引；索引不存在时整个文件作为一个未知块
+        bool load(const std::string& log_pathname)
+        {
+            _entries.clear();
+            struct stat st;
+            if(stat(log_pathname.c_str(), &st) != 0)
+            {
+                std::cerr << "[ERROR]cpplogs::LogIndex::load::" << log_pathname << ": " << strerror(errno) << std::endl;
+                return false;
+            }
+            _file_size = st.st_size;
+            std::string pathname = log_pathname + ".idx";
+            int fd = ::open(pathname.c_str(), O_RDONLY | O_CLOEXEC);
+            if(fd >= 0)
+            {
+                cpplogs::IndexEntry entry;
+                while(::read(fd, &entry, sizeof(entry)) == static_cast<ssize_t>(sizeof(entry)))
+                {
+                    _entries.push_back(entry);
+                }
+                ::close(fd);
+            }
+            //索引之后尚未建立索引的部分（当前块或索引缺失）
+            uint64_t covered = _entries.empty() ? 0 : _entries.back().offset + _entries.back().length;
+            if(covered < _file_size)
+            {
+                cpplogs::IndexEntry tail;
+                tail.time_ms = _entries.empty() ? 0 : _entries.back().time_ms;
+                tail.offset = covered;
+                tail.length = static_cast<uint32_t>(_file_size - covered);
+                tail.max_level = static_cast<uint32_t>(cpplogs::LogLevel::value::UNKNOW);
+                _entries.push_back(tail);
+            }
+            return true;
+        }
+
+        const std::vector<cpplogs::IndexEntry>& entries() const
+        {
+            return _entries;
+        }
+
+        //可能包含 [from_ms, to_ms] 内、等级不低于 min_level 的日志的字节区间，相邻区间合并
+        std::vector<cpplogs::IndexRange> find(uint64_t from_ms, uint64_t to_ms,
+            cpplogs::LogLevel::value min_level = cpplogs::LogLevel::value::DEBUG, uint64_t slack_ms = 1000) const
+        {
+            std::vector<cpplogs::IndexRange> ranges;
+            for(size_t i = 0; i < _entries.size(); i++)
+            {
+                const cpplogs::IndexEntry& e = _entries[i];
+                //块覆盖的写入时间为 [本块开始, 下一块开始]，最后一块没有上界
+                uint64_t next = i + 1 < _entries.size() ? _entries[i + 1].time_ms : UINT64_MAX;
+                bool time_ok = e.time_ms <= to_ms + slack_ms && next >= from_ms;
+                bool level_ok = e.max_level == static_cast<uint32_t>(cpplogs::LogLevel::value::UNKNOW)
+                    || e.max_level >= static_cast<uint32_t>(min_level);
+                if(!time_ok || !level_ok)
+                {
+                    continue;
+                }
+                if(!ranges.empty() && ranges.back().end == e.offset)
+                {
+                    ranges.back().end = e.offset + e.length;
+                }
+                else
+                {
+                    ranges.push_back(cpplogs::IndexRange{e.offset, e.offset + e.length});
+                }
+            }
+            return ranges;
+        }
+
+        //读取日志文件中的一段区间
+        static bool read(const std::string& log_pathname, const cpplogs::IndexRange& range, std::string& out)
+        {
+            int fd = ::open(log_pathname.c_str(), O_RDONLY | O_CLOEXEC);
+            if(fd < 0)
+            {
+                std::cerr << "[ERROR]cpplogs::LogIndex::read::" << log_pathname << ": " << strerror(errno) << std::endl;
+                return false;
+            }
+            out.resize(range.end - range.begin);
+            size_t done = 0;
+            while(done < out.size())
+            {
+                ssize_t ret = pread(fd, &out[done], out.size() - done, range.begin + done);
+                if(ret < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if(ret <= 0)
+                {
+                    break;
+                }
+                done += ret;
+            }
+            ::close(fd);
+            out.resize(done);
+            return done == range.end - range.begin;
+        }
+
+    private:
+        std::vector<cpplogs::IndexEntry> _entries;
+        uint64_t _file_size = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,369 @@
+#ifndef __LOGS_JSON_FMT_H__
+#define __LOGS_JSON_FMT_H__
+
+/*
+ * json_format.hpp 结构化输出格式
+ * 1. JsonFormmatter：每条日志输出一行 JSON（JSON Lines）
+ *      {"time":"2024-01-01T12:00:00.123456","level":"INFO","thread":1234,"logger":"root","file":"a.cc","line":10,"msg":"...","k":"v"}
+ * 2. LogfmtFormmatter：每条日志输出一行 logfmt
+ *      time=2024-01-01T12:00:00.123456 level=INFO thread=1234 logger=root file=a.cc line=10 msg="..." k=v
+ * 3. 线程私有的键值字段：cpplogs::ScopedField 在作用域内为当前线程的日志附加字段，离开作用域时移除
+ *    同步与异步日志器（AsyncLogger）在记录日志的线程中格式化，字段随日志一起输出；
+ *    ParallelAsyncLogger 在工作线程中格式化，调用者的字段随日志复制到批次，格式化前恢复到工作线程
+ * 4. 字符串转义：不需要转义的字节（可打印 ASCII，非 " 与 \）用 SIMD 成段查找并整块拷贝
+ *    编译时启用 AVX2（-mavx2 或 -march=native）每次检查 32 字节，x86-64 默认的 SSE2 每次 16 字节，其它平台逐字节检查
+ *    非 ASCII 字节按 UTF-8 校验，合法的多字节字符原样输出，非法字节替换为 �，保证输出是合法的 JSON
+ *    定义 CPPLOGS_NO_SIMD 可强制使用逐字节的实现
+*/
+
+#include "format.hpp"
+#include "util.hpp"
+#include <string>
+#include <vector>
+#include <utility>
+#if !defined(CPPLOGS_NO_SIMD) && (defined(__SSE2__) || defined(__AVX2__))
+#include <immintrin.h>
+#endif
+
+namespace cpplogs
+{
+    namespace detail
+    {
+        //不需要转义的字节
+        inline bool plainByte(unsigned char c)
+        {
+            return c >= 0x20 && c < 0x80 && c != '"' && c != '\\';
+        }
+
+        //开头连续的不需要转义的字节数（逐字节）
+        inline size_t plainPrefixScalar(const char* s, size_t len)
+        {
+            size_t i = 0;
+            while(i < len && plainByte(static_cast<unsigned char>(s[i])))
+            {
+                i++;
+            }
+            return i;
+        }
+
+        //开头连续的不需要转义的字节数
+        //有符号比较 0x20 > c 同时找出控制字符（0x00~0x1f）与非 ASCII 字节（0x80~0xff）
+        inline size_t plainPrefix(const char* s, size_t len)
+        {
+            size_t i = 0;
+#if !defined(CPPLOGS_NO_SIMD) && defined(__AVX2__)
+            const __m256i space32 = _mm256_set1_epi8(0x20);
+            const __m256i quote32 = _mm256_set1_epi8('"');
+            const __m256i slash32 = _mm256_set1_epi8('\\');
+            for(; i + 32 <= len; i += 32)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+                __m256i bad = _mm256_or_si256(_mm256_cmpgt_epi8(space32, v),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(v, quote32), _mm256_cmpeq_epi8(v, slash32)));
+                uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(bad));
+                if(mask != 0)
+                {
+                    return i + __builtin_ctz(mask);
+                }
+            }
+#endif
+#if !defined(CPPLOGS_NO_SIMD) && (defined(__SSE2__) || defined(__AVX2__))
+            const __m128i space16 = _mm_set1_epi8(0x20);
+            const __m128i quote16 = _mm_set1_epi8('"');
+            const __m128i slash16 = _mm_set1_epi8('\\');
+            for(; i + 16 <= len; i += 16)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+                __m128i bad = _mm_or_si128(_mm_cmpgt_epi8(space16, v),
+                    _mm_or_si128(_mm_cmpeq_epi8(v, quote16), _mm_cmpeq_epi8(v, slash16)));
+                uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(bad));
+                if(mask != 0)
+                {
+                    return i + __builtin_ctz(mask);
+                }
+            }
+#endif
+            return i + plainPrefixScalar(s + i, len - i);
+        }
+
+        //s 开头的合法 UTF-8 多字节字符的长度，非法时返回 0
+        inline size_t utf8Length(const unsigned char* s, size_t len)
+        {
+            unsigned char c = s[0];
+            size_t n;
+            unsigned char lo = 0x80, hi = 0xBF;//第二个字节的范围
+            if(c >= 0xC2 && c <= 0xDF)
+            {
+                n = 2;
+            }
+            else if(c >= 0xE0 && c <= 0xEF)
+            {
+                n = 3;
+                if(c == 0xE0) lo = 0xA0;//过长编码
+                if(c == 0xED) hi = 0x9F;//代理项
+            }
+            else if(c >= 0xF0 && c <= 0xF4)
+            {
+                n = 4;
+                if(c == 0xF0) lo = 0x90;
+                if(c == 0xF4) hi = 0x8F;//超过 U+10FFFF
+            }
+            else
+            {
+                return 0;
+            }
+            if(len < n || s[1] < lo || s[1] > hi)
+            {
+                return 0;
+            }
+            for(size_t i = 2; i < n; i++)
+            {
+                if((s[i] & 0xC0) != 0x80)
+                {
+                    return 0;
+                }
+            }
+            return n;
+        }
+    }
+
+    class JsonEscape
+    {
+    public:
+        //按 JSON 字符串的规则转义后追加到 out（不含两侧的引号）
+        static void escape(cpplogs::Buffer& out, const char* s, size_t len)
+        {
+            static const char hex[] = "0123456789abcdef";
+            size_t i = 0;
+            while(i < len)
+            {
+                size_t n = cpplogs::detail::plainPrefix(s + i, len - i);
+                out.push(s + i, n);
+                i += n;
+                if(i == len)
+                {
+                    break;
+                }
+                unsigned char c = static_cast<unsigned char>(s[i]);
+                switch(c)
+                {
+                case '"': out.push("\\\"", 2); break;
+                case '\\': out.push("\\\\", 2); break;
+                case '\n': out.push("\\n", 2); break;
+                case '\r': out.push("\\r", 2); break;
+                case '\t': out.push("\\t", 2); break;
+                case '\b': out.push("\\b", 2); break;
+                case '\f': out.push("\\f", 2); break;
+                default:
+                    if(c < 0x20)
+                    {
+                        char u[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+                        out.push(u, sizeof(u));
+                    }
+                    else
+                    {
+                        n = cpplogs::detail::utf8Length(reinterpret_cast<const unsigned char*>(s + i), len - i);
+                        if(n == 0)
+                        {
+                            out.push("\\ufffd", 6);
+                            n = 1;
+                        }
+                        else
+                        {
+                            out.push(s + i, n);
+                        }
+                        i += n;
+                        continue;
+                    }
+                }
+                i++;
+            }
+        }
+        //带两侧引号
+        static void quote(cpplogs::Buffer& out, const char* s, size_t len)
+        {
+            out.push('"');
+            escape(out, s, len);
+            out.push('"');
+        }
+    };
+
+    //线程私有的键值字段，由 ScopedField 压入与弹出
+    class LogFields
+    {
+    public:
+        using Field = std::pair<std::string, std::string>;
+
+        //当前线程的字段，[begin, begin + size) 有效；弹出的字段保留字符串的容量供下次复用
+        static std::vector<Field>& fields()
+        {
+            static thread_local std::vector<Field> fields;
+            return fields;
+        }
+        static size_t& size()
+        {
+            static thread_local size_t size = 0;
+            return size;
+        }
+        static void push(const std::string& key, const std::string& value)
+        {
+            push(key.data(), key.size(), value.data(), value.size());
+        }
+        static void push(const char* key, size_t key_len, const char* value, size_t value_len)
+        {
+            std::vector<Field>& all = fields();
+            size_t& n = size();
+            if(n == all.size())
+            {
+                all.emplace_back();
+            }
+            all[n].first.assign(key, key_len);
+            all[n].second.assign(value, value_len);
+            n++;
+        }
+        static void pop()
+        {
+            size_t& n = size();
+            if(n > 0)
+            {
+                n--;
+            }
+        }
+    };
+
+    //在作用域内为当前线程的日志附加一个字段
+    class ScopedField
+    {
+    public:
+        ScopedField(const std::string& key, const std::string& value)
+        {
+            cpplogs::LogFields::push(key, value);
+        }
+        ~ScopedField()
+        {
+            cpplogs::LogFields::pop();
+        }
+        ScopedField(const ScopedField&) = delete;
+        ScopedField& operator=(const ScopedField&) = delete;
+    };
+
+    //JSON Lines 格式化器
+    class JsonFormmatter : public cpplogs::Formmatter
+    {
+    public:
+        //time_fmt 为时间字段的格式，规则同 %d 的子格式
+        JsonFormmatter(const std::string& time_fmt = "%Y-%m-%dT%H:%M:%S.%us")
+        : cpplogs::Formmatter("json", cpplogs::Formmatter::NoParse())
+        , _render(time_fmt)
+        {}
+
+        using cpplogs::Formmatter::format;
+        void format(std::ostream& out, const cpplogs::LogMsg& msg) override
+        {
+            static thread_local cpplogs::Buffer buf(256);
+            buf.reset();
+            format(buf, msg);
+            out.write(buf.begin(), buf.readAbleSize());
+        }
+        void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg) override
+        {
+            out.ensureEnoughSize(cpplogs::TimeRender::MAX_TIME_SIZE + 64);
+            out.push("{\"time\":\"", 9);
+            out.moveWriter(_render.render(out.writeBegin(), msg._ctime, msg._nsec));
+            out.push("\",\"level\":\"", 11);
+            const char* level = cpplogs::LogLevel::toString(msg._level);
+            out.push(level, strlen(level));
+            out.push("\",\"thread\":", 11);
+            out.ensureEnoughSize(20);
+            out.moveWriter(cpplogs::util::Number::toChars(out.writeBegin(), msg._tid));
+            out.push(",\"logger\":", 10);
+            cpplogs::JsonEscape::quote(out, msg._logger, strlen(msg._logger));
+            out.push(",\"file\":", 8);
+            cpplogs::JsonEscape::quote(out, msg._file, strlen(msg._file));
+            out.push(",\"line\":", 8);
+            out.ensureEnoughSize(20);
+            out.moveWriter(cpplogs::util::Number::toChars(out.writeBegin(), static_cast<uint64_t>(msg._line)));
+            out.push(",\"msg\":", 7);
+            cpplogs::JsonEscape::quote(out, msg._payload, msg._payload_len);
+            const std::vector<cpplogs::LogFields::Field>& fields = cpplogs::LogFields::fields();
+            for(size_t i = 0; i < cpplogs::LogFields::size(); i++)
+            {
+                out.push(',');
+                cpplogs::JsonEscape::quote(out, fields[i].first.data(), fields[i].first.size());
+                out.push(':');
+                cpplogs::JsonEscape::quote(out, fields[i].second.data(), fields[i].second.size());
+            }
+            out.push("}\n", 2);
+        }
+
+    private:
+        cpplogs::TimeRender _render;
+    };
+
+    //logfmt 格式化器：值中含空格、=、引号、反斜杠或控制字符时加引号并按 JSON 规则转义
+    class LogfmtFormmatter : public cpplogs::Formmatter
+    {
+    public:
+        LogfmtFormmatter(const std::string& time_fmt = "%Y-%m-%dT%H:%M:%S.%us")
+        : cpplogs::Formmatter("logfmt", cpplogs::Formmatter::NoParse())
+        , _render(time_fmt)
+        {}
+
+        using cpplogs::Formmatter::format;
+        void format(std::ostream& out, const cpplogs::LogMsg& msg) override
+        {
+            static thread_local cpplogs::Buffer buf(256);
+            buf.reset();
+            format(buf, msg);
+            out.write(buf.begin(), buf.readAbleSize());
+        }
+        void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg) override
+        {
+            out.ensureEnoughSize(cpplogs::TimeRender::MAX_TIME_SIZE + 64);
+            out.push("time=", 5);
+            out.moveWriter(_render.render(out.writeBegin(), msg._ctime, msg._nsec));
+            out.push(" level=", 7);
+            const char* level = cpplogs::LogLevel::toString(msg._level);
+            out.push(level, strlen(level));
+            out.push(" thread=", 8);
+            out.ensureEnoughSize(20);
+            out.moveWriter(cpplogs::util::Number::toChars(out.writeBegin(), msg._tid));
+            out.push(" logger=", 8);
+            value(out, msg._logger, strlen(msg._logger));
+            out.push(" file=", 6);
+            value(out, msg._file, strlen(msg._file));
+            out.push(" line=", 6);
+            out.ensureEnoughSize(20);
+            out.moveWriter(cpplogs::util::Number::toChars(out.writeBegin(), static_cast<uint64_t>(msg._line)));
+            out.push(" msg=", 5);
+            value(out, msg._payload, msg._payload_len);
+            const std::vector<cpplogs::LogFields::Field>& fields = cpplogs::LogFields::fields();
+            for(size_t i = 0; i < cpplogs::LogFields::size(); i++)
+            {
+                out.push(' ');
+                value(out, fields[i].first.data(), fields[i].first.size());
+                out.push('=');
+                value(out, fields[i].second.data(), fields[i].second.size());
+            }
+            out.push('\n');
+        }
+
+    private:
+        static void value(cpplogs::Buffer& out, const char* s, size_t len)
+        {
+            //不需要转义且不含空格与 = 时原样输出
+            size_t n = cpplogs::detail::plainPrefix(s, len);
+            if(n == len && len != 0 && memchr(s, ' ', len) == nullptr && memchr(s, '=', len) == nullptr)
+            {
+                out.push(s, len);
+                return;
+            }
+            cpplogs::JsonEscape::quote(out, s, len);
+        }
+
+    private:
+        cpplogs::TimeRender _render;
+    };
+}
+
+#endif
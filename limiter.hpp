@@ -0,0 +1,360 @@
+#ifndef __LOGS_LIMITER_H__
+#define __LOGS_LIMITER_H__
+
+/*
+ * limiter.hpp 按调用点（file + line）的限流、抽样与重复消息折叠
+ * 1. 令牌桶限流：每秒补充 rate 个令牌，桶容量 burst，令牌不足的日志被丢弃
+ * 2. 抽样：每 sample 条日志只保留 1 条
+ * 3. 重复折叠：同一调用点连续输出相同的消息时只保留第一条，之后以 "last message repeated N times" 报告
+ * 4. 限流与抽样在格式化之前判断，被丢弃的日志只需一次查表与计数；重复折叠需要比较消息内容，在格式化主体消息后判断
+ * 5. 策略按日志器、按等级配置（Logger::setLimit）；每个调用点的统计窗口（window_ms）结束时，
+ *    若有被丢弃的日志，以同一调用点、同一等级输出一条报告，丢弃的数量不会丢失
+ *    报告中的时长为窗口实际经过的时间（微秒计时，以毫秒输出），报告与普通日志一样经过格式化、计入统计
+ * 6. 调用点表为固定大小（CPPLOGS_LIMIT_SITES 个，每个 64 字节对齐）的开放寻址表，在第一次设置策略时用 posix_memalign 分配；
+ *    通过原子操作占用槽位，槽位内的状态由自旋锁保护（只有同一调用点的线程会竞争）
+ *    只有启用了策略的等级的调用点占用槽位，表满时不再限流（宁可多输出，不丢失新的调用点）
+*/
+
+#include "level.hpp"
+#include <atomic>
+#include <thread>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+
+namespace cpplogs
+{
+    #define CPPLOGS_LIMIT_SITES 256//调用点表大小，必须是 2 的幂
+    #define CPPLOGS_LIMIT_LEVELS 7//日志等级数（UNKNOW ~ OFF）
+
+    //单个等级的限流策略，各项为 0（collapse 为 false）表示不启用
+    struct LimitPolicy
+    {
+        LimitPolicy(double rate_ = 0, size_t burst_ = 0, size_t sample_ = 0, bool collapse_ = false, size_t window_ms_ = 1000)
+        : rate(rate_)
+        , burst(burst_ == 0 ? static_cast<size_t>(rate_) + 1 : burst_)
+        , sample(sample_)
+        , collapse(collapse_)
+        , window_ms(window_ms_ == 0 ? 1000 : window_ms_)
+        {}
+        bool enabled() const
+        {
+            return rate > 0 || sample > 1 || collapse;
+        }
+
+        double rate;//每秒允许的日志条数
+        size_t burst;//令牌桶容量，默认为 rate + 1
+        size_t sample;//每 sample 条保留 1 条
+        bool collapse;//折叠连续的重复消息
+        size_t window_ms;//报告窗口
+    };
+
+    //一个窗口内被丢弃的日志数量
+    struct SuppressReport
+    {
+        SuppressReport()
+        : rate(0)
+        , sample(0)
+        , repeated(0)
+        , window_us(0)
+        {}
+        uint64_t total() const
+        {
+            return rate + sample + repeated;
+        }
+        //报告的主体消息，返回长度
+        size_t toString(char* buf, size_t size) const
+        {
+            int ret;
+            if(rate == 0 && sample == 0)
+            {
+                ret = snprintf(buf, size, "last message repeated %llu times", static_cast<unsigned long long>(repeated));
+            }
+            else
+            {
+                ret = snprintf(buf, size, "suppressed %llu records in last %llu.%03llu ms (rate limited: %llu, sampled out: %llu, repeated: %llu)",
+                    static_cast<unsigned long long>(total()), static_cast<unsigned long long>(window_us / 1000),
+                    static_cast<unsigned long long>(window_us % 1000),
+                    static_cast<unsigned long long>(rate), static_cast<unsigned long long>(sample),
+                    static_cast<unsigned long long>(repeated));
+            }
+            if(ret < 0)
+            {
+                return 0;
+            }
+            return static_cast<size_t>(ret) < size ? ret : size - 1;
+        }
+
+        uint64_t rate;//令牌不足被丢弃
+        uint64_t sample;//抽样丢弃
+        uint64_t repeated;//重复消息被折叠
+        uint64_t window_us;//报告覆盖的时长（微秒）
+    };
+
+    class RateLimiter
+    {
+    public:
+        RateLimiter()
+        : _sites(nullptr)
+        {
+            for(auto& enabled : _enabled)
+            {
+                enabled = false;
+            }
+            void* mem = nullptr;
+            if(posix_memalign(&mem, 64, CPPLOGS_LIMIT_SITES * sizeof(Site)) != 0)
+            {
+                throw std::bad_alloc();
+            }
+            _sites = static_cast<Site*>(mem);
+            for(size_t i = 0; i < CPPLOGS_LIMIT_SITES; i++)
+            {
+                new (&_sites[i]) Site();
+            }
+        }
+        ~RateLimiter()
+        {
+            free(_sites);//Site 只有平凡的析构
+        }
+        RateLimiter(const RateLimiter&) = delete;
+        RateLimiter& operator=(const RateLimiter&) = delete;
+
+        //设置某一等级的策略，需在开始记录日志之前调用
+        void setPolicy(cpplogs::LogLevel::value level, const cpplogs::LimitPolicy& policy)
+        {
+            size_t idx = static_cast<size_t>(level);
+            _policies[idx] = policy;
+            _enabled[idx] = policy.enabled();
+        }
+        bool enabled(cpplogs::LogLevel::value level) const
+        {
+            return _enabled[static_cast<size_t>(level)];
+        }
+        bool collapse(cpplogs::LogLevel::value level) const
+        {
+            return _enabled[static_cast<size_t>(level)] && _policies[static_cast<size_t>(level)].collapse;
+        }
+
+        //格式化之前判断：返回 false 表示丢弃
+        //report 返回上一个窗口被丢弃的数量，total() 不为 0 时调用者应输出报告
+        bool admit(cpplogs::LogLevel::value level, const char* file, size_t line, cpplogs::SuppressReport& report)
+        {
+            const cpplogs::LimitPolicy& policy = _policies[static_cast<size_t>(level)];
+            Site* site = find(file, line);
+            if(site == nullptr)
+            {
+                return true;
+            }
+            uint64_t now = nowUs();
+            SiteLock lock(*site);
+            site->level = level;
+            rollWindow(*site, policy, now, report);
+            if(policy.sample > 1 && site->seen++ % policy.sample != 0)
+            {
+                site->dropped.sample++;
+                return false;
+            }
+            if(policy.rate > 0)
+            {
+                double tokens = site->tokens + (now - site->last_refill_us) * policy.rate / 1000000;
+                site->tokens = tokens < policy.burst ? tokens : policy.burst;
+                site->last_refill_us = now;
+                if(site->tokens < 1)
+                {
+                    site->dropped.rate++;
+                    return false;
+                }
+                site->tokens -= 1;
+            }
+            return true;
+        }
+
+        //格式化主体消息之后判断是否与该调用点上一条消息重复：返回 true 表示重复，应丢弃
+        //report 返回之前被折叠的数量（消息发生变化时）
+        bool duplicate(const char* file, size_t line, const char* data, size_t len, cpplogs::SuppressReport& report)
+        {
+            Site* site = find(file, line);
+            if(site == nullptr)
+            {
+                return false;
+            }
+            uint64_t hash = hashOf(data, len);
+            SiteLock lock(*site);
+            if(site->has_last && site->last_hash == hash)
+            {
+                site->dropped.repeated++;
+                return true;
+            }
+            if(site->dropped.repeated != 0)//消息变化，先报告之前的重复次数
+            {
+                report.repeated = site->dropped.repeated;
+                site->dropped.repeated = 0;
+            }
+            site->has_last = true;
+            site->last_hash = hash;
+            return false;
+        }
+
+        //收集所有调用点尚未报告的丢弃数量，force 为 false 时只收集窗口已结束的调用点
+        //对每个需要报告的调用点调用 cb(level, file, line, report)
+        template<typename Callback>
+        void collect(bool force, Callback cb)
+        {
+            uint64_t now = nowUs();
+            for(size_t i = 0; i < CPPLOGS_LIMIT_SITES; i++)
+            {
+                Site& site = _sites[i];
+                const char* file = site.file.load(std::memory_order_acquire);
+                if(file == nullptr)
+                {
+                    continue;
+                }
+                cpplogs::SuppressReport report;
+                cpplogs::LogLevel::value level;
+                {
+                    SiteLock lock(site);
+                    level = site.level;
+                    const cpplogs::LimitPolicy& policy = _policies[static_cast<size_t>(level)];
+                    if(force || now - site.window_start_us >= policy.window_ms * 1000)
+                    {
+                        report = site.dropped;
+                        report.window_us = now - site.window_start_us;
+                        site.dropped = cpplogs::SuppressReport();
+                        site.window_start_us = now;
+                    }
+                }
+                if(report.total() != 0)
+                {
+                    cb(level, file, site.line, report);
+                }
+            }
+        }
+
+    private:
+        struct alignas(64) Site
+        {
+            Site()
+            : file(nullptr)
+            , line(0)
+            , level(cpplogs::LogLevel::value::UNKNOW)
+            , window_start_us(0)
+            , last_refill_us(0)
+            , tokens(-1)
+            , seen(0)
+            , has_last(false)
+            , last_hash(0)
+            {
+                lock.clear();
+            }
+            std::atomic<const char*> file;//为空表示槽位未被占用
+            size_t line;
+            std::atomic_flag lock;
+            //以下由 lock 保护
+            cpplogs::LogLevel::value level;
+            uint64_t window_start_us;
+            uint64_t last_refill_us;
+            double tokens;//小于 0 表示尚未初始化
+            uint64_t seen;
+            bool has_last;
+            uint64_t last_hash;
+            cpplogs::SuppressReport dropped;
+        };
+
+        class SiteLock
+        {
+        public:
+            SiteLock(Site& site)
+            : _site(site)
+            {
+                while(_site.lock.test_and_set(std::memory_order_acquire))
+                {
+                    std::this_thread::yield();
+                }
+            }
+            ~SiteLock()
+            {
+                _site.lock.clear(std::memory_order_release);
+            }
+        private:
+            Site& _site;
+        };
+
+        //窗口结束：取出被丢弃的数量，开始新窗口
+        void rollWindow(Site& site, const cpplogs::LimitPolicy& policy, uint64_t now, cpplogs::SuppressReport& report)
+        {
+            if(site.tokens < 0)//调用点第一次出现
+            {
+                site.tokens = policy.burst;
+                site.last_refill_us = now;
+                site.window_start_us = now;
+                return;
+            }
+            if(now - site.window_start_us < policy.window_ms * 1000)
+            {
+                return;
+            }
+            if(site.dropped.total() != 0)
+            {
+                report = site.dropped;
+                report.window_us = now - site.window_start_us;
+                site.dropped = cpplogs::SuppressReport();
+            }
+            site.window_start_us = now;
+        }
+
+        //查找调用点，不存在时占用一个空槽位；表满时返回 nullptr
+        Site* find(const char* file, size_t line)
+        {
+            size_t mask = CPPLOGS_LIMIT_SITES - 1;
+            size_t idx = static_cast<size_t>((reinterpret_cast<uintptr_t>(file) ^ (line * 0x9E3779B97F4A7C15ULL)) * 0x9E3779B97F4A7C15ULL >> 32) & mask;
+            for(size_t i = 0; i < CPPLOGS_LIMIT_SITES; i++, idx = (idx + 1) & mask)
+            {
+                Site& site = _sites[idx];
+                const char* cur = site.file.load(std::memory_order_acquire);
+                if(cur == nullptr)
+                {
+                    SiteLock lock(site);
+                    cur = site.file.load(std::memory_order_relaxed);
+                    if(cur == nullptr)
+                    {
+                        site.line = line;
+                        site.file.store(file, std::memory_order_release);
+                        return &site;
+                    }
+                }
+                if(cur == file && site.line == line)
+                {
+                    return &site;
+                }
+            }
+            return nullptr;
+        }
+
+        static uint64_t hashOf(const char* data, size_t len)
+        {
+            uint64_t hash = 14695981039346656037ULL;
+            for(size_t i = 0; i < len; i++)
+            {
+                hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ULL;
+            }
+            return hash;
+        }
+
+        //粗粒度时钟的精度只有几毫秒，短窗口会报告为 0 ms，这里使用精确的单调时钟（vDSO，不进入内核）
+        static uint64_t nowUs()
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+        }
+
+    private:
+        cpplogs::LimitPolicy _policies[CPPLOGS_LIMIT_LEVELS];
+        bool _enabled[CPPLOGS_LIMIT_LEVELS];
+        Site* _sites;//CPPLOGS_LIMIT_SITES 个，64 字节对齐
+    };
+}
+
+#endif
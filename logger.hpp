@@ -1,54 +1,812 @@
 #ifndef __LOGS_LOGGER_H__
 #define __LOGS_LOGGER_H__
 
-/* 
+/*
  * logger.hpp 日志器模块
  * 1. 抽象日志器基类
  * 2. 派生出不同的子类（同步日志器类&异步日志器类）
- * 
+ * 3. 两套记录接口：printf 风格（C 可变参数）与 {} 风格（可变参数模板，类型安全，支持自定义类型）
+ * 4. 落地方向列表为不可变快照，通过原子指针整体替换（写时复制），运行时增删落地方向不阻塞记录日志的线程
+ *    读者把正在使用的快照地址登记在本线程的风险指针槽位中（一次原子读、一次写本线程槽位、一次比较），不修改共享的引用计数
+ *    被替换的旧快照延迟释放：没有线程登记时立即释放，否则由最后一个放下它的线程或下一次替换释放
+ *    只被旧快照持有的落地方向随之释放（关闭文件、停止线程）
+ * 5. 运行时统计：各等级接受/过滤条数，落地方向的落地次数、字节数与耗时；stats() 获取快照，StatsDumper 定期输出
+ * 6. 按调用点限流：setLimit 为某一等级设置令牌桶限流、抽样与重复折叠（见 limiter.hpp），限流与抽样在格式化之前判断
+ *
 */
 
 #include "util.hpp"
 #include "level.hpp"
 #include "format.hpp"
 #include "sink.hpp"
+#include "looper.hpp"
+#include "binary.hpp"
+#include "brace_format.hpp"
+#include "stats.hpp"
+#include "limiter.hpp"
 #include <atomic>
 #include <mutex>
+#include <cstdarg>
+#include <cstdio>
+#include <vector>
+
+//按 printf 规则检查格式化字符串与参数（隐含的 this 为第 1 个参数）
+#define CPPLOGS_PRINTF_CHECK __attribute__((format(printf, 4, 5)))
 
 namespace cpplogs
 {
+    namespace detail
+    {
+        //风险指针记录：每个线程独占一条，登记该线程正在使用的落地方向快照
+        //记录只追加到全局链表中，线程退出时归还供新线程复用，不释放
+        class HazardRecord
+        {
+        public:
+            static const size_t SLOTS = 4;//同一线程可同时持有的快照数（落地方向中再记录日志时嵌套）
+
+            //当前线程的记录，线程退出之后返回空
+            static HazardRecord* local()
+            {
+                static thread_local Holder holder;
+                return holder.record;
+            }
+            //是否有线程登记了该快照
+            static bool protects(const void* ptr)
+            {
+                for(HazardRecord* rec = head().load(std::memory_order_acquire); rec != nullptr; rec = rec->_next)
+                {
+                    for(size_t i = 0; i < SLOTS; i++)
+                    {
+                        if(rec->_slots[i].load(std::memory_order_seq_cst) == ptr)
+                        {
+                            return true;
+                        }
+                    }
+                }
+                return false;
+            }
+
+            //取得一个空闲槽位，用完返回 SLOTS；只有所属线程调用
+            size_t acquire()
+            {
+                return _depth < SLOTS ? _depth++ : SLOTS;
+            }
+            void release()
+            {
+                _slots[--_depth].store(nullptr, std::memory_order_release);
+            }
+            std::atomic<const void*>& slot(size_t index)
+            {
+                return _slots[index];
+            }
+
+        private:
+            HazardRecord()
+            : _active(true)
+            , _depth(0)
+            , _next(nullptr)
+            {
+                for(size_t i = 0; i < SLOTS; i++)
+                {
+                    _slots[i].store(nullptr, std::memory_order_relaxed);
+                }
+            }
+            struct Holder
+            {
+                Holder()
+                : record(obtain())
+                {}
+                ~Holder()
+                {
+                    record->_active.store(false, std::memory_order_release);
+                    record = nullptr;
+                }
+                HazardRecord* record;
+            };
+            static std::atomic<HazardRecord*>& head()
+            {
+                static std::atomic<HazardRecord*> records(nullptr);
+                return records;
+            }
+            //优先复用已退出线程的记录
+            static HazardRecord* obtain()
+            {
+                for(HazardRecord* rec = head().load(std::memory_order_acquire); rec != nullptr; rec = rec->_next)
+                {
+                    bool active = false;
+                    if(!rec->_active.load(std::memory_order_relaxed)
+                        && rec->_active.compare_exchange_strong(active, true, std::memory_order_acquire))
+                    {
+                        return rec;
+                    }
+                }
+                HazardRecord* rec = new HazardRecord();
+                HazardRecord* first = head().load(std::memory_order_relaxed);
+                do
+                {
+                    rec->_next = first;
+                } while(!head().compare_exchange_weak(first, rec, std::memory_order_release, std::memory_order_relaxed));
+                return rec;
+            }
+
+            std::atomic<bool> _active;//是否被某个存活的线程持有
+            size_t _depth;//已使用的槽位数，只有所属线程访问
+            std::atomic<const void*> _slots[SLOTS];
+            HazardRecord* _next;
+            char _pad[64];//避免与相邻记录共享缓存行
+        };
+    }
+
     class Logger
     {
     public:
         using ptr = std::shared_ptr<cpplogs::Logger>;
+        using SinkList = std::vector<cpplogs::LogSink::ptr>;
+
+        //落地方向快照的读保护：持有期间其中的落地方向不会被释放
+        //读者只写本线程的风险指针槽位；槽位用完（嵌套过深）或线程已退出时退化为持有 _mutex
+        class SinkSnapshot
+        {
+        public:
+            SinkSnapshot(const cpplogs::Logger& logger)
+            : _logger(logger)
+            , _record(cpplogs::detail::HazardRecord::local())
+            , _index(_record != nullptr ? _record->acquire() : cpplogs::detail::HazardRecord::SLOTS)
+            {
+                if(_index == cpplogs::detail::HazardRecord::SLOTS)
+                {
+                    _logger._mutex.lock();
+                    _list = _logger._sinks.load(std::memory_order_relaxed);
+                    return;
+                }
+                std::atomic<const void*>& slot = _record->slot(_index);
+                const SinkList* list = _logger._sinks.load(std::memory_order_acquire);
+                for(;;)
+                {
+                    slot.store(list, std::memory_order_seq_cst);
+                    const SinkList* again = _logger._sinks.load(std::memory_order_seq_cst);
+                    if(again == list)
+                    {
+                        break;
+                    }
+                    list = again;
+                }
+                _list = list;
+            }
+            ~SinkSnapshot()
+            {
+                if(_index == cpplogs::detail::HazardRecord::SLOTS)
+                {
+                    _logger._mutex.unlock();
+                    return;
+                }
+                _record->release();
+                //放下的可能是最后一个被登记的旧快照，顺手释放；写者正在替换时交给写者
+                if(_logger._retired_count.load(std::memory_order_relaxed) != 0 && _logger._mutex.try_lock())
+                {
+                    _logger.reclaim();
+                    _logger._mutex.unlock();
+                }
+            }
+            SinkSnapshot(const SinkSnapshot&) = delete;
+            SinkSnapshot& operator=(const SinkSnapshot&) = delete;
+
+            const SinkList& operator*() const
+            {
+                return *_list;
+            }
+            const SinkList* operator->() const
+            {
+                return _list;
+            }
+
+        private:
+            const cpplogs::Logger& _logger;
+            cpplogs::detail::HazardRecord* _record;
+            size_t _index;
+            const SinkList* _list;
+        };
+
+        Logger(const std::string& logger_name,
+            cpplogs::LogLevel::value level,
+            const cpplogs::Formmatter::ptr& formmater,
+            const std::vector<cpplogs::LogSink::ptr>& sinks)
+        : _logger_name(logger_name)
+        , _limit_level(level)
+        , _formmater(formmater)
+        , _sinks(new SinkList(sinks))
+        , _retired_count(0)
+        {}
+        //派生类已停止所有读者，剩余的快照直接释放
+        virtual ~Logger()
+        {
+            delete _sinks.load(std::memory_order_relaxed);
+            for(const SinkList* list : _retired)
+            {
+                delete list;
+            }
+        }
+
+        const std::string& name() const
+        {
+            return _logger_name;
+        }
+
+        cpplogs::LogLevel::value level() const
+        {
+            return _limit_level.load(std::memory_order_relaxed);
+        }
+        void setLevel(cpplogs::LogLevel::value level)
+        {
+            _limit_level.store(level, std::memory_order_relaxed);
+        }
+        //该等级的日志是否需要输出，供调用点宏在求值参数之前判断
+        bool shouldLog(cpplogs::LogLevel::value level) const
+        {
+            return level >= _limit_level.load(std::memory_order_relaxed);
+        }
+        //记录一条因等级不足被过滤的日志（调用点宏在判断失败时调用），未定义 CPPLOGS_STATS_FILTERED=1 时为空函数（见 stats.hpp）
+        void onFiltered(cpplogs::LogLevel::value level)
+        {
+            _stats.onFilter(level);
+        }
+
+        //统计信息快照
+        cpplogs::LoggerStatsSnapshot stats() const
+        {
+            cpplogs::LoggerStatsSnapshot snap;
+            snap.name = _logger_name;
+            _stats.snapshot(snap);
+            SinkSnapshot sinks(*this);
+            for(auto& sink : *sinks)
+            {
+                cpplogs::SinkStatsSnapshot sink_snap;
+                sink_snap.name = sink->name();
+                sink->stats().snapshot(sink_snap);
+                snap.sinks.push_back(sink_snap);
+            }
+            return snap;
+        }
+
+        //当前落地方向列表的副本
+        SinkList sinks() const
+        {
+            SinkSnapshot sinks(*this);
+            return *sinks;
+        }
+        //运行时增删落地方向：复制当前快照，修改后原子发布
+        void addSink(const cpplogs::LogSink::ptr& sink)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            SinkList* list = new SinkList(*_sinks.load(std::memory_order_relaxed));
+            list->push_back(sink);
+            publish(list);
+        }
+        //被移除的落地方向在正在使用旧快照的线程放下快照后释放
+        void removeSink(const cpplogs::LogSink::ptr& sink)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            SinkList* list = new SinkList(*_sinks.load(std::memory_order_relaxed));
+            list->erase(std::remove(list->begin(), list->end(), sink), list->end());
+            publish(list);
+        }
+
+        //为某一等级设置按调用点的限流策略，需在开始记录日志之前调用
+        void setLimit(cpplogs::LogLevel::value level, const cpplogs::LimitPolicy& policy)
+        {
+            if(!_limiter)
+            {
+                _limiter.reset(new cpplogs::RateLimiter());
+            }
+            _limiter->setPolicy(level, policy);
+        }
+        //输出各调用点尚未报告的丢弃数量，force 为 false 时只输出统计窗口已结束的调用点
+        //日志器析构时会强制输出一次
+        void reportSuppressed(bool force = false)
+        {
+            if(!_limiter)
+            {
+                return;
+            }
+            _limiter->collect(force, [this](cpplogs::LogLevel::value level, const char* file, size_t line, const cpplogs::SuppressReport& report) {
+                logReport(level, file, line, report);
+            });
+        }
+
+        //切换为二进制日志模式：落地的是调用点ID与参数原始字节，由 cpplogs-decode 离线转换为文本
+        //需在开始记录日志之前调用
+        void enableBinary()
+        {
+            //调用点登记记录不属于任何等级
+            _encoder = std::make_shared<cpplogs::BinaryEncoder>(_logger_name,
+                [this](const char* data, size_t len) { log(data, len, cpplogs::LogLevel::value::UNKNOW); });
+        }
 
         //完成构造日志对象信息并完成初始化，得到格式化后的日志消息字符串，最后落地输出
-        void debug(const std::string& file, size_t line, const std::string& fmt, ...);
-        void info(const std::string& file, size_t line, const std::string& fmt, ...);
-        void warn(const std::string& file, size_t line, const std::string& fmt, ...);
-        void error(const std::string& file, size_t line, const std::string& fmt, ...);
-        void fatal(const std::string& file, size_t line, const std::string& fmt, ...);
+        //fmt 为 va_start 的最后一个具名参数，不能是引用类型，因此使用 const char*
+        //一般通过 cpplogs.hpp 中的 LOG_xxx 宏调用
+        //file 一般为 __FILE__，日志消息只保存其指针，不进行拷贝
+        CPPLOGS_PRINTF_CHECK void debug(const char* file, size_t line, const char* fmt, ...)
+        {
+            if(!shouldLog(cpplogs::LogLevel::value::DEBUG))
+            {
+                onFiltered(cpplogs::LogLevel::value::DEBUG);
+                return;
+            }
+            if(!admit(cpplogs::LogLevel::value::DEBUG, file, line))
+            {
+                return;
+            }
+            va_list ap;
+            va_start(ap, fmt);
+            serialize(cpplogs::LogLevel::value::DEBUG, file, line, fmt, ap);
+            va_end(ap);
+        }
+        CPPLOGS_PRINTF_CHECK void info(const char* file, size_t line, const char* fmt, ...)
+        {
+            if(!shouldLog(cpplogs::LogLevel::value::INFO))
+            {
+                onFiltered(cpplogs::LogLevel::value::INFO);
+                return;
+            }
+            if(!admit(cpplogs::LogLevel::value::INFO, file, line))
+            {
+                return;
+            }
+            va_list ap;
+            va_start(ap, fmt);
+            serialize(cpplogs::LogLevel::value::INFO, file, line, fmt, ap);
+            va_end(ap);
+        }
+        CPPLOGS_PRINTF_CHECK void warn(const char* file, size_t line, const char* fmt, ...)
+        {
+            if(!shouldLog(cpplogs::LogLevel::value::WARN))
+            {
+                onFiltered(cpplogs::LogLevel::value::WARN);
+                return;
+            }
+            if(!admit(cpplogs::LogLevel::value::WARN, file, line))
+            {
+                return;
+            }
+            va_list ap;
+            va_start(ap, fmt);
+            serialize(cpplogs::LogLevel::value::WARN, file, line, fmt, ap);
+            va_end(ap);
+        }
+        CPPLOGS_PRINTF_CHECK void error(const char* file, size_t line, const char* fmt, ...)
+        {
+            if(!shouldLog(cpplogs::LogLevel::value::ERROR))
+            {
+                onFiltered(cpplogs::LogLevel::value::ERROR);
+                return;
+            }
+            if(!admit(cpplogs::LogLevel::value::ERROR, file, line))
+            {
+                return;
+            }
+            va_list ap;
+            va_start(ap, fmt);
+            serialize(cpplogs::LogLevel::value::ERROR, file, line, fmt, ap);
+            va_end(ap);
+        }
+        CPPLOGS_PRINTF_CHECK void fatal(const char* file, size_t line, const char* fmt, ...)
+        {
+            if(!shouldLog(cpplogs::LogLevel::value::FATAL))
+            {
+                onFiltered(cpplogs::LogLevel::value::FATAL);
+                return;
+            }
+            if(!admit(cpplogs::LogLevel::value::FATAL, file, line))
+            {
+                return;
+            }
+            va_list ap;
+            va_start(ap, fmt);
+            serialize(cpplogs::LogLevel::value::FATAL, file, line, fmt, ap);
+            va_end(ap);
+        }
+
+        //{} 风格接口：logger->info(cpplogs::Fmt("user {} took {} ms"), id, dur)
+        //一般通过 cpplogs.hpp 中的 LOG_xxx_FMT 宏调用，宏在编译期检查占位符个数
+        template<typename... Args>
+        void debug(const cpplogs::Fmt& fmt, const Args&... args)
+        {
+            if(!shouldLog(cpplogs::LogLevel::value::DEBUG))
+            {
+                onFiltered(cpplogs::LogLevel::value::DEBUG);
+                return;
+            }
+            if(!admit(cpplogs::LogLevel::value::DEBUG, fmt._file, fmt._line))
+            {
+                return;
+            }
+            const cpplogs::FormatArg list[] = { cpplogs::makeFormatArg(args)..., cpplogs::FormatArg() };
+            serialize(cpplogs::LogLevel::value::DEBUG, fmt, list, sizeof...(Args));
+        }
+        template<typename... Args>
+        void info(const cpplogs::Fmt& fmt, const Args&... args)
+        {
+            if(!shouldLog(cpplogs::LogLevel::value::INFO))
+            {
+                onFiltered(cpplogs::LogLevel::value::INFO);
+                return;
+            }
+            if(!admit(cpplogs::LogLevel::value::INFO, fmt._file, fmt._line))
+            {
+                return;
+            }
+            const cpplogs::FormatArg list[] = { cpplogs::makeFormatArg(args)..., cpplogs::FormatArg() };
+            serialize(cpplogs::LogLevel::value::INFO, fmt, list, sizeof...(Args));
+        }
+        template<typename... Args>
+        void warn(const cpplogs::Fmt& fmt, const Args&... args)
+        {
+            if(!shouldLog(cpplogs::LogLevel::value::WARN))
+            {
+                onFiltered(cpplogs::LogLevel::value::WARN);
+                return;
+            }
+            if(!admit(cpplogs::LogLevel::value::WARN, fmt._file, fmt._line))
+            {
+                return;
+            }
+            const cpplogs::FormatArg list[] = { cpplogs::makeFormatArg(args)..., cpplogs::FormatArg() };
+            serialize(cpplogs::LogLevel::value::WARN, fmt, list, sizeof...(Args));
+        }
+        template<typename... Args>
+        void error(const cpplogs::Fmt& fmt, const Args&... args)
+        {
+            if(!shouldLog(cpplogs::LogLevel::value::ERROR))
+            {
+                onFiltered(cpplogs::LogLevel::value::ERROR);
+                return;
+            }
+            if(!admit(cpplogs::LogLevel::value::ERROR, fmt._file, fmt._line))
+            {
+                return;
+            }
+            const cpplogs::FormatArg list[] = { cpplogs::makeFormatArg(args)..., cpplogs::FormatArg() };
+            serialize(cpplogs::LogLevel::value::ERROR, fmt, list, sizeof...(Args));
+        }
+        template<typename... Args>
+        void fatal(const cpplogs::Fmt& fmt, const Args&... args)
+        {
+            if(!shouldLog(cpplogs::LogLevel::value::FATAL))
+            {
+                onFiltered(cpplogs::LogLevel::value::FATAL);
+                return;
+            }
+            if(!admit(cpplogs::LogLevel::value::FATAL, fmt._file, fmt._line))
+            {
+                return;
+            }
+            const cpplogs::FormatArg list[] = { cpplogs::makeFormatArg(args)..., cpplogs::FormatArg() };
+            serialize(cpplogs::LogLevel::value::FATAL, fmt, list, sizeof...(Args));
+        }
 
     protected:
+        //线程私有的缓冲区：主体消息与格式化结果，在同一线程的多次调用间复用
+        struct ThreadBuffers
+        {
+            ThreadBuffers() : payload(256), out(256) {}
+            cpplogs::Buffer payload;
+            cpplogs::Buffer out;
+        };
+        static ThreadBuffers& threadBuffers()
+        {
+            static thread_local ThreadBuffers buffers;
+            buffers.payload.reset();
+            buffers.out.reset();
+            return buffers;
+        }
+
+        //限流判断（格式化之前），上一个窗口有被丢弃的日志时先输出报告
+        bool admit(cpplogs::LogLevel::value level, const char* file, size_t line)
+        {
+            if(!_limiter || !_limiter->enabled(level))
+            {
+                return true;
+            }
+            cpplogs::SuppressReport report;
+            bool ret = _limiter->admit(level, file, line, report);
+            if(report.total() != 0)
+            {
+                logReport(level, file, line, report);
+            }
+            return ret;
+        }
+        //重复折叠判断（主体消息格式化之后），返回 true 表示与该调用点上一条消息相同，应丢弃
+        bool collapsed(cpplogs::LogLevel::value level, const char* file, size_t line, const cpplogs::Buffer& payload)
+        {
+            if(!_limiter || !_limiter->collapse(level))
+            {
+                return false;
+            }
+            cpplogs::SuppressReport report;
+            bool ret = _limiter->duplicate(file, line, payload.begin(), payload.readAbleSize(), report);
+            if(report.total() != 0)
+            {
+                logReport(level, file, line, report);
+            }
+            return ret;
+        }
+        //以被限流的调用点的名义输出丢弃数量，与普通日志一样计入统计并经过 commit（并行格式化的日志器在工作线程中格式化）
+        //使用独立的缓冲区，不影响正在格式化的日志
+        void logReport(cpplogs::LogLevel::value level, const char* file, size_t line, const cpplogs::SuppressReport& report)
+        {
+            static thread_local ThreadBuffers buffers;
+            buffers.payload.reset();
+            buffers.out.reset();
+            buffers.payload.ensureEnoughSize(192);
+            size_t len = report.toString(buffers.payload.writeBegin(), buffers.payload.writeAbleSize());
+            buffers.payload.moveWriter(len);
+            _stats.onAccept(level);
+            if(_encoder)
+            {
+                struct timespec ts = cpplogs::util::Date::getTimeSpec();
+                _encoder->encodeText(buffers.out, level, file, line, "[cpplogs suppressed]", buffers.payload.begin(), len,
+                    ts.tv_sec, static_cast<uint32_t>(ts.tv_nsec), cpplogs::util::Thread::id());
+                log(buffers.out.begin(), buffers.out.readAbleSize(), level);
+                return;
+            }
+            commit(level, file, line, buffers.payload, buffers.out);
+        }
+
+        //组织日志消息并格式化，格式化在调用者线程完成，随后交给具体日志器落地
+        void serialize(cpplogs::LogLevel::value level, const char* file, size_t line, const char* fmt, va_list ap)
+        {
+            ThreadBuffers& buffers = threadBuffers();
+            cpplogs::Buffer& payload = buffers.payload;
+            cpplogs::Buffer& out = buffers.out;
+
+            if(_encoder)//二进制模式，不进行文本格式化
+            {
+                _stats.onAccept(level);
+                struct timespec ts = cpplogs::util::Date::getTimeSpec();
+                _encoder->encode(out, level, file, line, fmt, ap,
+                    ts.tv_sec, static_cast<uint32_t>(ts.tv_nsec), cpplogs::util::Thread::id());
+                log(out.begin(), out.readAbleSize(), level);
+                return;
+            }
+
+            va_list ap_copy;
+            va_copy(ap_copy, ap);
+            int ret = vsnprintf(payload.writeBegin(), payload.writeAbleSize(), fmt, ap_copy);
+            va_end(ap_copy);
+            if(ret < 0)
+            {
+                std::cerr << "[ERROR]cpplogs::Logger::serialize::vsnprintf 格式化失败." << std::endl;
+                return;
+            }
+            if(static_cast<size_t>(ret) >= payload.writeAbleSize())//空间不足，扩容后重新格式化
+            {
+                payload.ensureEnoughSize(ret + 1);
+                vsnprintf(payload.writeBegin(), payload.writeAbleSize(), fmt, ap);
+            }
+            payload.moveWriter(ret);
+            if(collapsed(level, file, line, payload))//被折叠的重复消息不计入接受条数
+            {
+                return;
+            }
+            _stats.onAccept(level);
+            commit(level, file, line, payload, out);
+        }
+
+        //{} 风格：参数直接格式化到主体消息缓冲区；二进制模式下以文本记录
+        void serialize(cpplogs::LogLevel::value level, const cpplogs::Fmt& fmt, const cpplogs::FormatArg* args, size_t nargs)
+        {
+            ThreadBuffers& buffers = threadBuffers();
+            cpplogs::BraceFormat::format(buffers.payload, fmt._fmt, fmt._len, args, nargs);
+            if(collapsed(level, fmt._file, fmt._line, buffers.payload))
+            {
+                return;
+            }
+            _stats.onAccept(level);
+            if(_encoder)
+            {
+                struct timespec ts = cpplogs::util::Date::getTimeSpec();
+                _encoder->encodeText(buffers.out, level, fmt._file, fmt._line, fmt._fmt,
+                    buffers.payload.begin(), buffers.payload.readAbleSize(),
+                    ts.tv_sec, static_cast<uint32_t>(ts.tv_nsec), cpplogs::util::Thread::id());
+                log(buffers.out.begin(), buffers.out.readAbleSize(), level);
+                return;
+            }
+            commit(level, fmt._file, fmt._line, buffers.payload, buffers.out);
+        }
+
+        //按输出格式格式化主体消息并落地；并行格式化的日志器（parallel.hpp）改为把主体消息交给工作线程格式化
+        virtual void commit(cpplogs::LogLevel::value level, const char* file, size_t line, const cpplogs::Buffer& payload, cpplogs::Buffer& out)
+        {
+            cpplogs::LogMsg msg(level, line, file, _logger_name.c_str(), payload.begin(), payload.readAbleSize());
+            _formmater->format(out, msg);
+            log(out.begin(), out.readAbleSize(), level);
+        }
+
+        //替换落地方向快照，调用者持有 _mutex
+        void publish(const SinkList* list)
+        {
+            _retired.push_back(_sinks.exchange(list, std::memory_order_seq_cst));
+            reclaim();
+        }
+        //释放没有线程登记的旧快照，调用者持有 _mutex
+        void reclaim() const
+        {
+            size_t kept = 0;
+            for(size_t i = 0; i < _retired.size(); i++)
+            {
+                if(cpplogs::detail::HazardRecord::protects(_retired[i]))
+                {
+                    _retired[kept++] = _retired[i];
+                    continue;
+                }
+                delete _retired[i];
+            }
+            _retired.resize(kept);
+            _retired_count.store(kept, std::memory_order_relaxed);
+        }
+
+        //交给一个落地方向，并记录落地次数、字节数与抽样的耗时
+        static void sinkLog(const cpplogs::LogSink::ptr& sink, const char* data, size_t len, cpplogs::LogLevel::value level)
+        {
+            cpplogs::SinkStats& stats = sink->stats();
+            stats.onWrite(len);
+            if(cpplogs::SinkStats::sample())
+            {
+                struct timespec begin, end;
+                clock_gettime(CLOCK_MONOTONIC, &begin);
+                sink->log(data, len, level);
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                stats.onLatency((end.tv_sec - begin.tv_sec) * 1000000000ULL + end.tv_nsec - begin.tv_nsec);
+                return;
+            }
+            sink->log(data, len, level);
+        }
+
         //抽象接口完成实际的落地输出，不同的日志器有不同的输出方式
-        virtual void log(const char* data, size_t len) = 0;
-    private:
-        std::mutex _mutex;//互斥锁
+        //level 交给落地方向决定是否立即写出（见 FlushPolicy）
+        virtual void log(const char* data, size_t len, cpplogs::LogLevel::value level) = 0;
+
+    protected:
+        mutable std::mutex _mutex;//互斥锁，串行化落地方向列表的修改与旧快照的释放
         std::string _logger_name;//日志器名称
         std::atomic<cpplogs::LogLevel::value> _limit_level;//日志限制等级
         cpplogs::Formmatter::ptr _formmater;//输出格式
-        std::vector<cpplogs::LogSink> _sinks;//落地方向
+        std::atomic<const SinkList*> _sinks;//当前的落地方向快照
+        mutable std::vector<const SinkList*> _retired;//被替换但仍有线程登记的旧快照，_mutex 保护
+        mutable std::atomic<size_t> _retired_count;//_retired 的大小，读者放下快照时不加锁检查
+        cpplogs::LoggerStats _stats;//运行时统计
+        cpplogs::BinaryEncoder::ptr _encoder;//二进制模式编码器，为空表示文本模式
+        std::unique_ptr<cpplogs::RateLimiter> _limiter;//按调用点限流，为空表示不限流
     };
 
+    //同步日志器：在调用者线程中直接落地
     class SyncLogger : public Logger
     {
     public:
-        
+        SyncLogger(const std::string& logger_name,
+            cpplogs::LogLevel::value level,
+            const cpplogs::Formmatter::ptr& formmater,
+            const std::vector<cpplogs::LogSink::ptr>& sinks)
+        : Logger(logger_name, level, formmater, sinks)
+        {}
+        ~SyncLogger()
+        {
+            reportSuppressed(true);
+        }
+
     protected:
-        
+        //不加锁，落地方向自行保证线程安全
+        void log(const char* data, size_t len, cpplogs::LogLevel::value level) override
+        {
+            SinkSnapshot sinks(*this);
+            for(auto& sink : *sinks)
+            {
+                sinkLog(sink, data, len, level);
+            }
+        }
+    };
+
+    //异步日志器：调用者线程只负责格式化并写入缓冲区，由后台线程落地
+    class AsyncLogger : public Logger
+    {
+    public:
+        AsyncLogger(const std::string& logger_name,
+            cpplogs::LogLevel::value level,
+            const cpplogs::Formmatter::ptr& formmater,
+            const std::vector<cpplogs::LogSink::ptr>& sinks,
+            cpplogs::AsyncType looper_type = cpplogs::AsyncType::ASYNC_BLOCK,
+            size_t buffer_size = DEFAULT_BUFFER_SIZE)
+        : Logger(logger_name, level, formmater, sinks)
+        , _looper(std::make_shared<cpplogs::AsyncLooper>(
+            std::bind(&AsyncLogger::realLog, this, std::placeholders::_1), looper_type, buffer_size))
+        {}
+        //析构时先输出尚未报告的限流数量，再停止工作器，保证缓冲区中剩余的日志全部落地，最后写出落地方向的缓存
+        ~AsyncLogger()
+        {
+            reportSuppressed(true);
+            _looper->stop();
+            SinkSnapshot sinks(*this);
+            for(auto& sink : *sinks)
+            {
+                sink->flush();
+            }
+        }
+
+    protected:
+        //将数据写入缓冲区
+        void log(const char* data, size_t len, cpplogs::LogLevel::value level) override
+        {
+            _looper->push(data, len, level);
+        }
+        //后台线程的实际落地函数，只有一个消费线程，无需加锁
+        //一次交换得到的整块数据整体交给落地方向，何时写出由落地方向的刷新策略决定（批次中的最高等级参与判断）
+        void realLog(cpplogs::Buffer& buf)
+        {
+            SinkSnapshot sinks(*this);
+            for(auto& sink : *sinks)
+            {
+                sinkLog(sink, buf.begin(), buf.readAbleSize(), _looper->batchLevel());
+            }
+        }
+
+    private:
+        cpplogs::AsyncLooper::ptr _looper;
+    };
+
+    //定期将日志器的统计信息以文本形式写入指定落地方向，并触发限流报告（不再输出日志的调用点也能得到报告）
+    class StatsDumper
+    {
+    public:
+        StatsDumper(const cpplogs::Logger::ptr& logger, const cpplogs::LogSink::ptr& sink, size_t interval_ms)
+        : _stop(false)
+        , _logger(logger)
+        , _sink(sink)
+        , _interval_ms(interval_ms == 0 ? 1000 : interval_ms)
+        , _thread(std::thread(&StatsDumper::threadEntry, this))
+        {}
+        //停止时再输出一次最终的统计
+        ~StatsDumper()
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _cond.notify_all();
+            _thread.join();
+            dump();
+        }
+
+        //立即输出一次，同时输出统计窗口已结束的调用点的限流报告
+        void dump()
+        {
+            _logger->reportSuppressed();
+            std::string text = _logger->stats().toString();
+            _sink->log(text.c_str(), text.size());
+            _sink->flush();
+        }
+
+    private:
+        void threadEntry()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while(!_cond.wait_for(lock, std::chrono::milliseconds(_interval_ms), [&](){ return _stop; }))
+            {
+                lock.unlock();
+                dump();
+                lock.lock();
+            }
+        }
+
     private:
-        
+        bool _stop;
+        cpplogs::Logger::ptr _logger;
+        cpplogs::LogSink::ptr _sink;
+        size_t _interval_ms;
+        std::mutex _mutex;
+        std::condition_variable _cond;
+        std::thread _thread;
     };
 }
 
-#endif
\ No newline at end of file
+#endif
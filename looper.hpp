@@ -0,0 +1,170 @@
+#ifndef __LOGS_LOOPER_H__
+#define __LOGS_LOOPER_H__
+
+/*
+ * looper.hpp 异步工作器
+ * 1. 生产者将日志数据追加到生产缓冲区
+ * 2. 后台线程在生产缓冲区有数据时与消费缓冲区交换，再交由回调函数落地
+ * 3. 缓冲区满时的两种策略：阻塞等待（ASYNC_BLOCK）或扩容写入（ASYNC_GROW）
+ * 4. 停止时将剩余数据全部处理完毕再退出
+ * 5. 记录每批数据中的最高日志等级，回调中通过 batchLevel() 获取（供落地方向的刷新策略与索引使用）
+ * 6. tryPush() 在缓冲区已满时不阻塞而是返回 false，由调用者决定丢弃或另行保存（见 async_sink.hpp）
+*/
+
+#include "buffer.hpp"
+#include "level.hpp"
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+#include <memory>
+
+namespace cpplogs
+{
+    enum class AsyncType
+    {
+        ASYNC_BLOCK,//缓冲区满则阻塞，内存占用固定
+        ASYNC_GROW//缓冲区满则扩容，不阻塞调用者，适用于压测或突发流量
+    };
+
+    class AsyncLooper
+    {
+    public:
+        using ptr = std::shared_ptr<cpplogs::AsyncLooper>;
+        using Functor = std::function<void(cpplogs::Buffer&)>;
+
+        AsyncLooper(const Functor& cb,
+            cpplogs::AsyncType looper_type = cpplogs::AsyncType::ASYNC_BLOCK,
+            size_t buffer_size = DEFAULT_BUFFER_SIZE)
+        : _stop(false)
+        , _looper_type(looper_type)
+        , _pro_buf(buffer_size)
+        , _con_buf(buffer_size)
+        , _pending(0)
+        , _pro_level(cpplogs::LogLevel::value::UNKNOW)
+        , _con_level(cpplogs::LogLevel::value::UNKNOW)
+        , _callback(cb)
+        , _thread(std::thread(&AsyncLooper::threadEntry, this))
+        {}
+        ~AsyncLooper()
+        {
+            stop();
+        }
+
+        //停止工作器，剩余数据处理完毕后线程退出
+        void stop()
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if(_stop)
+                {
+                    return;
+                }
+                _stop = true;
+            }
+            _cond_con.notify_all();
+            _thread.join();
+        }
+
+        //生产者写入数据，level 为这条数据的日志等级
+        void push(const char* data, size_t len, cpplogs::LogLevel::value level = cpplogs::LogLevel::value::UNKNOW)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if(_looper_type == cpplogs::AsyncType::ASYNC_BLOCK)
+            {
+                //空间足够才写入；单条数据超过整个缓冲区时，等缓冲区为空后扩容写入，避免永久阻塞
+                _cond_pro.wait(lock, [&](){ return _pro_buf.writeAbleSize() >= len || _pro_buf.empty(); });
+            }
+            append(data, len, level);
+        }
+
+        //不阻塞的写入：ASYNC_BLOCK 模式下空间不足时返回 false，数据未写入
+        bool tryPush(const char* data, size_t len, cpplogs::LogLevel::value level = cpplogs::LogLevel::value::UNKNOW)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if(_looper_type == cpplogs::AsyncType::ASYNC_BLOCK && _pro_buf.writeAbleSize() < len && !_pro_buf.empty())
+            {
+                return false;
+            }
+            append(data, len, level);
+            return true;
+        }
+
+        //生产缓冲区中等待处理的字节数，不加锁
+        size_t pending() const
+        {
+            return _pending.load(std::memory_order_acquire);
+        }
+
+        //当前回调处理的这批数据中的最高等级，只能在回调中调用
+        cpplogs::LogLevel::value batchLevel() const
+        {
+            return _con_level;
+        }
+
+    private:
+        //写入生产缓冲区，调用者持有 _mutex
+        void append(const char* data, size_t len, cpplogs::LogLevel::value level)
+        {
+            bool was_empty = _pro_buf.empty();
+            _pro_buf.push(data, len);
+            _pending.store(_pro_buf.readAbleSize(), std::memory_order_release);
+            if(level > _pro_level)
+            {
+                _pro_level = level;
+            }
+            //只在缓冲区由空变为非空时唤醒消费者，其余情况消费者必然已被唤醒
+            if(was_empty)
+            {
+                _cond_con.notify_one();
+            }
+        }
+
+        //线程入口函数：交换缓冲区，对消费缓冲区中的数据进行处理
+        void threadEntry()
+        {
+            while(true)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    //退出标志被设置且生产缓冲区已无数据，退出
+                    if(_stop && _pro_buf.empty())
+                    {
+                        break;
+                    }
+                    _cond_con.wait(lock, [&](){ return _stop || !_pro_buf.empty(); });
+                    _con_buf.swap(_pro_buf);
+                    _pending.store(0, std::memory_order_release);
+                    _con_level = _pro_level;
+                    _pro_level = cpplogs::LogLevel::value::UNKNOW;
+                    if(_looper_type == cpplogs::AsyncType::ASYNC_BLOCK)
+                    {
+                        _cond_pro.notify_all();
+                    }
+                }
+                if(!_con_buf.empty())
+                {
+                    _callback(_con_buf);
+                }
+                _con_buf.reset();
+            }
+        }
+
+    private:
+        bool _stop;//工作器停止标志，受 _mutex 保护
+        cpplogs::AsyncType _looper_type;
+        cpplogs::Buffer _pro_buf;//生产缓冲区
+        cpplogs::Buffer _con_buf;//消费缓冲区
+        std::atomic<size_t> _pending;//生产缓冲区中的字节数，在 _mutex 内更新
+        cpplogs::LogLevel::value _pro_level;//生产缓冲区中的最高等级，受 _mutex 保护
+        cpplogs::LogLevel::value _con_level;//消费缓冲区中的最高等级，只由工作线程访问
+        std::mutex _mutex;
+        std::condition_variable _cond_pro;
+        std::condition_variable _cond_con;
+        Functor _callback;//处理消费缓冲区数据的回调函数，由异步日志器提供
+        std::thread _thread;//异步工作器对应的线程，必须最后初始化
+    };
+}
+
+#endif
@@ -0,0 +1,399 @@
+#ifndef __LOGS_MANAGER_H__
+#define __LOGS_MANAGER_H__
+
+/*
+ * manager.hpp 全局日志器管理与建造者
+ * 1. LoggerBuilder 按名称、限制等级、输出格式、落地方向、同步/异步构造日志器（局部使用，不注册）；
+ *    GlobalLoggerBuilder 构造后注册到 LoggerManager，之后任何模块都可以按名称获取
+ *    cpplogs::GlobalLoggerBuilder().buildLoggerName("net.http").buildLoggerType(cpplogs::LoggerType::LOGGER_ASYNC)
+ *        .buildSink<cpplogs::FileSink>("./logs/http.log").build();
+ * 2. LoggerManager 持有根日志器（名称为 root，同步输出到标准输出）与所有注册的日志器
+ *    注册表是不可变的开放寻址哈希表，注册/移除时复制一份新表后整体替换（写时复制），每张表有递增的版本号
+ *    表由 shared_ptr 持有，被替换的旧表在最后一个持有者释放后销毁，被替换/移除的日志器随之释放（异步日志器的线程退出）
+ * 3. 每个线程持有一份当前表的快照，getLogger 返回快照中日志器的引用，不修改共享的引用计数
+ *    查找时只原子读取版本号：版本号不变时直接使用快照；版本号变化后才重新获取快照
+ *    const char* 版本按名称字符串的地址缓存查找结果，命中时只比较地址与版本号（不比较字符串），
+ *    名称须为字符串字面量等地址与内容都不变的字符串；std::string 版本每次在快照中查找哈希表
+ *    返回的引用在本线程下一次查找之前有效，需要持有日志器时使用 getSharedLogger
+ *    线程的快照最多让一张旧表多存活到该线程下一次查找
+ *    名称不存在时返回空指针，同名的日志器再次注册时替换原来的日志器，removeLogger 移除日志器
+ * 4. setLevelByPrefix 按名称前缀修改日志器的限制等级，等级为原子变量，记录日志的线程不需要暂停
+*/
+
+#include "logger.hpp"
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <cstring>
+#include <cstdint>
+
+namespace cpplogs
+{
+    enum class LoggerType
+    {
+        LOGGER_SYNC,//同步日志器
+        LOGGER_ASYNC//异步日志器
+    };
+
+    class LoggerBuilder
+    {
+    public:
+        LoggerBuilder()
+        : _logger_type(cpplogs::LoggerType::LOGGER_SYNC)
+        , _limit_level(cpplogs::LogLevel::value::DEBUG)
+        , _looper_type(cpplogs::AsyncType::ASYNC_BLOCK)
+        , _buffer_size(DEFAULT_BUFFER_SIZE)
+        {}
+        virtual ~LoggerBuilder() {}
+
+        LoggerBuilder& buildLoggerName(const std::string& name)
+        {
+            _logger_name = name;
+            return *this;
+        }
+        LoggerBuilder& buildLoggerLevel(cpplogs::LogLevel::value level)
+        {
+            _limit_level = level;
+            return *this;
+        }
+        LoggerBuilder& buildLoggerType(cpplogs::LoggerType type)
+        {
+            _logger_type = type;
+            return *this;
+        }
+        //异步日志器的缓冲区策略与大小
+        LoggerBuilder& buildAsyncType(cpplogs::AsyncType looper_type, size_t buffer_size = DEFAULT_BUFFER_SIZE)
+        {
+            _looper_type = looper_type;
+            _buffer_size = buffer_size;
+            return *this;
+        }
+        LoggerBuilder& buildFormmater(const std::string& pattern)
+        {
+            _formmater = std::make_shared<cpplogs::Formmatter>(pattern);
+            return *this;
+        }
+        LoggerBuilder& buildFormmater(const cpplogs::Formmatter::ptr& formmater)
+        {
+            _formmater = formmater;
+            return *this;
+        }
+        template<typename SinkType, typename ...Args>
+        LoggerBuilder& buildSink(Args&& ...args)
+        {
+            _sinks.push_back(cpplogs::SinkFactory::create<SinkType>(std::forward<Args>(args)...));
+            return *this;
+        }
+        LoggerBuilder& buildSink(const cpplogs::LogSink::ptr& sink)
+        {
+            _sinks.push_back(sink);
+            return *this;
+        }
+
+        //没有指定输出格式时使用默认格式，没有指定落地方向时输出到标准输出
+        virtual cpplogs::Logger::ptr build()
+        {
+            assert(!_logger_name.empty());
+            if(_formmater.get() == nullptr)
+            {
+                _formmater = std::make_shared<cpplogs::Formmatter>();
+            }
+            if(_sinks.empty())
+            {
+                _sinks.push_back(cpplogs::SinkFactory::create<cpplogs::StdoutSink>());
+            }
+            if(_logger_type == cpplogs::LoggerType::LOGGER_ASYNC)
+            {
+                return std::make_shared<cpplogs::AsyncLogger>(_logger_name, _limit_level, _formmater, _sinks, _looper_type, _buffer_size);
+            }
+            return std::make_shared<cpplogs::SyncLogger>(_logger_name, _limit_level, _formmater, _sinks);
+        }
+
+    protected:
+        cpplogs::LoggerType _logger_type;
+        std::string _logger_name;
+        cpplogs::LogLevel::value _limit_level;
+        cpplogs::Formmatter::ptr _formmater;
+        std::vector<cpplogs::LogSink::ptr> _sinks;
+        cpplogs::AsyncType _looper_type;
+        size_t _buffer_size;
+    };
+
+    class LoggerManager
+    {
+    public:
+        static LoggerManager& getInstance()
+        {
+            //C++11 保证局部静态变量的初始化是线程安全的
+            static LoggerManager manager;
+            return manager;
+        }
+
+        //注册日志器，同名的日志器被替换
+        void addLogger(const cpplogs::Logger::ptr& logger)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            std::vector<cpplogs::Logger::ptr> loggers = others(logger->name());
+            loggers.push_back(logger);
+            publish(loggers);
+        }
+
+        //移除日志器，返回是否存在；根日志器不能移除
+        bool removeLogger(const std::string& name)
+        {
+            if(name == _root->name())
+            {
+                return false;
+            }
+            std::unique_lock<std::mutex> lock(_mutex);
+            std::vector<cpplogs::Logger::ptr> loggers = others(name);
+            if(loggers.size() == std::atomic_load(&_table)->count)
+            {
+                return false;
+            }
+            publish(loggers);
+            return true;
+        }
+
+        bool hasLogger(const std::string& name) const
+        {
+            return getLogger(name).get() != nullptr;
+        }
+
+        //按名称查找，不存在时返回空指针；先按名称的地址查线程缓存，未命中时查找线程持有的表快照
+        //name 须为地址与内容都不变的字符串（如字符串字面量），返回的引用在本线程下一次查找之前有效
+        const cpplogs::Logger::ptr& getLogger(const char* name) const
+        {
+            ThreadCache& local = current();
+            const Table& table = *local.table;
+            CacheEntry& cached = local.entries[(reinterpret_cast<uintptr_t>(name) >> 3) % CACHE_SIZE];
+            if(cached.name == name && cached.generation == local.generation)
+            {
+                return table.slots[cached.index];
+            }
+            size_t index = table.find(name);
+            if(index == Table::npos)
+            {
+                return empty();
+            }
+            cached.generation = local.generation;
+            cached.name = name;
+            cached.index = index;
+            return table.slots[index];
+        }
+        //名称可能是临时字符串，不使用地址缓存
+        const cpplogs::Logger::ptr& getLogger(const std::string& name) const
+        {
+            const Table& table = *current().table;
+            size_t index = table.find(name.c_str());
+            return index == Table::npos ? empty() : table.slots[index];
+        }
+        //需要持有日志器时使用，返回值增加一次引用计数
+        cpplogs::Logger::ptr getSharedLogger(const std::string& name) const
+        {
+            return getLogger(name);
+        }
+
+        const cpplogs::Logger::ptr& rootLogger() const
+        {
+            return _root;
+        }
+
+        //修改名称以 prefix 开头的日志器的限制等级（空前缀表示所有日志器），返回修改的个数
+        size_t setLevelByPrefix(const std::string& prefix, cpplogs::LogLevel::value level)
+        {
+            std::shared_ptr<const Table> table = std::atomic_load(&_table);
+            size_t count = 0;
+            for(auto& logger : table->slots)
+            {
+                if(logger && logger->name().compare(0, prefix.size(), prefix) == 0)
+                {
+                    logger->setLevel(level);
+                    count++;
+                }
+            }
+            return count;
+        }
+
+        //所有注册的日志器
+        std::vector<cpplogs::Logger::ptr> loggers() const
+        {
+            std::shared_ptr<const Table> table = std::atomic_load(&_table);
+            std::vector<cpplogs::Logger::ptr> result;
+            for(auto& logger : table->slots)
+            {
+                if(logger)
+                {
+                    result.push_back(logger);
+                }
+            }
+            return result;
+        }
+
+    private:
+        //不可变的开放寻址哈希表，容量为 2 的幂，负载不超过一半
+        struct Table
+        {
+            static const size_t npos = static_cast<size_t>(-1);
+
+            Table(const std::vector<cpplogs::Logger::ptr>& loggers, uint64_t gen)
+            : generation(gen)
+            , count(loggers.size())
+            {
+                size_t capacity = 8;
+                while(capacity < loggers.size() * 2)
+                {
+                    capacity *= 2;
+                }
+                slots.resize(capacity);
+                for(auto& logger : loggers)
+                {
+                    size_t i = hash(logger->name().c_str()) & (capacity - 1);
+                    while(slots[i])
+                    {
+                        i = (i + 1) & (capacity - 1);
+                    }
+                    slots[i] = logger;
+                }
+            }
+            //返回槽位下标，不存在时返回 npos
+            size_t find(const char* name) const
+            {
+                size_t mask = slots.size() - 1;
+                for(size_t i = hash(name) & mask; slots[i]; i = (i + 1) & mask)
+                {
+                    if(strcmp(slots[i]->name().c_str(), name) == 0)
+                    {
+                        return i;
+                    }
+                }
+                return npos;
+            }
+            //FNV-1a
+            static size_t hash(const char* name)
+            {
+                uint64_t h = 14695981039346656037ULL;
+                for(; *name != '\0'; name++)
+                {
+                    h = (h ^ static_cast<unsigned char>(*name)) * 1099511628211ULL;
+                }
+                return static_cast<size_t>(h);
+            }
+
+            uint64_t generation;//版本号，从 1 开始
+            size_t count;//日志器个数
+            std::vector<cpplogs::Logger::ptr> slots;
+        };
+
+        //线程缓存：名称字符串的地址 -> 表中的槽位，版本号不同时失效
+        struct CacheEntry
+        {
+            uint64_t generation;
+            const char* name;
+            size_t index;
+        };
+        static const size_t CACHE_SIZE = 16;
+        struct ThreadCache
+        {
+            uint64_t generation;//快照的版本号，0 表示还没有快照
+            std::shared_ptr<const Table> table;
+            CacheEntry entries[CACHE_SIZE];
+        };
+        static ThreadCache& cache()
+        {
+            static thread_local ThreadCache local = ThreadCache();
+            return local;
+        }
+        //本线程的快照，版本号变化后重新获取
+        ThreadCache& current() const
+        {
+            ThreadCache& local = cache();
+            if(local.generation != _generation.load(std::memory_order_acquire))
+            {
+                local.table = std::atomic_load(&_table);
+                local.generation = local.table->generation;
+            }
+            return local;
+        }
+        static const cpplogs::Logger::ptr& empty()
+        {
+            static const cpplogs::Logger::ptr logger;
+            return logger;
+        }
+
+        LoggerManager()
+        : _generation(0)
+        {
+            LoggerBuilder builder;
+            builder.buildLoggerName("root");
+            _root = builder.build();
+            publish(std::vector<cpplogs::Logger::ptr>(1, _root));
+        }
+        LoggerManager(const LoggerManager&) = delete;
+        LoggerManager& operator=(const LoggerManager&) = delete;
+
+        //当前表中名称不是 name 的日志器，调用者持有 _mutex
+        std::vector<cpplogs::Logger::ptr> others(const std::string& name) const
+        {
+            std::shared_ptr<const Table> table = std::atomic_load(&_table);
+            std::vector<cpplogs::Logger::ptr> loggers;
+            for(auto& entry : table->slots)
+            {
+                if(entry && entry->name() != name)
+                {
+                    loggers.push_back(entry);
+                }
+            }
+            return loggers;
+        }
+
+        //用新表替换注册表，先发布表再发布版本号，看到新版本号的线程一定能取到新表
+        void publish(const std::vector<cpplogs::Logger::ptr>& loggers)
+        {
+            uint64_t generation = _generation.load(std::memory_order_relaxed) + 1;
+            std::atomic_store(&_table, std::shared_ptr<const Table>(std::make_shared<Table>(loggers, generation)));
+            _generation.store(generation, std::memory_order_release);
+        }
+
+    private:
+        std::mutex _mutex;//只用于串行化注册与移除
+        cpplogs::Logger::ptr _root;
+        std::shared_ptr<const Table> _table;//通过 std::atomic_load/atomic_store 访问
+        std::atomic<uint64_t> _generation;//当前表的版本号
+    };
+
+    //构造后注册到 LoggerManager
+    class GlobalLoggerBuilder : public LoggerBuilder
+    {
+    public:
+        cpplogs::Logger::ptr build() override
+        {
+            cpplogs::Logger::ptr logger = LoggerBuilder::build();
+            cpplogs::LoggerManager::getInstance().addLogger(logger);
+            return logger;
+        }
+    };
+
+    //按名称获取全局日志器，不存在时返回空指针；返回的引用在本线程下一次查找之前有效
+    inline const cpplogs::Logger::ptr& getLogger(const char* name)
+    {
+        return cpplogs::LoggerManager::getInstance().getLogger(name);
+    }
+    inline const cpplogs::Logger::ptr& getLogger(const std::string& name)
+    {
+        return cpplogs::LoggerManager::getInstance().getLogger(name);
+    }
+    //按名称获取并持有全局日志器
+    inline cpplogs::Logger::ptr getSharedLogger(const std::string& name)
+    {
+        return cpplogs::LoggerManager::getInstance().getSharedLogger(name);
+    }
+    inline const cpplogs::Logger::ptr& rootLogger()
+    {
+        return cpplogs::LoggerManager::getInstance().rootLogger();
+    }
+}
+
+#endif
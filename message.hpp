@@ -3,45 +3,88 @@
 
 /*
  * message.hpp 日志消息类，进行日志中间信息的存储
- * 1. 日志输出时间
+ * 1. 日志输出时间（秒 + 秒内纳秒）
  * 2. 日志等级，进行日志过滤
  * 3. 源文件名称
  * 4. 源文件行号，定位出错的代码位置
  * 5. 线程ID，定位出错的线程
  * 6. 日志主体消息
  * 7. 日志器名称，支持多日志器同时使用
+ *
+ * LogMsg 不持有任何字符串，只保存指针：
+ * - 文件名来自 __FILE__，日志器名称由日志器持有，两者在进程/日志器生命周期内不变
+ * - 主体消息位于生产线程私有的缓冲区中，记录被消费（格式化/落地）后该缓冲区即被复用
+ *   需要跨线程排队的模块必须把主体消息拷贝到自己管理的存储中
+ * 在 64 位平台上整个结构体为 64 字节，恰好一个缓存行，构造时没有内存分配
 */
 
 #include "level.hpp"
 #include "util.hpp"
 #include <iostream>
 #include <string>
-#include <thread>
+#include <cstring>
+#include <cstdint>
 
 namespace cpplogs
 {
     struct LogMsg
     {
         time_t _ctime;//日志产生的时间戳
-        size_t _line;//行号
-        std::thread::id _tid;//线程ID
+        uint32_t _nsec;//时间戳秒内的纳秒部分
         cpplogs::LogLevel::value _level;//日志等级
-        std::string _file;//文件
-        std::string _logger;//日志器名称
-        std::string _payload;//日志信息的有效载荷
+        size_t _line;//行号
+        uint64_t _tid;//线程ID（pthread_t 的值，与 std::thread::id 的输出一致）
+        const char* _file;//文件
+        const char* _logger;//日志器名称
+        const char* _payload;//日志信息的有效载荷，不以 '\0' 结尾
+        size_t _payload_len;//有效载荷长度
 
         LogMsg(cpplogs::LogLevel::value level,
             size_t line,
-            const std::string file,
-            const std::string logger,
-            const std::string msg)
-            : _ctime(cpplogs::util::Date::getTime())
+            const char* file,
+            const char* logger,
+            const char* msg,
+            size_t msg_len)
+            : _ctime(0)
+            , _nsec(0)
             , _level(level)
             , _line(line)
-            , _tid(std::this_thread::get_id())
+            , _tid(cpplogs::util::Thread::id())
             , _file(file)
             , _logger(logger)
-            , _payload(msg) 
+            , _payload(msg)
+            , _payload_len(msg_len)
+            {
+                struct timespec ts = cpplogs::util::Date::getTimeSpec();
+                _ctime = ts.tv_sec;
+                _nsec = static_cast<uint32_t>(ts.tv_nsec);
+            }
+        //时间与线程ID已在产生日志的线程中取得（如并行格式化的工作线程）
+        LogMsg(cpplogs::LogLevel::value level,
+            size_t line,
+            const char* file,
+            const char* logger,
+            const char* msg,
+            size_t msg_len,
+            time_t ctime,
+            uint32_t nsec,
+            uint64_t tid)
+            : _ctime(ctime)
+            , _nsec(nsec)
+            , _level(level)
+            , _line(line)
+            , _tid(tid)
+            , _file(file)
+            , _logger(logger)
+            , _payload(msg)
+            , _payload_len(msg_len)
+            {}
+        LogMsg(cpplogs::LogLevel::value level,
+            size_t line,
+            const char* file,
+            const char* logger,
+            const char* msg)
+            : LogMsg(level, line, file, logger, msg, strlen(msg))
             {}
     };
     
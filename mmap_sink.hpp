@@ -0,0 +1,351 @@
+#ifndef __LOGS_MMAP_SINK_H__
+#define __LOGS_MMAP_SINK_H__
+
+/*
+ * mmap_sink.hpp 基于内存映射的落地方向
+ * 1. 文件按大块（默认 16M）预分配并映射，日志直接拷贝到映射区域，没有 write 系统调用
+ * 2. 映射空间不足时扩展文件并重新映射
+ * 3. 关闭或滚动时将文件截断为实际写入的长度
+ * 4. 进程崩溃时文件末尾可能残留预分配的 '\0'，再次打开时若文件长度恰好是整块大小则去掉末尾的 '\0'
+ * 5. flush 对已写入的部分发起异步回写（msync MS_ASYNC），不等待写完；数据在拷贝到映射区域后即对读取者可见
+*/
+
+#include "sink.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <cerrno>
+#include <cstring>
+
+namespace cpplogs
+{
+    #define DEFAULT_MMAP_CHUNK_SIZE (16 * 1024 * 1024)
+
+    //映射文件：追加写入，按块扩展
+    class MmapFile
+    {
+    public:
+        MmapFile(size_t chunk_size = DEFAULT_MMAP_CHUNK_SIZE)
+        : _fd(-1)
+        , _addr(nullptr)
+        , _map_size(0)
+        , _size(0)
+        , _chunk_size(chunk_size == 0 ? DEFAULT_MMAP_CHUNK_SIZE : chunk_size)
+        {
+            long page = sysconf(_SC_PAGESIZE);
+            _chunk_size = (_chunk_size + page - 1) / page * page;//映射长度按页对齐
+        }
+        ~MmapFile()
+        {
+            close();
+        }
+
+        //打开文件，已存在则在末尾追加
+        bool open(const std::string& pathname)
+        {
+            close();
+            _fd = ::open(pathname.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+            if(_fd < 0)
+            {
+                std::cerr << "[ERROR]cpplogs::MmapFile::open::" << pathname << ": " << strerror(errno) << std::endl;
+                return false;
+            }
+            struct stat st;
+            fstat(_fd, &st);
+            _size = st.st_size;
+            if(_size > 0 && _size % _chunk_size == 0)//上次未正常关闭，去掉预分配区域残留的 '\0'
+            {
+                trimZeroTail();
+            }
+            return grow(_size + 1);
+        }
+
+        //追加数据
+        bool write(const char* data, size_t len)
+        {
+            if(_addr == nullptr)
+            {
+                return false;
+            }
+            if(_size + len > _map_size && !grow(_size + len))
+            {
+                return false;
+            }
+            memcpy(_addr + _size, data, len);
+            _size += len;
+            return true;
+        }
+
+        //将已写入的数据异步写回磁盘（按页对齐，预分配未写入的部分不需要回写）
+        void flush()
+        {
+            if(_addr != nullptr && _size > 0)
+            {
+                long page = sysconf(_SC_PAGESIZE);
+                msync(_addr, (_size + page - 1) / page * page, MS_ASYNC);
+            }
+        }
+
+        //解除映射，文件截断为实际长度
+        void close()
+        {
+            if(_fd < 0)
+            {
+                return;
+            }
+            if(_addr != nullptr)
+            {
+                munmap(_addr, _map_size);
+                _addr = nullptr;
+            }
+            if(ftruncate(_fd, _size) < 0)
+            {
+                std::cerr << "[ERROR]cpplogs::MmapFile::close::ftruncate: " << strerror(errno) << std::endl;
+            }
+            ::close(_fd);
+            _fd = -1;
+            _map_size = 0;
+            _size = 0;
+        }
+
+        size_t size() const
+        {
+            return _size;
+        }
+
+    private:
+        //扩展文件并重新映射，保证至少 need 字节的映射空间
+        bool grow(size_t need)
+        {
+            size_t new_size = (need + _chunk_size - 1) / _chunk_size * _chunk_size;
+            //优先使用 fallocate 预留磁盘块，避免磁盘满时访问映射区域触发 SIGBUS
+            if(posix_fallocate(_fd, _map_size, new_size - _map_size) != 0 && ftruncate(_fd, new_size) < 0)
+            {
+                std::cerr << "[ERROR]cpplogs::MmapFile::grow::扩展文件失败: " << strerror(errno) << std::endl;
+                return false;
+            }
+            void* addr = MAP_FAILED;
+            if(_addr == nullptr)
+            {
+                addr = mmap(nullptr, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+            }
+            else
+            {
+                addr = mremap(_addr, _map_size, new_size, MREMAP_MAYMOVE);
+            }
+            if(addr == MAP_FAILED)
+            {
+                std::cerr << "[ERROR]cpplogs::MmapFile::grow::映射失败: " << strerror(errno) << std::endl;
+                return false;
+            }
+            _addr = static_cast<char*>(addr);
+            _map_size = new_size;
+            return true;
+        }
+
+        //从文件末尾向前跳过 '\0'，得到上次实际写入的长度
+        void trimZeroTail()
+        {
+            char buf[4096];
+            while(_size > 0)
+            {
+                size_t len = std::min(_size, sizeof(buf));
+                if(pread(_fd, buf, len, _size - len) != static_cast<ssize_t>(len))
+                {
+                    return;
+                }
+                size_t i = len;
+                while(i > 0 && buf[i - 1] == '\0')
+                {
+                    i--;
+                }
+                _size -= len - i;
+                if(i > 0)
+                {
+                    return;
+                }
+            }
+        }
+
+    private:
+        int _fd;
+        char* _addr;//映射起始地址
+        size_t _map_size;//映射长度（文件当前的物理长度）
+        size_t _size;//实际写入的数据长度
+        size_t _chunk_size;//每次扩展的大小
+    };
+
+    //落地方向: 指定文件（内存映射）
+    class MmapFileSink : public LogSink
+    {
+    public:
+        MmapFileSink(const std::string& pathname, size_t chunk_size = DEFAULT_MMAP_CHUNK_SIZE)
+        : _pathname(pathname)
+        , _file(chunk_size)
+        {
+            cpplogs::util::File::createDirectory(cpplogs::util::File::path(_pathname));
+            bool ret = _file.open(_pathname);
+            assert(ret);
+            (void)ret;
+        }
+        void log(const char* data, size_t len) override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if(!_file.write(data, len))
+            {
+                _stats.onError();
+            }
+        }
+        void flush() override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _file.flush();
+        }
+        std::string name() const override
+        {
+            return "mmap-file:" + _pathname;
+        }
+    private:
+        std::mutex _mutex;
+        const std::string _pathname;
+        cpplogs::MmapFile _file;
+    };
+
+    //落地方向: 滚动文件(大小，内存映射)
+    class MmapRollSinkBySize : public LogSink
+    {
+    public:
+        MmapRollSinkBySize(const std::string& basename, size_t max_size, size_t chunk_size = DEFAULT_MMAP_CHUNK_SIZE)
+        : _basename(basename)
+        , _file(std::min(chunk_size, max_size))
+        , _max_fsize(max_size)
+        , _name_count(0)
+        {
+            std::string pathname = createNewFile();
+            cpplogs::util::File::createDirectory(cpplogs::util::File::path(pathname));
+            bool ret = _file.open(pathname);
+            assert(ret);
+            (void)ret;
+        }
+
+        //超过最大大小时切换文件，关闭时旧文件被截断为实际长度，未用完的映射块不会留在磁盘上
+        void log(const char* data, size_t len) override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if(_file.size() >= _max_fsize)
+            {
+                _file.close();
+                bool ret = _file.open(createNewFile());
+                assert(ret);
+                (void)ret;
+                _stats.onRoll();
+            }
+            if(!_file.write(data, len))
+            {
+                _stats.onError();
+            }
+        }
+        void flush() override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _file.flush();
+        }
+        std::string name() const override
+        {
+            return "mmap-roll-size:" + _basename;
+        }
+
+    private:
+        std::string createNewFile()
+        {
+            time_t cur_time = cpplogs::util::Date::getTime();
+            return cpplogs::util::File::rollName(_basename, cur_time, ++_name_count);
+        }
+    private:
+        std::mutex _mutex;
+        std::string _basename;//基础文件名
+        cpplogs::MmapFile _file;
+        size_t _max_fsize;//记录最大大小，当前文件写入大小超过了这个大小就要切换文件
+        size_t _name_count;//名称计数器
+    };
+
+    //落地方向: 滚动文件(时间，内存映射)
+    class MmapRollSinkByTime : public LogSink
+    {
+    public:
+        MmapRollSinkByTime(const std::string& basename, cpplogs::TimeGap gap_type, size_t chunk_size = DEFAULT_MMAP_CHUNK_SIZE)
+        : MmapRollSinkByTime(basename, gapToSeconds(gap_type), chunk_size)
+        {}
+        MmapRollSinkByTime(const std::string& basename, size_t gap_seconds, size_t chunk_size = DEFAULT_MMAP_CHUNK_SIZE)
+        : _basename(basename)
+        , _file(chunk_size)
+        , _gap_size(gap_seconds == 0 ? 1 : gap_seconds)
+        {
+            _cur_gap = cpplogs::util::Date::getTime() / _gap_size;//当前是第几个时间段
+            std::string pathname = createNewFile();
+            cpplogs::util::File::createDirectory(cpplogs::util::File::path(pathname));
+            bool ret = _file.open(pathname);
+            assert(ret);
+            (void)ret;
+        }
+
+        void log(const char* data, size_t len) override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            time_t cur = cpplogs::util::Date::getTime();
+            if(static_cast<size_t>(cur) / _gap_size != _cur_gap)
+            {
+                _file.close();
+                _cur_gap = cur / _gap_size;
+                bool ret = _file.open(createNewFile());
+                assert(ret);
+                (void)ret;
+                _stats.onRoll();
+            }
+            if(!_file.write(data, len))
+            {
+                _stats.onError();
+            }
+        }
+        void flush() override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _file.flush();
+        }
+        std::string name() const override
+        {
+            return "mmap-roll-time:" + _basename;
+        }
+
+    private:
+        std::string createNewFile()
+        {
+            time_t cur_time = cpplogs::util::Date::getTime();
+            return cpplogs::util::File::rollName(_basename, cur_time, 0);
+        }
+
+        static size_t gapToSeconds(cpplogs::TimeGap gap_type)
+        {
+            switch (gap_type)
+            {
+            case cpplogs::TimeGap::GAP_SECOND:
+                return 1;
+            case cpplogs::TimeGap::GAP_MINUTE:
+                return 60;
+            case cpplogs::TimeGap::GAP_HOUR:
+                return 3600;
+            case cpplogs::TimeGap::GAP_DAY:
+                return 24 * 3600;
+            }
+            return 1;
+        }
+    private:
+        std::mutex _mutex;
+        std::string _basename;//基础文件名
+        cpplogs::MmapFile _file;
+        size_t _cur_gap;//当前是第几个时间段
+        size_t _gap_size;//时间段的大小
+    };
+}
+
+#endif
@@ -0,0 +1,452 @@
+#ifndef __LOGS_PARALLEL_H__
+#define __LOGS_PARALLEL_H__
+
+/*
+ * parallel.hpp 多线程并行格式化的异步日志器
+ * 1. 调用者线程只格式化主体消息（printf/{}），连同时间、等级、线程ID、调用点追加到当前批次，
+ *    按输出格式（Formmatter::format）格式化在后台的多个工作线程中完成
+ * 2. 调用者按线程分散到 2 * workers 个暂存分片，每个分片有自己的锁与当前批次，不同分片的调用者互不竞争；
+ *    同一线程总是使用同一个分片，同一线程的日志保持调用顺序，不同线程之间的先后顺序不作保证
+ * 3. 分片的当前批次达到 batch_size 字节、或有工作线程空闲时封装为一个批次，按封装顺序编号，
+ *    轮流放入各工作线程的任务队列；工作线程取完自己的队列后从其他队列窃取最早的批次
+ * 4. 排序提交：格式化完成的批次放入按编号索引的槽位，由一个线程按编号顺序连续写出到落地方向，
+ *    输出顺序与封装顺序一致；没有成为提交者的工作线程不等待，直接处理下一个批次
+ * 5. 同时存在的批次数（已封装、尚未写出）不超过 4 * workers，达到上限后 ASYNC_BLOCK 阻塞调用者，
+ *    ASYNC_GROW 继续追加到当前批次；批次缓冲区按 batch_size 预分配
+ * 6. 二进制模式与限流报告等已格式化的数据原样放入批次，不再格式化
+ * 7. ScopedField 等线程私有的字段（json_format.hpp）在调用者线程中随日志复制到批次，工作线程格式化时恢复
+ * 8. 析构时所有批次格式化并写出后工作线程才退出
+*/
+
+#include "logger.hpp"
+#include "json_format.hpp"
+#include <deque>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <condition_variable>
+
+namespace cpplogs
+{
+    class ParallelAsyncLogger : public Logger
+    {
+    public:
+        ParallelAsyncLogger(const std::string& logger_name,
+            cpplogs::LogLevel::value level,
+            const cpplogs::Formmatter::ptr& formmater,
+            const std::vector<cpplogs::LogSink::ptr>& sinks,
+            size_t workers = 4,
+            cpplogs::AsyncType looper_type = cpplogs::AsyncType::ASYNC_BLOCK,
+            size_t batch_size = 64 * 1024)
+        : Logger(logger_name, level, formmater, sinks)
+        , _looper_type(looper_type)
+        , _batch_size(batch_size == 0 ? 64 * 1024 : batch_size)
+        , _max_inflight(4 * (workers == 0 ? 1 : workers))
+        , _stop(false)
+        , _next_seq(0)
+        , _inflight(0)
+        , _staged(0)
+        , _queued(0)
+        , _next_commit(0)
+        , _committing(false)
+        , _slots(_max_inflight)
+        , _queues(workers == 0 ? 1 : workers)
+        {
+            for(auto& slot : _slots)
+            {
+                slot.store(nullptr, std::memory_order_relaxed);
+            }
+            for(size_t i = 0; i < 2 * _queues.size(); i++)
+            {
+                _shards.emplace_back(new Shard());
+                _shards.back()->current = newBatch();
+            }
+            for(size_t i = 0; i < _queues.size(); i++)
+            {
+                _threads.emplace_back(&ParallelAsyncLogger::threadEntry, this, i);
+            }
+        }
+        ~ParallelAsyncLogger()
+        {
+            reportSuppressed(true);
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _cond_work.notify_all();
+            for(auto& thread : _threads)
+            {
+                thread.join();
+            }
+            SinkSnapshot sinks(*this);
+            for(auto& sink : *sinks)
+            {
+                sink->flush();
+            }
+            for(auto& shard : _shards)
+            {
+                delete shard->current;
+            }
+            for(auto batch : _free)
+            {
+                delete batch;
+            }
+        }
+
+    protected:
+        //未格式化的日志，主体消息与字段紧随其后；file 为空表示数据已格式化，原样输出
+        struct RawRecord
+        {
+            time_t ctime;
+            uint32_t nsec;
+            uint32_t level;
+            uint64_t tid;
+            const char* file;
+            size_t line;
+            size_t len;//主体消息的字节数
+            size_t fields;//字段个数，每个字段依次为 4 字节键长度、键、4 字节值长度、值
+        };
+        struct Batch
+        {
+            Batch(size_t size)
+            : seq(0)
+            , level(cpplogs::LogLevel::value::UNKNOW)
+            , raw(size)
+            , out(size)
+            {}
+            uint64_t seq;//封装顺序
+            cpplogs::LogLevel::value level;//批次内的最高等级
+            cpplogs::Buffer raw;//未格式化的日志
+            cpplogs::Buffer out;//格式化结果
+        };
+        //调用者的暂存分片，各自单独分配，避免相邻分片的锁共享缓存行
+        struct Shard
+        {
+            Shard()
+            : current(nullptr)
+            {}
+            std::mutex mutex;
+            Batch* current;//正在追加的批次
+            char pad[64];
+        };
+        //每个工作线程的任务队列，按编号从小到大排列
+        struct WorkQueue
+        {
+            std::mutex mutex;
+            std::deque<Batch*> batches;
+        };
+
+        //格式化在工作线程中完成，不使用调用者的输出缓冲区
+        void commit(cpplogs::LogLevel::value level, const char* file, size_t line, const cpplogs::Buffer& payload, cpplogs::Buffer&) override
+        {
+            struct timespec ts = cpplogs::util::Date::getTimeSpec();
+            RawRecord record;
+            record.ctime = ts.tv_sec;
+            record.nsec = static_cast<uint32_t>(ts.tv_nsec);
+            record.level = static_cast<uint32_t>(level);
+            record.tid = cpplogs::util::Thread::id();
+            record.file = file;
+            record.line = line;
+            record.len = payload.readAbleSize();
+            record.fields = cpplogs::LogFields::size();
+            append(record, payload.begin());
+        }
+        void log(const char* data, size_t len, cpplogs::LogLevel::value level) override
+        {
+            RawRecord record;
+            memset(&record, 0, sizeof(record));
+            record.level = static_cast<uint32_t>(level);
+            record.len = len;
+            append(record, data);
+        }
+
+    private:
+        //当前线程使用的分片，线程第一次记录日志时轮流分配
+        Shard& shard()
+        {
+            static std::atomic<size_t> next(0);
+            static thread_local size_t index = next.fetch_add(1, std::memory_order_relaxed);
+            return *_shards[index % _shards.size()];
+        }
+
+        void append(const RawRecord& record, const char* data)
+        {
+            Shard& shard = this->shard();
+            std::unique_lock<std::mutex> lock(shard.mutex);
+            Batch* batch = shard.current;
+            bool was_empty = batch->raw.empty();
+            batch->raw.push(reinterpret_cast<const char*>(&record), sizeof(record));
+            batch->raw.push(data, record.len);
+            //字段属于调用者线程，在这里复制
+            const std::vector<cpplogs::LogFields::Field>& fields = cpplogs::LogFields::fields();
+            for(size_t i = 0; i < record.fields; i++)
+            {
+                pushString(batch->raw, fields[i].first);
+                pushString(batch->raw, fields[i].second);
+            }
+            if(static_cast<cpplogs::LogLevel::value>(record.level) > batch->level)
+            {
+                batch->level = static_cast<cpplogs::LogLevel::value>(record.level);
+            }
+            if(was_empty)
+            {
+                _staged.fetch_add(1, std::memory_order_relaxed);
+            }
+            if(batch->raw.readAbleSize() >= _batch_size)
+            {
+                std::unique_lock<std::mutex> global(_mutex);
+                if(_inflight < _max_inflight)
+                {
+                    seal(shard);
+                    global.unlock();
+                    _cond_work.notify_one();
+                    return;
+                }
+                if(_looper_type == cpplogs::AsyncType::ASYNC_BLOCK)
+                {
+                    //不持有分片的锁等待（空闲的工作线程会锁分片），有空位后由工作线程封装这个批次
+                    lock.unlock();
+                    _cond_space.wait(global, [&](){ return _inflight < _max_inflight; });
+                    global.unlock();
+                    _cond_work.notify_one();
+                    return;
+                }
+            }
+            //由空变为非空时唤醒一个空闲的工作线程封装分片的当前批次
+            if(was_empty)
+            {
+                lock.unlock();
+                {
+                    std::unique_lock<std::mutex> global(_mutex);
+                }
+                _cond_work.notify_one();
+            }
+        }
+        static void pushString(cpplogs::Buffer& buffer, const std::string& str)
+        {
+            uint32_t len = static_cast<uint32_t>(str.size());
+            buffer.push(reinterpret_cast<const char*>(&len), sizeof(len));
+            buffer.push(str.data(), str.size());
+        }
+        static const char* readString(const char* p, const char** str, size_t* len)
+        {
+            uint32_t n;
+            memcpy(&n, p, sizeof(n));
+            *str = p + sizeof(n);
+            *len = n;
+            return *str + n;
+        }
+
+        //封装分片的当前批次并放入任务队列，调用者持有分片的锁与 _mutex
+        void seal(Shard& shard)
+        {
+            Batch* batch = shard.current;
+            batch->seq = _next_seq++;
+            _inflight++;
+            shard.current = newBatch();
+            _staged.fetch_sub(1, std::memory_order_relaxed);
+            WorkQueue& queue = _queues[batch->seq % _queues.size()];
+            {
+                std::unique_lock<std::mutex> lock(queue.mutex);
+                queue.batches.push_back(batch);
+            }
+            _queued.fetch_add(1, std::memory_order_release);
+        }
+        //调用者持有 _mutex
+        Batch* newBatch()
+        {
+            if(_free.empty())
+            {
+                return new Batch(_batch_size);
+            }
+            Batch* batch = _free.back();
+            _free.pop_back();
+            return batch;
+        }
+        //空闲的工作线程封装一个非空的分片，返回是否封装；加锁顺序与调用者相同（先分片后 _mutex）
+        bool sealStaged(size_t id)
+        {
+            for(size_t i = 0; i < _shards.size(); i++)
+            {
+                Shard& shard = *_shards[(id + i) % _shards.size()];
+                std::unique_lock<std::mutex> lock(shard.mutex);
+                if(shard.current->raw.empty())
+                {
+                    continue;
+                }
+                std::unique_lock<std::mutex> global(_mutex);
+                if(_inflight >= _max_inflight)
+                {
+                    return false;
+                }
+                seal(shard);
+                return true;
+            }
+            return false;
+        }
+
+        //先取自己队列中最早的批次，再依次从其他队列窃取最早的批次（尽快解除顺序提交的等待）
+        Batch* take(size_t id)
+        {
+            for(size_t i = 0; i < _queues.size(); i++)
+            {
+                WorkQueue& queue = _queues[(id + i) % _queues.size()];
+                std::unique_lock<std::mutex> lock(queue.mutex);
+                if(!queue.batches.empty())
+                {
+                    Batch* batch = queue.batches.front();
+                    queue.batches.pop_front();
+                    _queued.fetch_sub(1, std::memory_order_relaxed);
+                    return batch;
+                }
+            }
+            return nullptr;
+        }
+
+        void threadEntry(size_t id)
+        {
+            while(true)
+            {
+                Batch* batch = _queued.load(std::memory_order_acquire) > 0 ? take(id) : nullptr;
+                if(batch == nullptr)
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    //没有待处理的批次：空闲时封装分片中的批次，避免日志在批次未满时滞留
+                    _cond_work.wait(lock, [&](){
+                        size_t staged = _staged.load(std::memory_order_relaxed);
+                        return _queued.load(std::memory_order_relaxed) > 0
+                            || (staged > 0 && _inflight < _max_inflight)
+                            || (_stop && staged == 0);
+                    });
+                    if(_queued.load(std::memory_order_relaxed) > 0)
+                    {
+                        continue;
+                    }
+                    if(_staged.load(std::memory_order_relaxed) == 0)
+                    {
+                        break;//已停止且没有剩余的日志
+                    }
+                    lock.unlock();
+                    sealStaged(id);
+                    continue;
+                }
+                format(*batch);
+                complete(batch);
+            }
+        }
+
+        void format(Batch& batch)
+        {
+            const char* p = batch.raw.begin();
+            const char* end = p + batch.raw.readAbleSize();
+            while(p < end)
+            {
+                RawRecord record;
+                memcpy(&record, p, sizeof(record));
+                p += sizeof(record);
+                if(record.file == nullptr)
+                {
+                    batch.out.push(p, record.len);
+                }
+                else
+                {
+                    cpplogs::LogMsg msg(static_cast<cpplogs::LogLevel::value>(record.level), record.line, record.file,
+                        _logger_name.c_str(), p, record.len, record.ctime, record.nsec, record.tid);
+                    //恢复调用者的字段，格式化后清空，工作线程自己不附加字段
+                    const char* q = p + record.len;
+                    for(size_t i = 0; i < record.fields; i++)
+                    {
+                        const char* key;
+                        const char* value;
+                        size_t key_len, value_len;
+                        q = readString(q, &key, &key_len);
+                        q = readString(q, &value, &value_len);
+                        cpplogs::LogFields::push(key, key_len, value, value_len);
+                    }
+                    _formmater->format(batch.out, msg);
+                    cpplogs::LogFields::size() = 0;
+                    p = q;
+                    continue;
+                }
+                p += record.len;
+            }
+        }
+
+        //放入排序槽位；没有其他提交者时按编号顺序写出所有连续就绪的批次
+        void complete(Batch* batch)
+        {
+            _slots[batch->seq % _max_inflight].store(batch, std::memory_order_seq_cst);
+            while(!_committing.exchange(true, std::memory_order_seq_cst))
+            {
+                for(;;)
+                {
+                    uint64_t seq = _next_commit.load(std::memory_order_relaxed);
+                    std::atomic<Batch*>& slot = _slots[seq % _max_inflight];
+                    Batch* ready = slot.load(std::memory_order_acquire);
+                    if(ready == nullptr)
+                    {
+                        break;
+                    }
+                    slot.store(nullptr, std::memory_order_relaxed);
+                    write(*ready);
+                    _next_commit.store(seq + 1, std::memory_order_relaxed);
+                    recycle(ready);
+                }
+                _committing.store(false, std::memory_order_seq_cst);
+                //释放提交权之后刚好就绪的批次：其工作线程没能成为提交者，由本线程再次尝试
+                if(_slots[_next_commit.load(std::memory_order_relaxed) % _max_inflight].load(std::memory_order_seq_cst) == nullptr)
+                {
+                    break;
+                }
+            }
+        }
+
+        //只有提交者调用，与 AsyncLogger 相同，何时写出由落地方向的刷新策略决定
+        void write(Batch& batch)
+        {
+            SinkSnapshot sinks(*this);
+            for(auto& sink : *sinks)
+            {
+                sinkLog(sink, batch.out.begin(), batch.out.readAbleSize(), batch.level);
+            }
+        }
+
+        void recycle(Batch* batch)
+        {
+            batch->raw.reset();
+            batch->out.reset();
+            batch->level = cpplogs::LogLevel::value::UNKNOW;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _free.push_back(batch);
+                _inflight--;
+            }
+            _cond_space.notify_all();
+            _cond_work.notify_one();
+        }
+
+    private:
+        cpplogs::AsyncType _looper_type;
+        size_t _batch_size;
+        size_t _max_inflight;//同时存在的批次数上限
+        std::mutex _mutex;//保护编号、空闲批次与 _inflight
+        std::condition_variable _cond_space;//调用者等待批次数低于上限
+        std::condition_variable _cond_work;//工作线程等待任务
+        bool _stop;
+        std::vector<std::unique_ptr<Shard>> _shards;//调用者的暂存分片
+        std::vector<Batch*> _free;//可复用的批次
+        uint64_t _next_seq;
+        size_t _inflight;
+        std::atomic<size_t> _staged;//当前批次非空的分片数
+        std::atomic<size_t> _queued;//任务队列中的批次数
+        std::atomic<uint64_t> _next_commit;//下一个要写出的编号，只由提交者修改
+        std::atomic<bool> _committing;//是否有线程正在提交
+        std::vector<std::atomic<Batch*>> _slots;//排序槽位，编号 % _max_inflight
+        std::vector<WorkQueue> _queues;
+        std::vector<std::thread> _threads;//最后初始化
+    };
+}
+
+#endif
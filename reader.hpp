@@ -0,0 +1,424 @@
+#ifndef __LOGS_READER_H__
+#define __LOGS_READER_H__
+
+/*
+ * reader.hpp 滚动文件集合的零拷贝读取与跟踪（tail）
+ * 1. LogReader 按基础文件名（与 RollSinkBySize/RollSinkByTime 的 basename 相同）查找同一组滚动文件，
+ *    按文件名中的滚动时间与序号排序（见 util::File::rollName），不依赖修改时间；
+ *    不符合该格式的文件（旧版本的文件名）排在前面，按修改时间排序；basename 本身是一个文件时只读取该文件（FileSink）
+ *    索引文件（.idx）与压缩后的文件（.gz）不在集合中
+ * 2. 每个文件通过 mmap 映射，next() 返回指向映射区的记录视图（不含换行符），不拷贝数据；
+ *    视图在下一次调用 next() 之前有效，需要保留时由调用者自行拷贝
+ * 3. 正在写入的文件（集合中最后一个）末尾没有换行符的部分视为未写完，等写完后再返回；
+ *    已滚动的文件不会再被写入，末尾缺少换行符的部分（进程异常退出）作为最后一条记录返回
+ *    mmap 落地方向预分配的文件末尾为 '\0'，遇到 '\0' 视为文件的有效数据结束
+ * 4. follow() 通过 inotify 监视文件所在目录，等待文件被写入或出现新的滚动文件，之后 next() 继续读取；
+ *    跟踪只适用于追加写入的落地方向（FileSink、RollSinkBy*），mmap 落地方向关闭时会截断文件，不应被跟踪
+*/
+
+#include "util.hpp"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+namespace cpplogs
+{
+    //一条日志记录的视图，指向文件映射区
+    struct LogRecordView
+    {
+        const char* data;//记录内容，不含换行符
+        size_t len;
+        size_t file;//记录所在文件在 files() 中的下标
+        uint64_t offset;//记录在文件中的偏移
+    };
+
+    class LogReader
+    {
+    public:
+        LogReader(const std::string& basename)
+        : _basename(basename)
+        , _cur(0)
+        , _pos(0)
+        , _inotify_fd(-1)
+        {
+            size_t pos = basename.find_last_of("/\\");
+            _dir = pos == std::string::npos ? "." : basename.substr(0, pos);
+            _prefix = pos == std::string::npos ? basename : basename.substr(pos + 1);
+            refresh();
+        }
+        ~LogReader()
+        {
+            for(auto& file : _files)
+            {
+                unmap(file);
+            }
+            if(_inotify_fd >= 0)
+            {
+                ::close(_inotify_fd);
+            }
+        }
+        LogReader(const LogReader&) = delete;
+        LogReader& operator=(const LogReader&) = delete;
+
+        //按顺序排列的滚动文件集合
+        static std::vector<std::string> discover(const std::string& basename)
+        {
+            std::vector<std::string> result;
+            struct stat st;
+            if(stat(basename.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+            {
+                result.push_back(basename);
+                return result;
+            }
+            size_t pos = basename.find_last_of("/\\");
+            std::string dir = pos == std::string::npos ? "." : basename.substr(0, pos);
+            std::string prefix = pos == std::string::npos ? basename : basename.substr(pos + 1);
+            DIR* dp = opendir(dir.c_str());
+            if(dp == nullptr)
+            {
+                return result;
+            }
+            struct Candidate
+            {
+                bool named;//文件名中带有滚动时间
+                std::string time;
+                uint64_t seq;
+                struct timespec mtime;
+                std::string pathname;
+            };
+            std::vector<Candidate> candidates;
+            for(struct dirent* ent = readdir(dp); ent != nullptr; ent = readdir(dp))
+            {
+                std::string name = ent->d_name;
+                if(!matches(prefix, name))
+                {
+                    continue;
+                }
+                Candidate c;
+                c.pathname = dir + "/" + name;
+                if(stat(c.pathname.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+                {
+                    continue;
+                }
+                c.mtime = st.st_mtim;
+                c.named = rollKey(prefix, name, c.time, c.seq);
+                candidates.push_back(c);
+            }
+            closedir(dp);
+            std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b){
+                if(a.named != b.named)
+                {
+                    return !a.named;
+                }
+                if(a.named)
+                {
+                    if(a.time != b.time)
+                    {
+                        return a.time < b.time;
+                    }
+                    if(a.seq != b.seq)
+                    {
+                        return a.seq < b.seq;
+                    }
+                    return a.pathname < b.pathname;
+                }
+                if(a.mtime.tv_sec != b.mtime.tv_sec)
+                {
+                    return a.mtime.tv_sec < b.mtime.tv_sec;
+                }
+                if(a.mtime.tv_nsec != b.mtime.tv_nsec)
+                {
+                    return a.mtime.tv_nsec < b.mtime.tv_nsec;
+                }
+                if(a.pathname.size() != b.pathname.size())
+                {
+                    return a.pathname.size() < b.pathname.size();
+                }
+                return a.pathname < b.pathname;
+            });
+            for(auto& c : candidates)
+            {
+                result.push_back(c.pathname);
+            }
+            return result;
+        }
+
+        //重新查找滚动文件，新出现的文件追加到集合末尾；已读取的文件被删除（如压缩后）不影响读取
+        void refresh()
+        {
+            std::vector<std::string> found = discover(_basename);
+            for(auto& pathname : found)
+            {
+                bool known = false;
+                for(auto& file : _files)
+                {
+                    if(file.pathname == pathname)
+                    {
+                        known = true;
+                        break;
+                    }
+                }
+                if(!known)
+                {
+                    File file;
+                    file.pathname = pathname;
+                    _files.push_back(file);
+                }
+            }
+        }
+
+        std::vector<std::string> files() const
+        {
+            std::vector<std::string> result;
+            for(auto& file : _files)
+            {
+                result.push_back(file.pathname);
+            }
+            return result;
+        }
+
+        //读取下一条完整的记录，当前没有完整的记录时返回 false（跟踪模式下可调用 follow() 等待后重试）
+        bool next(cpplogs::LogRecordView& record)
+        {
+            while(_cur < _files.size())
+            {
+                File& file = _files[_cur];
+                bool last = _cur + 1 == _files.size();
+                if(!last && !file.complete)
+                {
+                    //出现更新的文件之前旧文件已写完，重新映射一次即可看到全部数据
+                    remap(file);
+                    file.complete = true;
+                }
+                if(_pos < file.size && file.data[_pos] != '\0')
+                {
+                    const char* begin = file.data + _pos;
+                    size_t avail = file.size - _pos;
+                    const char* end = static_cast<const char*>(memchr(begin, '\n', avail));
+                    if(end != nullptr)
+                    {
+                        record.data = begin;
+                        record.len = end - begin;
+                        record.file = _cur;
+                        record.offset = _pos;
+                        _pos += record.len + 1;
+                        return true;
+                    }
+                    if(!last)
+                    {
+                        //已滚动的文件末尾没有换行符：截止到 '\0' 作为最后一条记录
+                        const char* zero = static_cast<const char*>(memchr(begin, '\0', avail));
+                        record.data = begin;
+                        record.len = zero == nullptr ? avail : zero - begin;
+                        record.file = _cur;
+                        record.offset = _pos;
+                        _pos = file.size;
+                        return true;
+                    }
+                }
+                if(!last)
+                {
+                    unmap(file);
+                    _cur++;
+                    _pos = 0;
+                    continue;
+                }
+                //正在写入的文件：映射的部分没有完整的记录，文件变长时重新映射后再查找
+                size_t mapped = file.size;
+                remap(file);
+                if(file.size == mapped)
+                {
+                    return false;
+                }
+            }
+            return false;
+        }
+
+        //跟踪模式：等待文件被写入或出现新的滚动文件，timeout_ms 为负数时一直等待
+        //有变化时返回 true；inotify 不可用时等待 timeout_ms 后返回 true，由调用者重新读取
+        bool follow(int timeout_ms)
+        {
+            if(_inotify_fd < 0)
+            {
+                //开始监视之前发生的变化无法通过 inotify 得知，第一次调用直接返回，由调用者重新读取
+                if(!watch())
+                {
+                    usleep(static_cast<useconds_t>(timeout_ms < 0 ? 100 : timeout_ms) * 1000);
+                }
+                refresh();
+                return true;
+            }
+            struct pollfd pfd;
+            pfd.fd = _inotify_fd;
+            pfd.events = POLLIN;
+            int ret = poll(&pfd, 1, timeout_ms);
+            if(ret <= 0)
+            {
+                return false;
+            }
+            bool created = false;
+            alignas(struct inotify_event) char buf[4096];
+            for(;;)
+            {
+                ssize_t len = ::read(_inotify_fd, buf, sizeof(buf));
+                if(len <= 0)
+                {
+                    break;
+                }
+                for(char* p = buf; p < buf + len; )
+                {
+                    struct inotify_event* event = reinterpret_cast<struct inotify_event*>(p);
+                    if((event->mask & (IN_CREATE | IN_MOVED_TO)) && event->len > 0 && matches(_prefix, event->name))
+                    {
+                        created = true;
+                    }
+                    p += sizeof(struct inotify_event) + event->len;
+                }
+            }
+            if(created)
+            {
+                refresh();
+            }
+            return true;
+        }
+
+    private:
+        struct File
+        {
+            File()
+            : data(nullptr)
+            , size(0)
+            , complete(false)
+            {}
+            std::string pathname;
+            const char* data;
+            size_t size;//映射的长度
+            bool complete;//已有更新的文件，不会再被写入
+        };
+
+        //滚动文件名：以 prefix 开头、以 .log 结尾
+        static bool matches(const std::string& prefix, const std::string& name)
+        {
+            static const std::string suffix = ".log";
+            return name.size() >= prefix.size() + suffix.size()
+                && name.compare(0, prefix.size(), prefix) == 0
+                && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+        }
+
+        //从滚动文件名中取出时间与序号：prefix + 14 位时间 [+ "-" + 序号] + .log
+        static bool rollKey(const std::string& prefix, const std::string& name, std::string& time, uint64_t& seq)
+        {
+            static const size_t TIME_LEN = 14;
+            size_t end = name.size() - 4;//去掉 .log
+            size_t pos = prefix.size();
+            if(end < pos + TIME_LEN)
+            {
+                return false;
+            }
+            for(size_t i = pos; i < pos + TIME_LEN; i++)
+            {
+                if(name[i] < '0' || name[i] > '9')
+                {
+                    return false;
+                }
+            }
+            time = name.substr(pos, TIME_LEN);
+            seq = 0;
+            pos += TIME_LEN;
+            if(pos == end)
+            {
+                return true;
+            }
+            if(name[pos] != '-' || pos + 1 == end)
+            {
+                return false;
+            }
+            for(pos++; pos < end; pos++)
+            {
+                if(name[pos] < '0' || name[pos] > '9')
+                {
+                    return false;
+                }
+                seq = seq * 10 + (name[pos] - '0');
+            }
+            return true;
+        }
+
+        //文件变长时重新映射，只映射 stat 得到的长度，不会访问文件末尾之外的页
+        void remap(File& file)
+        {
+            int fd = ::open(file.pathname.c_str(), O_RDONLY | O_CLOEXEC);
+            if(fd < 0)
+            {
+                return;//文件已被删除时继续使用原有的映射
+            }
+            struct stat st;
+            if(fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) > file.size)
+            {
+                void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+                if(addr == MAP_FAILED)
+                {
+                    std::cerr << "[ERROR]cpplogs::LogReader::remap::mmap " << file.pathname << ": " << strerror(errno) << std::endl;
+                }
+                else
+                {
+                    unmap(file);
+                    madvise(addr, st.st_size, MADV_SEQUENTIAL);
+                    file.data = static_cast<const char*>(addr);
+                    file.size = st.st_size;
+                }
+            }
+            ::close(fd);
+        }
+
+        static void unmap(File& file)
+        {
+            if(file.data != nullptr)
+            {
+                munmap(const_cast<char*>(file.data), file.size);
+                file.data = nullptr;
+                file.size = 0;
+            }
+        }
+
+        bool watch()
+        {
+            _inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if(_inotify_fd < 0)
+            {
+                std::cerr << "[ERROR]cpplogs::LogReader::watch::inotify_init1: " << strerror(errno) << std::endl;
+                return false;
+            }
+            if(inotify_add_watch(_inotify_fd, _dir.c_str(), IN_MODIFY | IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE) < 0)
+            {
+                std::cerr << "[ERROR]cpplogs::LogReader::watch::inotify_add_watch " << _dir << ": " << strerror(errno) << std::endl;
+                ::close(_inotify_fd);
+                _inotify_fd = -1;
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        std::string _basename;
+        std::string _dir;
+        std::string _prefix;
+        std::vector<File> _files;
+        size_t _cur;//当前读取的文件
+        size_t _pos;//当前文件中下一条记录的偏移
+        int _inotify_fd;
+    };
+}
+
+#endif
@@ -6,13 +6,39 @@
  * 1. 抽象落地基类
  * 2. 派生子类（根据不同的落地方向进行派生）
  * 3. 使用工厂模式进行创建与表示的分离
+ * 4. 支持批量落地（iovec），文件落地方向在原始文件描述符上用一次 writev 写入
+ * 5. 文件落地方向按刷新策略（字节数、条数、时间间隔、日志等级）决定何时真正写入文件
+ * 6. 落地方向自行保证线程安全（日志器不再为落地加锁），需要互斥的落地方向在内部加锁
+ * 7. 每个落地方向带有运行时统计（stats.hpp），写入失败与滚动由落地方向自己计数，落地次数、字节数与耗时由日志器计数
+ * 8. 滚动文件落地方向在切换文件后通过回调交出已写完的旧文件（如交给后台压缩，见 compress.hpp）
+ * 9. 滚动文件落地方向可选地为每个文件写入稀疏索引（见 index.hpp），按时间与等级定位日志所在的字节区间
+ * 10. 滚动文件落地方向由 RollHelper 辅助线程提前准备下一个文件、判断时间边界、在后台关闭旧文件，
+ *     写入路径上的切换只是交换文件描述符
 */
 
 #include "util.hpp"
+#include "level.hpp"
+#include "buffer.hpp"
+#include "stats.hpp"
+#include "index.hpp"
 #include <fstream>
 #include <memory>
 #include <cassert>
 #include <sstream>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <climits>
+#include <sys/uio.h>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <condition_variable>
+#include <sys/stat.h>
 
 namespace cpplogs
 {
@@ -22,6 +48,521 @@ namespace cpplogs
         using ptr = std::shared_ptr<LogSink>;
         virtual ~LogSink() {};
         virtual void log(const char* data, size_t len) = 0;
+        //批量落地，默认逐条调用单条接口
+        virtual void log(const struct iovec* iov, size_t cnt)
+        {
+            for(size_t i = 0; i < cnt; i++)
+            {
+                log(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+            }
+        }
+        //携带日志等级的落地（数据中包含多条日志时为其中的最高等级），默认忽略等级
+        virtual void log(const char* data, size_t len, cpplogs::LogLevel::value level)
+        {
+            log(data, len);
+        }
+        //将缓存的数据写出
+        virtual void flush() {}
+        //名称，用于统计信息的输出
+        virtual std::string name() const
+        {
+            return "sink";
+        }
+        cpplogs::SinkStats& stats()
+        {
+            return _stats;
+        }
+        const cpplogs::SinkStats& stats() const
+        {
+            return _stats;
+        }
+    protected:
+        cpplogs::SinkStats _stats;//运行时统计
+    };
+
+    //文件落地方向的刷新策略，任一条件满足即写入文件
+    struct FlushPolicy
+    {
+        size_t bytes;//缓存数据达到该字节数，0 表示每条日志立即写入
+        size_t records;//缓存日志达到该条数，0 表示不限制
+        size_t interval_ms;//距上次写入超过该时间（在落地时检查），0 表示不限制
+        cpplogs::LogLevel::value level;//日志等级不低于该等级时立即写入，OFF 表示不生效
+
+        FlushPolicy(size_t flush_bytes = 8192,
+            size_t flush_records = 0,
+            size_t flush_interval_ms = 0,
+            cpplogs::LogLevel::value flush_level = cpplogs::LogLevel::value::ERROR)
+        : bytes(flush_bytes)
+        , records(flush_records)
+        , interval_ms(flush_interval_ms)
+        , level(flush_level)
+        {}
+        //每条日志立即写入
+        static FlushPolicy immediate()
+        {
+            return FlushPolicy(0, 0, 0, cpplogs::LogLevel::value::UNKNOW);
+        }
+    };
+
+    //滚动回调：参数为已关闭、不再写入的旧文件路径，在滚动辅助线程中调用（见 RollHelper），不应长时间阻塞
+    using RollCallback = std::function<void(const std::string&)>;
+
+    //基于文件描述符的追加写文件，按刷新策略缓存数据，批量数据用 writev 一次写入
+    class FdFile
+    {
+    public:
+        FdFile(const cpplogs::FlushPolicy& policy = cpplogs::FlushPolicy())
+        : _fd(-1)
+        , _stats(nullptr)
+        , _policy(policy)
+        , _pending(policy.bytes == 0 ? 256 : policy.bytes)
+        , _pending_records(0)
+        , _last_flush_ms(0)
+        {}
+        ~FdFile()
+        {
+            close();
+        }
+
+        bool open(const std::string& pathname)
+        {
+            close();
+            _fd = ::open(pathname.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);//写入和追加
+            if(_fd < 0)
+            {
+                std::cerr << "[ERROR]cpplogs::FdFile::open::" << pathname << ": " << strerror(errno) << std::endl;
+                if(_stats != nullptr)
+                {
+                    _stats->onError();
+                }
+                return false;
+            }
+            _last_flush_ms = nowMs();
+            return true;
+        }
+        bool isOpen() const
+        {
+            return _fd >= 0;
+        }
+        //写入失败计入所属落地方向的统计
+        void setStats(cpplogs::SinkStats* stats)
+        {
+            _stats = stats;
+        }
+
+        //写入一条日志
+        void write(const char* data, size_t len, cpplogs::LogLevel::value level)
+        {
+            if(_pending.empty() && len >= _policy.bytes)//无缓存数据且本条已达到阈值，直接写入
+            {
+                struct iovec iov = { const_cast<char*>(data), len };
+                writeAll(&iov, 1);
+                _last_flush_ms = nowMs();
+                return;
+            }
+            if(_pending.writeAbleSize() < len)//缓存剩余空间不足，先写出，避免缓存扩容
+            {
+                flush();
+            }
+            _pending.push(data, len);
+            _pending_records++;
+            if(needFlush(level))
+            {
+                flush();
+            }
+        }
+
+        //批量写入：缓存数据与本批数据合并为一次 writev
+        void write(const struct iovec* iov, size_t cnt, cpplogs::LogLevel::value level)
+        {
+            size_t total = 0;
+            for(size_t i = 0; i < cnt; i++)
+            {
+                total += iov[i].iov_len;
+            }
+            if(_pending.readAbleSize() + total < _policy.bytes)//数据量小，先缓存
+            {
+                for(size_t i = 0; i < cnt; i++)
+                {
+                    _pending.push(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+                }
+                _pending_records += cnt;
+                if(needFlush(level))
+                {
+                    flush();
+                }
+                return;
+            }
+            std::vector<struct iovec> vec;
+            vec.reserve(cnt + 1);
+            if(!_pending.empty())
+            {
+                struct iovec pending = { const_cast<char*>(_pending.begin()), _pending.readAbleSize() };
+                vec.push_back(pending);
+            }
+            vec.insert(vec.end(), iov, iov + cnt);
+            writeAll(vec.data(), vec.size());
+            _pending.reset();
+            _pending_records = 0;
+            _last_flush_ms = nowMs();
+        }
+
+        //将缓存的数据写入文件
+        void flush()
+        {
+            if(!_pending.empty())
+            {
+                struct iovec iov = { const_cast<char*>(_pending.begin()), _pending.readAbleSize() };
+                writeAll(&iov, 1);
+                _pending.reset();
+                _pending_records = 0;
+            }
+            _last_flush_ms = nowMs();
+        }
+
+        void close()
+        {
+            if(_fd < 0)
+            {
+                return;
+            }
+            flush();
+            ::close(_fd);
+            _fd = -1;
+        }
+
+        //切换文件：写出缓存数据后交出当前的文件描述符（由调用者关闭），再使用已打开的 fd
+        int detach()
+        {
+            flush();
+            int fd = _fd;
+            _fd = -1;
+            return fd;
+        }
+        void attach(int fd)
+        {
+            close();
+            _fd = fd;
+            _last_flush_ms = nowMs();
+        }
+
+    private:
+        bool needFlush(cpplogs::LogLevel::value level) const
+        {
+            if(_pending.readAbleSize() >= _policy.bytes)
+            {
+                return true;
+            }
+            if(_policy.records != 0 && _pending_records >= _policy.records)
+            {
+                return true;
+            }
+            if(_policy.level != cpplogs::LogLevel::value::OFF && level >= _policy.level)
+            {
+                return true;
+            }
+            return _policy.interval_ms != 0 && nowMs() - _last_flush_ms >= _policy.interval_ms;
+        }
+
+        //写入全部数据，处理部分写入与信号中断；iovec 数量超过 IOV_MAX 时分批
+        void writeAll(struct iovec* iov, size_t cnt)
+        {
+            while(cnt > 0)
+            {
+                int n = static_cast<int>(std::min(cnt, static_cast<size_t>(IOV_MAX)));
+                ssize_t ret = ::writev(_fd, iov, n);
+                if(ret < 0)
+                {
+                    if(errno == EINTR)
+                    {
+                        continue;
+                    }
+                    std::cerr << "[ERROR]cpplogs::FdFile::writeAll::writev: " << strerror(errno) << std::endl;
+                    if(_stats != nullptr)
+                    {
+                        _stats->onError();
+                    }
+                    return;
+                }
+                size_t done = static_cast<size_t>(ret);
+                while(cnt > 0 && done >= iov->iov_len)//跳过已完整写入的部分
+                {
+                    done -= iov->iov_len;
+                    iov++;
+                    cnt--;
+                }
+                if(cnt > 0 && done > 0)
+                {
+                    iov->iov_base = static_cast<char*>(iov->iov_base) + done;
+                    iov->iov_len -= done;
+                }
+            }
+        }
+
+        static uint64_t nowMs()
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+            return static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+        }
+
+    private:
+        int _fd;
+        cpplogs::SinkStats* _stats;
+        cpplogs::FlushPolicy _policy;
+        cpplogs::Buffer _pending;//尚未写入文件的数据
+        size_t _pending_records;//尚未写入文件的日志条数
+        uint64_t _last_flush_ms;//上次写入文件的时间
+    };
+
+    //滚动辅助线程：把切换文件的开销移出写入路径
+    //1. 提前准备下一个文件：以 O_TMPFILE 打开（目录中不可见，读取方不会看到尚未使用的空文件）并预留磁盘空间，
+    //   切换时调用者按切换的时间生成文件名（按时间滚动时为时间段的开始时间），只需一次 linkat 赋予文件名；
+    //   文件系统不支持 O_TMPFILE 或 /proc 不可用时，切换时直接打开文件
+    //2. 按时间滚动时，到达时间边界由辅助线程置位滚动标志，写入路径上只读取该标志，不再每条日志取一次时间
+    //3. 旧文件交给辅助线程：释放多余的预留空间、可选地 fdatasync，然后关闭并调用滚动回调
+    class RollHelper
+    {
+    public:
+        //根据时间生成文件名：按大小滚动时为切换的时间，按时间滚动时为文件对应时间段的开始时间
+        using Namer = std::function<std::string(time_t)>;
+        struct NextFile
+        {
+            int fd;//打开失败时为 -1
+            std::string pathname;
+        };
+
+        //gap_seconds 为 0 表示按大小滚动；prealloc 为下一个文件预留的字节数
+        RollHelper(const std::string& dir, const Namer& namer, size_t gap_seconds, size_t prealloc)
+        : _dir(dir)
+        , _namer(namer)
+        , _gap(gap_seconds)
+        , _prealloc(prealloc)
+        , _stop(false)
+        , _ready(false)
+        , _boundary(gap_seconds == 0 ? 0 : (time(nullptr) / gap_seconds + 1) * gap_seconds)
+        , _next_time(0)
+        , _sync(false)
+        , _due(false)
+        , _tmpfile(true)
+        {
+            _next.fd = -1;
+            _thread = std::thread(&RollHelper::threadEntry, this);
+        }
+        //处理完所有旧文件后退出，准备好但未使用的文件没有文件名，关闭即释放
+        ~RollHelper()
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _cond.notify_all();
+            _thread.join();
+            if(_next.fd >= 0)
+            {
+                ::close(_next.fd);
+            }
+        }
+
+        //旧文件关闭前是否 fdatasync
+        void setSync(bool sync)
+        {
+            _sync.store(sync, std::memory_order_relaxed);
+        }
+
+        //是否已到达下一个时间边界
+        bool due() const
+        {
+            return _due.load(std::memory_order_relaxed);
+        }
+
+        //取得准备好的下一个文件（辅助线程尚未准备好时等待），prealloc 为再下一个文件预留的字节数
+        NextFile take(size_t prealloc)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cond_ready.wait(lock, [&](){ return _ready; });
+            NextFile next = _next;
+            _next.fd = -1;
+            _ready = false;
+            _prealloc = prealloc;
+            if(_gap == 0)
+            {
+                next.pathname = _namer(time(nullptr));
+            }
+            else
+            {
+                time_t start = std::max<time_t>(time(nullptr) / _gap * _gap, _next_time);
+                if(start != _next_time)//长时间没有日志，文件名对应的时间段已经过去
+                {
+                    next.pathname = _namer(start);
+                }
+                _boundary = start + _gap;
+                _due.store(false, std::memory_order_relaxed);
+            }
+            lock.unlock();
+            _cond.notify_all();
+            if(next.fd >= 0)
+            {
+                char proc[64];
+                snprintf(proc, sizeof(proc), "/proc/self/fd/%d", next.fd);
+                if(linkat(AT_FDCWD, proc, AT_FDCWD, next.pathname.c_str(), AT_SYMLINK_FOLLOW) == 0)
+                {
+                    futimens(next.fd, nullptr);//修改时间取切换的时间，而不是准备的时间
+                    return next;
+                }
+                if(errno != EEXIST)
+                {
+                    _tmpfile.store(false, std::memory_order_relaxed);
+                }
+                ::close(next.fd);
+            }
+            //文件已存在时追加写入
+            next.fd = ::open(next.pathname.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if(next.fd < 0)
+            {
+                std::cerr << "[ERROR]cpplogs::RollHelper::take::" << next.pathname << ": " << strerror(errno) << std::endl;
+            }
+            return next;
+        }
+
+        //交出已写完的旧文件，由辅助线程关闭后调用 cb
+        void retire(int fd, const std::string& pathname, const cpplogs::RollCallback& cb)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                Retired retired = { fd, pathname, cb };
+                _retired.push_back(retired);
+            }
+            _cond.notify_all();
+        }
+
+    private:
+        struct Retired
+        {
+            int fd;
+            std::string pathname;
+            cpplogs::RollCallback cb;
+        };
+
+        void threadEntry()
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while(true)
+            {
+                if(!_ready && !_stop)
+                {
+                    time_t t = _boundary;
+                    size_t prealloc = _prealloc;
+                    lock.unlock();
+                    NextFile next;
+                    if(_gap != 0)
+                    {
+                        next.pathname = _namer(t);
+                    }
+                    next.fd = openTmp(prealloc);
+                    lock.lock();
+                    _next = next;
+                    _next_time = t;
+                    _ready = true;
+                    _cond_ready.notify_all();
+                    continue;
+                }
+                if(!_retired.empty())
+                {
+                    Retired retired = _retired.front();
+                    _retired.erase(_retired.begin());
+                    lock.unlock();
+                    closeOld(retired);
+                    lock.lock();
+                    continue;
+                }
+                if(_stop)
+                {
+                    break;
+                }
+                if(_gap != 0 && !_due.load(std::memory_order_relaxed))
+                {
+                    std::chrono::system_clock::time_point deadline = std::chrono::system_clock::from_time_t(_boundary);
+                    if(std::chrono::system_clock::now() >= deadline)
+                    {
+                        _due.store(true, std::memory_order_relaxed);
+                        continue;
+                    }
+                    _cond.wait_until(lock, deadline);
+                }
+                else
+                {
+                    _cond.wait(lock);
+                }
+            }
+        }
+
+        int openTmp(size_t prealloc)
+        {
+            if(!_tmpfile.load(std::memory_order_relaxed))
+            {
+                return -1;
+            }
+            int fd = ::open(_dir.c_str(), O_TMPFILE | O_WRONLY | O_APPEND | O_CLOEXEC, 0644);
+            if(fd < 0)
+            {
+                _tmpfile.store(false, std::memory_order_relaxed);
+                return -1;
+            }
+            //只预留磁盘块，不改变文件长度（追加写入从 0 开始）；失败不影响使用
+            if(prealloc != 0)
+            {
+                fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, prealloc);
+            }
+            return fd;
+        }
+
+        void closeOld(const Retired& retired)
+        {
+            if(retired.fd >= 0)
+            {
+                //释放超出文件长度的预留空间；截断会更新修改时间，之后恢复为最后一次写入的时间，
+                //否则已滚动的文件比正在写入的文件更新
+                struct stat st;
+                if(fstat(retired.fd, &st) == 0 && static_cast<off_t>(st.st_blocks) * 512 > (st.st_size + st.st_blksize - 1) / st.st_blksize * st.st_blksize)
+                {
+                    if(ftruncate(retired.fd, st.st_size) < 0)
+                    {
+                        std::cerr << "[ERROR]cpplogs::RollHelper::closeOld::ftruncate: " << strerror(errno) << std::endl;
+                    }
+                    struct timespec times[2] = { st.st_atim, st.st_mtim };
+                    futimens(retired.fd, times);
+                }
+                if(_sync.load(std::memory_order_relaxed))
+                {
+                    fdatasync(retired.fd);
+                }
+                ::close(retired.fd);
+            }
+            if(retired.cb)
+            {
+                retired.cb(retired.pathname);
+            }
+        }
+
+    private:
+        std::string _dir;
+        Namer _namer;
+        size_t _gap;
+        size_t _prealloc;
+        std::mutex _mutex;
+        std::condition_variable _cond;//唤醒辅助线程
+        std::condition_variable _cond_ready;//下一个文件已准备好
+        bool _stop;
+        bool _ready;//_next 是否已准备好
+        NextFile _next;
+        time_t _boundary;//下一个时间边界（按时间滚动）
+        time_t _next_time;//_next 的文件名对应的时间
+        std::vector<Retired> _retired;//等待关闭的旧文件
+        std::atomic<bool> _sync;
+        std::atomic<bool> _due;//已到达时间边界，写入路径读取
+        std::atomic<bool> _tmpfile;//O_TMPFILE 是否可用
+        std::thread _thread;//最后初始化
     };
 
     //落地方向: 标准输出
@@ -31,94 +572,213 @@ namespace cpplogs
         //将日志消息写入到标准输出
         void log(const char* data, size_t len)
         {
+            std::unique_lock<std::mutex> lock(_mutex);
             std::cout.write(data, len);
         }
+        void flush() override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            std::cout.flush();
+        }
+        std::string name() const override
+        {
+            return "stdout";
+        }
+    private:
+        std::mutex _mutex;
     };
     //落地方向: 指定文件
     class FileSink : public LogSink
     {
     public:
-        //构造时传入文件名，打开文件，将文件句柄管理起来
-        FileSink(const std::string& pathname)
+        //构造时传入文件名，打开文件，将文件描述符管理起来
+        FileSink(const std::string& pathname, const cpplogs::FlushPolicy& policy = cpplogs::FlushPolicy())
         : _pathname(pathname)
+        , _file(policy)
         {
             //创建日志文件所在的目录
             cpplogs::util::File::createDirectory(cpplogs::util::File::path(_pathname));
             //创建并打开日志文件
-            _ofs.open(_pathname, std::ios::binary | std::ios::app);//写入和追加
-            assert(_ofs.is_open());
+            _file.setStats(&_stats);
+            _file.open(_pathname);
+            assert(_file.isOpen());
+        }
+        std::string name() const override
+        {
+            return "file:" + _pathname;
         }
         //将日志消息写入到指定文件
-        void log(const char* data, size_t len)
+        void log(const char* data, size_t len) override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _file.write(data, len, cpplogs::LogLevel::value::UNKNOW);
+        }
+        void log(const char* data, size_t len, cpplogs::LogLevel::value level) override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _file.write(data, len, level);
+        }
+        void log(const struct iovec* iov, size_t cnt) override
         {
-            _ofs.write(data, len);
-            assert(_ofs.good());
+            std::unique_lock<std::mutex> lock(_mutex);
+            _file.write(iov, cnt, cpplogs::LogLevel::value::UNKNOW);
+        }
+        void flush() override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _file.flush();
         }
     private:
+        std::mutex _mutex;
         const std::string _pathname;
-        std::ofstream _ofs;
+        cpplogs::FdFile _file;
     };
     //落地方向: 滚动文件(大小)
     class RollSinkBySize : public LogSink
     {
     public:
+        //为下一个文件预留的磁盘空间默认不超过该值，文件上限很大时不一次占用整个文件的空间
+        static const size_t DEFAULT_PREALLOC = 4 * 1024 * 1024;
+
         //构造时传入文件名，打开文件，将文件句柄管理起来
-        RollSinkBySize(const std::string& basename, size_t max_size)
+        RollSinkBySize(const std::string& basename, size_t max_size, const cpplogs::FlushPolicy& policy = cpplogs::FlushPolicy())
         : _basename(basename)
+        , _file(policy)
         , _max_fsize(max_size)
         , _cur_fsize(0)
         , _name_count(0)
+        , _prealloc(max_size < DEFAULT_PREALLOC ? max_size : DEFAULT_PREALLOC)
         {
-            std::string pathname = createNewFile();
+            _pathname = createNewFile(cpplogs::util::Date::getTime());
             //创建日志文件所在的目录
-            cpplogs::util::File::createDirectory(cpplogs::util::File::path(pathname));
+            cpplogs::util::File::createDirectory(cpplogs::util::File::path(_pathname));
             //创建并打开日志文件
-            _ofs.open(pathname, std::ios::binary | std::ios::app);//写入和追加
-            assert(_ofs.is_open());
+            _file.setStats(&_stats);
+            _file.open(_pathname);
+            assert(_file.isOpen());
+            //之后的文件名由辅助线程生成
+            _helper.reset(new cpplogs::RollHelper(cpplogs::util::File::path(_pathname),
+                std::bind(&RollSinkBySize::createNewFile, this, std::placeholders::_1), 0, _prealloc));
+        }
+        std::string name() const override
+        {
+            return "roll-size:" + _basename;
+        }
+
+        //为之后准备的文件预留的字节数（超过文件上限时取文件上限），0 表示不预留；已准备好的文件不受影响
+        void setPrealloc(size_t bytes)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _prealloc = std::min(bytes, _max_fsize);
+        }
+
+        //设置滚动回调，需在开始记录日志之前调用
+        void setRollCallback(const cpplogs::RollCallback& cb)
+        {
+            _roll_cb = cb;
+        }
+        //滚动后旧文件关闭前是否 fdatasync（在辅助线程中进行）
+        void setSyncOnRoll(bool sync)
+        {
+            _helper->setSync(sync);
+        }
+        //为每个日志文件写入稀疏索引，需在开始记录日志之前调用
+        void enableIndex(size_t interval_bytes = 64 * 1024, size_t interval_ms = 1000)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _index.reset(new cpplogs::IndexWriter(interval_bytes, interval_ms));
+            _index->open(_pathname);
         }
 
         //将日志消息写入到指定文件
-        void log(const char* data, size_t len)
+        void log(const char* data, size_t len) override
+        {
+            log(data, len, cpplogs::LogLevel::value::UNKNOW);
+        }
+        void log(const char* data, size_t len, cpplogs::LogLevel::value level) override
         {
-            if(_cur_fsize >= _max_fsize)//进行大小判断，超过最大大小创建新文件
+            std::unique_lock<std::mutex> lock(_mutex);
+            rollIfNeeded();
+            if(_index)
             {
-                std::string pathname = createNewFile();
-                _ofs.close();//关闭原来打开的文件
-                _cur_fsize = 0;
-                _ofs.open(pathname, std::ios::binary | std::ios::app);//写入和追加
-                assert(_ofs.is_open());
+                _index->onWrite(len, level);
             }
-            _ofs.write(data, len);
+            _file.write(data, len, level);
             _cur_fsize += len;
-            assert(_ofs.good());
+        }
+        //批量写入，一批数据写入同一个文件
+        void log(const struct iovec* iov, size_t cnt) override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            rollIfNeeded();
+            size_t len = 0;
+            for(size_t i = 0; i < cnt; i++)
+            {
+                len += iov[i].iov_len;
+            }
+            if(_index)
+            {
+                _index->onWrite(len, cpplogs::LogLevel::value::UNKNOW);
+            }
+            _file.write(iov, cnt, cpplogs::LogLevel::value::UNKNOW);
+            _cur_fsize += len;
+        }
+        void flush() override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _file.flush();
+            if(_index)
+            {
+                _index->flush();
+            }
         }
 
     private:
-        std::string createNewFile()
-        {
-            //获取系统时间，以时间来构造文件名拓展名
-            time_t cur_time = cpplogs::util::Date::getTime();
-            struct tm st;
-            localtime_r(&cur_time, &st);
-            std::stringstream filename;
-            filename << _basename;
-            filename << st.tm_year + 1900;
-            filename << st.tm_mon + 1;
-            filename << st.tm_mday;
-            filename << st.tm_hour;
-            filename << st.tm_min;
-            filename << st.tm_sec;
-            filename << ++_name_count;
-            filename << ".log";
-            return filename.str();
+        //进行大小判断，超过最大大小切换到辅助线程准备好的文件（切换前写出缓存数据），旧文件交给辅助线程关闭
+        void rollIfNeeded()
+        {
+            if(_cur_fsize >= _max_fsize)
+            {
+                cpplogs::RollHelper::NextFile next = _helper->take(_prealloc);
+                if(next.fd < 0)
+                {
+                    _stats.onError();
+                    _cur_fsize = 0;//无法打开新文件时继续写入当前文件，写满一个文件后再次尝试
+                    return;
+                }
+                int old_fd = _file.detach();
+                _file.attach(next.fd);
+                std::string old_pathname = _pathname;
+                _pathname = next.pathname;
+                _cur_fsize = 0;
+                if(_index)
+                {
+                    _index->open(_pathname);
+                }
+                _stats.onRoll();
+                _helper->retire(old_fd, old_pathname, _roll_cb);
+            }
+        }
+
+        //构造时与切换文件时在持有 _mutex 的写入线程中调用
+        std::string createNewFile(time_t cur_time)
+        {
+            //以时间来构造文件名拓展名
+            return cpplogs::util::File::rollName(_basename, cur_time, ++_name_count);
         }
     private:
         //通过基础文件名+扩展文件名（以时间生成）组成一个实际的当前输出文件名
+        std::mutex _mutex;
         std::string _basename;//基础文件名
-        std::ofstream _ofs;
+        std::string _pathname;//当前输出文件名
+        cpplogs::FdFile _file;
+        cpplogs::RollCallback _roll_cb;//滚动回调
+        std::unique_ptr<cpplogs::IndexWriter> _index;//稀疏索引，为空表示不写索引
         size_t _max_fsize;//记录最大大小，当前文件写入大小超过了这个大小就要切换文件
         size_t _cur_fsize;//记录当前文件已经写入的数据大小
         size_t _name_count;//名称计数器
+        size_t _prealloc;//为下一个文件预留的字节数
+        std::unique_ptr<cpplogs::RollHelper> _helper;//滚动辅助线程，最后构造，析构时先停止
     };
 
     enum class TimeGap
@@ -134,63 +794,131 @@ namespace cpplogs
     {
     public:
         //构造时传入文件名，打开文件，将文件句柄管理起来
-        RollSinkByTime(const std::string& basename, cpplogs::TimeGap gap_type)
+        RollSinkByTime(const std::string& basename, cpplogs::TimeGap gap_type, const cpplogs::FlushPolicy& policy = cpplogs::FlushPolicy())
         : _basename(basename)
+        , _file(policy)
+        , _period_fsize(0)
         {
             TimeGapToSeconds(gap_type);
-            _cur_gap = _gap_size == 1 ? cpplogs::util::Date::getTime() : cpplogs::util::Date::getTime() % _gap_size;//当前是第几个时间段
-
-            std::string pathname = createNewFile();
-            cpplogs::util::File::createDirectory(cpplogs::util::File::path(pathname));
-            _ofs.open(pathname, std::ios::binary | std::ios::app);//写入和追加
-            assert(_ofs.is_open());
+            init();
         }
 
-        RollSinkByTime(const std::string& basename, size_t gap_seconds)
+        RollSinkByTime(const std::string& basename, size_t gap_seconds, const cpplogs::FlushPolicy& policy = cpplogs::FlushPolicy())
         : _basename(basename)
-        , _gap_size(gap_seconds)
+        , _file(policy)
+        , _gap_size(gap_seconds == 0 ? 1 : gap_seconds)
+        , _period_fsize(0)
         {
-            _cur_gap = _gap_size == 1 ? cpplogs::util::Date::getTime() : cpplogs::util::Date::getTime() % _gap_size;//当前是第几个时间段
-
-            std::string pathname = createNewFile();
-            cpplogs::util::File::createDirectory(cpplogs::util::File::path(pathname));
-            _ofs.open(pathname, std::ios::binary | std::ios::app);//写入和追加
-            assert(_ofs.is_open());
+            init();
         }
 
-        //将日志消息写入到指定文件，进行时间判断，超过最大时间间隔则创建新文件
-        void log(const char* data, size_t len)
+        //将日志消息写入到指定文件，到达时间边界（由辅助线程判断）则切换文件
+        void log(const char* data, size_t len) override
+        {
+            log(data, len, cpplogs::LogLevel::value::UNKNOW);
+        }
+        void log(const char* data, size_t len, cpplogs::LogLevel::value level) override
         {
-            time_t cur = cpplogs::util::Date::getTime();
-            if(cur / _gap_size != _cur_gap)
+            std::unique_lock<std::mutex> lock(_mutex);
+            rollIfNeeded();
+            if(_index)
             {
-                std::string pathname = createNewFile();
-                _ofs.close();//关闭原来打开的文件
-                _cur_gap = cur / _gap_size;
-                _ofs.open(pathname, std::ios::binary | std::ios::app);//写入和追加
-                assert(_ofs.is_open());
+                _index->onWrite(len, level);
+            }
+            _file.write(data, len, level);
+            _period_fsize += len;
+        }
+        void log(const struct iovec* iov, size_t cnt) override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            rollIfNeeded();
+            size_t len = 0;
+            for(size_t i = 0; i < cnt; i++)
+            {
+                len += iov[i].iov_len;
+            }
+            if(_index)
+            {
+                _index->onWrite(len, cpplogs::LogLevel::value::UNKNOW);
+            }
+            _file.write(iov, cnt, cpplogs::LogLevel::value::UNKNOW);
+            _period_fsize += len;
+        }
+        void flush() override
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _file.flush();
+            if(_index)
+            {
+                _index->flush();
             }
-            _ofs.write(data, len);
-            assert(_ofs.good());
+        }
+
+        //设置滚动回调，需在开始记录日志之前调用
+        void setRollCallback(const cpplogs::RollCallback& cb)
+        {
+            _roll_cb = cb;
+        }
+        //滚动后旧文件关闭前是否 fdatasync（在辅助线程中进行）
+        void setSyncOnRoll(bool sync)
+        {
+            _helper->setSync(sync);
+        }
+        //为每个日志文件写入稀疏索引，需在开始记录日志之前调用
+        void enableIndex(size_t interval_bytes = 64 * 1024, size_t interval_ms = 1000)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _index.reset(new cpplogs::IndexWriter(interval_bytes, interval_ms));
+            _index->open(_pathname);
+        }
+        std::string name() const override
+        {
+            return "roll-time:" + _basename;
         }
 
     private:
-        std::string createNewFile()
-        {
-            //获取系统时间，以时间来构造文件名拓展名
-            time_t cur_time = cpplogs::util::Date::getTime();
-            struct tm st;
-            localtime_r(&cur_time, &st);
-            std::stringstream filename;
-            filename << _basename;
-            filename << st.tm_year + 1900;
-            filename << st.tm_mon + 1;
-            filename << st.tm_mday;
-            filename << st.tm_hour;
-            filename << st.tm_min;
-            filename << st.tm_sec;
-            filename << ".log";
-            return filename.str();
+        //第一个文件以当前时间命名，之后的文件以所在时间段的开始时间命名
+        void init()
+        {
+            _pathname = createNewFile(cpplogs::util::Date::getTime());
+            cpplogs::util::File::createDirectory(cpplogs::util::File::path(_pathname));
+            _file.setStats(&_stats);
+            _file.open(_pathname);
+            assert(_file.isOpen());
+            _helper.reset(new cpplogs::RollHelper(cpplogs::util::File::path(_pathname),
+                std::bind(&RollSinkByTime::createNewFile, this, std::placeholders::_1), _gap_size, 0));
+        }
+
+        //写入路径上只读取辅助线程设置的标志，不取时间；新文件按上一个时间段的写入量预留空间
+        void rollIfNeeded()
+        {
+            if(_helper->due())
+            {
+                cpplogs::RollHelper::NextFile next = _helper->take(_period_fsize < MAX_PREALLOC ? _period_fsize : MAX_PREALLOC);
+                if(next.fd < 0)
+                {
+                    _stats.onError();
+                    return;//无法打开新文件时继续写入当前文件，下一个时间边界再次尝试
+                }
+                int old_fd = _file.detach();
+                _file.attach(next.fd);
+                std::string old_pathname = _pathname;
+                _pathname = next.pathname;
+                _period_fsize = 0;
+                if(_index)
+                {
+                    _index->open(_pathname);
+                }
+                _stats.onRoll();
+                _helper->retire(old_fd, old_pathname, old_pathname != _pathname ? _roll_cb : cpplogs::RollCallback());
+            }
+        }
+
+        //在辅助线程中调用（构造时除外）
+        std::string createNewFile(time_t cur_time)
+        {
+            //以时间来构造文件名拓展名
+            return cpplogs::util::File::rollName(_basename, cur_time, 0);
         }
 
         void TimeGapToSeconds(cpplogs::TimeGap gap_type)
@@ -216,10 +944,16 @@ namespace cpplogs
         }
     private:
         //通过基础文件名+扩展文件名（以时间生成）组成一个实际的当前输出文件名
+        std::mutex _mutex;
         std::string _basename;//基础文件名
-        std::ofstream _ofs;
-        size_t _cur_gap; //当前是第几个时间段
+        std::string _pathname;//当前输出文件名
+        cpplogs::FdFile _file;
+        cpplogs::RollCallback _roll_cb;//滚动回调
+        std::unique_ptr<cpplogs::IndexWriter> _index;//稀疏索引，为空表示不写索引
         size_t _gap_size; //时间段的大小
+        size_t _period_fsize;//当前时间段已经写入的数据大小
+        std::unique_ptr<cpplogs::RollHelper> _helper;//滚动辅助线程，最后构造，析构时先停止
+        static const size_t MAX_PREALLOC = 64 * 1024 * 1024;//预留空间的上限
     };
 
     //简单工厂模式 - C++不定参宏函数
@@ -0,0 +1,454 @@
+#ifndef __LOGS_SOCKET_SINK_H__
+#define __LOGS_SOCKET_SINK_H__
+
+/*
+ * socket_sink.hpp 发送到本机收集进程的落地方向
+ * 1. SocketSink 支持 Unix 数据报（UNIX_DGRAM）、Unix 流（UNIX_STREAM）与 UDP（地址为 "127.0.0.1:端口"）
+ *    SinkFactory::create<SocketSink>(SocketType::UNIX_DGRAM, "/run/collector.sock")
+ * 2. 写入的数据作为记录放入内存中的待发送队列，由发送线程批量发送：
+ *    数据报每条记录一个报文，一次 sendmmsg 发送多个报文；流套接字一次 sendmsg（等同 writev）发送多条记录
+ * 3. 分帧（framed）：每次 log 调用的数据原样作为一条记录（不按换行符拆分，可以包含任意字节），前加 4 字节大端长度；
+ *    异步日志器一次落地一批日志，一批日志即一条记录
+ *    不分帧时数据按行拆分为记录（不含换行符），流套接字的记录以换行符分隔，数据报不带换行符；
+ *    二进制模式（Logger::enableBinary）的记录可能包含换行符，必须使用分帧
+ * 4. 连接断开或对端不存在时由发送线程按退避间隔重连，调用者不等待；期间记录保留在待发送队列中，
+ *    队列超过 backlog_bytes 时丢弃新的记录（计入统计的 dropped），发送线程手中还有一批正在发送的记录，最多占用 2 * backlog_bytes
+ * 5. 流套接字断开时正在发送的记录在新连接上从头重发，已写入旧连接但对端未读取的记录会丢失
+ * 6. 析构时发送剩余的记录，连接或发送失败时丢弃剩余记录后退出，不会无限等待
+*/
+
+#include "sink.hpp"
+#include <string>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <climits>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+namespace cpplogs
+{
+    #define SOCKET_SINK_BATCH 64//一次系统调用最多发送的记录数
+    #define SOCKET_SINK_RECONNECT_MIN_MS 50//重连退避的初始间隔
+    #define SOCKET_SINK_RECONNECT_MAX_MS 2000//重连退避的最大间隔
+    #define SOCKET_SINK_SEND_TIMEOUT_MS 1000//发送缓冲区满时单次发送的最长等待
+
+    enum class SocketType
+    {
+        UNIX_DGRAM,
+        UNIX_STREAM,
+        UDP
+    };
+
+    class SocketSink : public LogSink
+    {
+    public:
+        SocketSink(cpplogs::SocketType type, const std::string& address, bool framed = false, size_t backlog_bytes = 4 * 1024 * 1024)
+        : _type(type)
+        , _address(address)
+        , _framed(framed)
+        , _backlog_bytes(backlog_bytes)
+        , _addr_len(0)
+        , _fd(-1)
+        , _sending(std::min<size_t>(backlog_bytes, DEFAULT_BUFFER_SIZE))
+        , _send_pos(0)
+        , _partial(0)
+        , _reported(false)
+        , _stop(false)
+        , _pending(std::min<size_t>(backlog_bytes, DEFAULT_BUFFER_SIZE))
+        {
+            memset(&_addr, 0, sizeof(_addr));
+            bool ok = parseAddress();
+            assert(ok);
+            _thread = std::thread(&SocketSink::threadEntry, this);
+        }
+        ~SocketSink()
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _stop = true;
+            }
+            _cond.notify_all();
+            _thread.join();
+            closeSocket();
+        }
+
+        void log(const char* data, size_t len) override
+        {
+            const char* end = data + len;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if(_framed)
+                {
+                    append(data, len);
+                    data = end;
+                }
+                while(data < end)
+                {
+                    const char* nl = static_cast<const char*>(memchr(data, '\n', end - data));
+                    const char* line_end = nl == nullptr ? end : nl;
+                    append(data, line_end - data);
+                    data = nl == nullptr ? end : nl + 1;
+                }
+                _stats.setQueued(_pending.readAbleSize());
+            }
+            _cond.notify_one();
+        }
+        //不等待发送，避免调用者被收集进程阻塞
+        void flush() override {}
+        std::string name() const override
+        {
+            return "socket:" + _address;
+        }
+
+    private:
+        enum class SendResult
+        {
+            DONE,//当前批次已全部发送
+            RETRY,//暂时无法发送（对端接收缓冲区满），保持连接稍后重试
+            DISCONNECTED//连接已失效，重连后继续发送
+        };
+
+        //记录格式：4 字节本机字节序长度 + 数据，调用者持有 _mutex
+        void append(const char* data, size_t len)
+        {
+            if(len == 0)
+            {
+                return;
+            }
+            if(_pending.readAbleSize() + sizeof(uint32_t) + len > _backlog_bytes)
+            {
+                _stats.onDrop();
+                return;
+            }
+            uint32_t n = static_cast<uint32_t>(len);
+            _pending.push(reinterpret_cast<const char*>(&n), sizeof(n));
+            _pending.push(data, len);
+        }
+
+        bool parseAddress()
+        {
+            if(_type == cpplogs::SocketType::UDP)
+            {
+                struct sockaddr_in* in = reinterpret_cast<struct sockaddr_in*>(&_addr);
+                size_t pos = _address.rfind(':');
+                if(pos == std::string::npos || inet_pton(AF_INET, _address.substr(0, pos).c_str(), &in->sin_addr) != 1)
+                {
+                    std::cerr << "[ERROR]cpplogs::SocketSink::parseAddress::invalid address " << _address << std::endl;
+                    return false;
+                }
+                in->sin_family = AF_INET;
+                in->sin_port = htons(static_cast<uint16_t>(atoi(_address.c_str() + pos + 1)));
+                _addr_len = sizeof(struct sockaddr_in);
+                return true;
+            }
+            struct sockaddr_un* un = reinterpret_cast<struct sockaddr_un*>(&_addr);
+            if(_address.empty() || _address.size() >= sizeof(un->sun_path))
+            {
+                std::cerr << "[ERROR]cpplogs::SocketSink::parseAddress::invalid path " << _address << std::endl;
+                return false;
+            }
+            un->sun_family = AF_UNIX;
+            memcpy(un->sun_path, _address.c_str(), _address.size() + 1);
+            _addr_len = sizeof(struct sockaddr_un);
+            return true;
+        }
+
+        bool connectSocket()
+        {
+            int domain = _type == cpplogs::SocketType::UDP ? AF_INET : AF_UNIX;
+            int type = _type == cpplogs::SocketType::UNIX_STREAM ? SOCK_STREAM : SOCK_DGRAM;
+            _fd = socket(domain, type | SOCK_CLOEXEC, 0);
+            if(_fd < 0)
+            {
+                report("socket");
+                return false;
+            }
+            struct timeval tv;
+            tv.tv_sec = SOCKET_SINK_SEND_TIMEOUT_MS / 1000;
+            tv.tv_usec = SOCKET_SINK_SEND_TIMEOUT_MS % 1000 * 1000;
+            setsockopt(_fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+            if(connect(_fd, reinterpret_cast<struct sockaddr*>(&_addr), _addr_len) < 0)
+            {
+                report("connect");
+                closeSocket();
+                return false;
+            }
+            _partial = 0;
+            return true;
+        }
+        void closeSocket()
+        {
+            if(_fd >= 0)
+            {
+                ::close(_fd);
+                _fd = -1;
+            }
+        }
+        //对端不可用时只输出一次，发送成功后恢复
+        void report(const char* what)
+        {
+            if(!_reported)
+            {
+                std::cerr << "[ERROR]cpplogs::SocketSink::" << what << " " << _address << ": " << strerror(errno) << std::endl;
+                _reported = true;
+            }
+        }
+
+        static bool disconnected(int err)
+        {
+            return err == ECONNREFUSED || err == ENOTCONN || err == EPIPE || err == ECONNRESET
+                || err == ENOENT || err == EDESTADDRREQ || err == EBADF;
+        }
+
+        //_sending 中 pos 处的记录
+        void record(size_t pos, const char*& data, uint32_t& len) const
+        {
+            memcpy(&len, _sending.begin() + pos, sizeof(len));
+            data = _sending.begin() + pos + sizeof(len);
+        }
+
+        //数据报：每条记录一个报文，一次 sendmmsg 最多 SOCKET_SINK_BATCH 个
+        SendResult sendDatagrams()
+        {
+            struct mmsghdr msgs[SOCKET_SINK_BATCH];
+            struct iovec iov[SOCKET_SINK_BATCH][2];
+            uint32_t headers[SOCKET_SINK_BATCH];
+            while(_send_pos < _sending.readAbleSize())
+            {
+                size_t cnt = 0;
+                size_t pos = _send_pos;
+                while(cnt < SOCKET_SINK_BATCH && pos < _sending.readAbleSize())
+                {
+                    const char* data;
+                    uint32_t len;
+                    record(pos, data, len);
+                    size_t n = 0;
+                    if(_framed)
+                    {
+                        headers[cnt] = htonl(len);
+                        iov[cnt][n].iov_base = &headers[cnt];
+                        iov[cnt][n++].iov_len = sizeof(uint32_t);
+                    }
+                    iov[cnt][n].iov_base = const_cast<char*>(data);
+                    iov[cnt][n++].iov_len = len;
+                    memset(&msgs[cnt], 0, sizeof(msgs[cnt]));
+                    msgs[cnt].msg_hdr.msg_iov = iov[cnt];
+                    msgs[cnt].msg_hdr.msg_iovlen = n;
+                    pos += sizeof(uint32_t) + len;
+                    cnt++;
+                }
+                int ret = sendmmsg(_fd, msgs, cnt, 0);
+                if(ret < 0)
+                {
+                    if(errno == EINTR)
+                    {
+                        continue;
+                    }
+                    if(errno == EMSGSIZE)
+                    {
+                        //超过报文长度上限的记录无法发送，丢弃
+                        const char* data;
+                        uint32_t len;
+                        record(_send_pos, data, len);
+                        _send_pos += sizeof(uint32_t) + len;
+                        _stats.onError();
+                        continue;
+                    }
+                    _stats.onError();
+                    if(disconnected(errno))
+                    {
+                        report("sendmmsg");
+                        return SendResult::DISCONNECTED;
+                    }
+                    return SendResult::RETRY;
+                }
+                for(int i = 0; i < ret; i++)
+                {
+                    const char* data;
+                    uint32_t len;
+                    record(_send_pos, data, len);
+                    _send_pos += sizeof(uint32_t) + len;
+                }
+            }
+            return SendResult::DONE;
+        }
+
+        //流：一次 sendmsg 发送多条记录，_partial 为当前记录已发送的字节数（含长度或换行符）
+        SendResult sendStream()
+        {
+            static const char newline = '\n';
+            struct iovec iov[SOCKET_SINK_BATCH * 2];
+            uint32_t headers[SOCKET_SINK_BATCH];
+            while(_send_pos < _sending.readAbleSize())
+            {
+                size_t cnt = 0;
+                size_t records = 0;
+                size_t pos = _send_pos;
+                size_t skip = _partial;
+                while(records < SOCKET_SINK_BATCH && pos < _sending.readAbleSize())
+                {
+                    const char* data;
+                    uint32_t len;
+                    record(pos, data, len);
+                    struct iovec parts[2];
+                    size_t n = 0;
+                    if(_framed)
+                    {
+                        headers[records] = htonl(len);
+                        parts[n].iov_base = &headers[records];
+                        parts[n++].iov_len = sizeof(uint32_t);
+                        parts[n].iov_base = const_cast<char*>(data);
+                        parts[n++].iov_len = len;
+                    }
+                    else
+                    {
+                        parts[n].iov_base = const_cast<char*>(data);
+                        parts[n++].iov_len = len;
+                        parts[n].iov_base = const_cast<char*>(&newline);
+                        parts[n++].iov_len = 1;
+                    }
+                    //跳过第一条记录已发送的部分
+                    for(size_t i = 0; i < n; i++)
+                    {
+                        if(skip >= parts[i].iov_len)
+                        {
+                            skip -= parts[i].iov_len;
+                            continue;
+                        }
+                        iov[cnt].iov_base = static_cast<char*>(parts[i].iov_base) + skip;
+                        iov[cnt++].iov_len = parts[i].iov_len - skip;
+                        skip = 0;
+                    }
+                    pos += sizeof(uint32_t) + len;
+                    records++;
+                }
+                struct msghdr msg;
+                memset(&msg, 0, sizeof(msg));
+                msg.msg_iov = iov;
+                msg.msg_iovlen = cnt;
+                ssize_t ret = sendmsg(_fd, &msg, MSG_NOSIGNAL);
+                if(ret < 0)
+                {
+                    if(errno == EINTR)
+                    {
+                        continue;
+                    }
+                    _stats.onError();
+                    if(errno == EAGAIN || errno == EWOULDBLOCK)
+                    {
+                        return SendResult::RETRY;
+                    }
+                    report("sendmsg");
+                    return SendResult::DISCONNECTED;
+                }
+                //按已发送的字节数前进
+                size_t sent = ret;
+                while(sent > 0)
+                {
+                    const char* data;
+                    uint32_t len;
+                    record(_send_pos, data, len);
+                    size_t wire = (_framed ? sizeof(uint32_t) : 1) + len;
+                    size_t rest = wire - _partial;
+                    if(sent < rest)
+                    {
+                        _partial += sent;
+                        break;
+                    }
+                    sent -= rest;
+                    _partial = 0;
+                    _send_pos += sizeof(uint32_t) + len;
+                }
+            }
+            return SendResult::DONE;
+        }
+
+        void threadEntry()
+        {
+            size_t backoff_ms = SOCKET_SINK_RECONNECT_MIN_MS;
+            while(true)
+            {
+                if(_send_pos == _sending.readAbleSize())
+                {
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _cond.wait(lock, [&](){ return _stop || !_pending.empty(); });
+                    if(_pending.empty())
+                    {
+                        break;//已停止且没有剩余的记录
+                    }
+                    _sending.reset();
+                    _sending.swap(_pending);
+                    _send_pos = 0;
+                    _partial = 0;
+                    _stats.setQueued(0);
+                }
+                SendResult result = SendResult::DISCONNECTED;
+                if(_fd >= 0 || connectSocket())
+                {
+                    result = _type == cpplogs::SocketType::UNIX_STREAM ? sendStream() : sendDatagrams();
+                }
+                if(result == SendResult::DONE)
+                {
+                    _reported = false;
+                    backoff_ms = SOCKET_SINK_RECONNECT_MIN_MS;
+                    continue;
+                }
+                if(result == SendResult::DISCONNECTED)
+                {
+                    closeSocket();
+                }
+                std::unique_lock<std::mutex> lock(_mutex);
+                if(_stop)
+                {
+                    //停止时不再重试，丢弃剩余的记录
+                    discard(_sending, _send_pos);
+                    discard(_pending, 0);
+                    _pending.reset();
+                    break;
+                }
+                _cond.wait_for(lock, std::chrono::milliseconds(backoff_ms), [&](){ return _stop; });
+                backoff_ms = std::min<size_t>(backoff_ms * 2, SOCKET_SINK_RECONNECT_MAX_MS);
+            }
+        }
+
+        //统计 buf 中 pos 之后被丢弃的记录
+        void discard(const cpplogs::Buffer& buf, size_t pos)
+        {
+            while(pos < buf.readAbleSize())
+            {
+                uint32_t len;
+                memcpy(&len, buf.begin() + pos, sizeof(len));
+                pos += sizeof(uint32_t) + len;
+                _stats.onDrop();
+            }
+        }
+
+    private:
+        cpplogs::SocketType _type;
+        std::string _address;
+        bool _framed;
+        size_t _backlog_bytes;
+        struct sockaddr_storage _addr;
+        socklen_t _addr_len;
+        int _fd;//只由发送线程使用
+        cpplogs::Buffer _sending;//发送线程正在发送的批次
+        size_t _send_pos;//_sending 中下一条待发送记录的位置
+        size_t _partial;//流套接字：当前记录已发送的字节数
+        bool _reported;//已输出连接错误
+        std::mutex _mutex;
+        std::condition_variable _cond;
+        bool _stop;
+        cpplogs::Buffer _pending;//待发送队列，受 _mutex 保护
+        std::thread _thread;//最后初始化
+    };
+}
+
+#endif
@@ -0,0 +1,359 @@
+#ifndef __LOGS_STATIC_FMT_H__
+#define __LOGS_STATIC_FMT_H__
+
+/*
+ * static_format.hpp 编译期特化的格式化器
+ * 1. 在编译期将格式化规则字符串解析为固定的格式化子项类型列表
+ * 2. 相邻的原始字符（包括 %%、%T、%n）合并为一个字面量，输出时一次写入
+ * 3. 子项均为静态函数，没有堆上的子项对象，也没有逐项的虚函数调用
+ * 4. 派生自 Formmatter，日志器可以直接替换使用；动态规则仍使用运行时解析的 Formmatter
+ *
+ * 使用方式:
+ *   cpplogs::Formmatter::ptr fmt =
+ *       std::make_shared<CPPLOGS_STATIC_FORMMATTER("[%d{%H:%M:%S}][%t][%c][%f:%l][%p]%T%m%n")>();
+ * 规则字符串最长 128 个字符，未知的格式化字符在编译期报错
+*/
+
+#include "format.hpp"
+#include <ctime>
+
+namespace cpplogs
+{
+    namespace detail
+    {
+        template<char... Cs>
+        struct chars
+        {
+            static const char value[sizeof...(Cs) + 1];
+            static constexpr size_t size = sizeof...(Cs);
+        };
+        template<char... Cs>
+        const char chars<Cs...>::value[sizeof...(Cs) + 1] = { Cs..., '\0' };
+
+        template<typename... Items>
+        struct items {};
+
+        //截取字符列表的前 N 个字符（去掉字符串结尾的 '\0' 及填充字符）
+        template<bool Done, size_t N, typename Acc, char... Cs>
+        struct TakeImpl
+        {
+            using type = Acc;
+        };
+        template<size_t N, char... As, char C, char... Cs>
+        struct TakeImpl<false, N, chars<As...>, C, Cs...>
+        {
+            using type = typename TakeImpl<N == 1, N - 1, chars<As..., C>, Cs...>::type;
+        };
+        template<size_t N, typename Acc, char... Cs>
+        struct Take
+        {
+            using type = typename TakeImpl<N == 0, N, Acc, Cs...>::type;
+        };
+
+        template<size_t Size, char... Cs>
+        struct PatternChars
+        {
+            static_assert(Size <= sizeof...(Cs) + 1, "cpplogs: 格式化规则字符串过长(最长128个字符).");
+            using type = typename Take<Size - 1, chars<>, Cs...>::type;
+        };
+    }
+
+    //编译期格式化子项 -- 字面量，消息，等级，时间，文件名，行号，线程ID，日志器名
+    template<char... Cs>
+    struct StaticLiteralItem
+    {
+        static void format(std::ostream& out, const cpplogs::LogMsg&)
+        {
+            out.write(cpplogs::detail::chars<Cs...>::value, sizeof...(Cs));
+        }
+        static void format(cpplogs::Buffer& out, const cpplogs::LogMsg&)
+        {
+            out.push(cpplogs::detail::chars<Cs...>::value, sizeof...(Cs));
+        }
+    };
+
+    struct StaticMsgItem
+    {
+        static void format(std::ostream& out, const cpplogs::LogMsg& msg)
+        {
+            out.write(msg._payload, msg._payload_len);
+        }
+        static void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg)
+        {
+            out.push(msg._payload, msg._payload_len);
+        }
+    };
+
+    struct StaticLevelItem
+    {
+        static void format(std::ostream& out, const cpplogs::LogMsg& msg)
+        {
+            out << cpplogs::LogLevel::toString(msg._level);
+        }
+        static void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg)
+        {
+            const char* level = cpplogs::LogLevel::toString(msg._level);
+            out.push(level, strlen(level));
+        }
+    };
+
+    template<char... Cs>
+    struct StaticTimeItem
+    {
+        static void format(std::ostream& out, const cpplogs::LogMsg& msg)
+        {
+            char tmp[cpplogs::TimeRender::MAX_TIME_SIZE];
+            out.write(tmp, render().render(tmp, msg._ctime, msg._nsec));
+        }
+        static void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg)
+        {
+            out.ensureEnoughSize(cpplogs::TimeRender::MAX_TIME_SIZE);
+            out.moveWriter(render().render(out.writeBegin(), msg._ctime, msg._nsec));
+        }
+        static const cpplogs::TimeRender& render()
+        {
+            static const cpplogs::TimeRender time_render(cpplogs::detail::chars<Cs...>::value);
+            return time_render;
+        }
+    };
+
+    struct StaticFileItem
+    {
+        static void format(std::ostream& out, const cpplogs::LogMsg& msg)
+        {
+            out << msg._file;
+        }
+        static void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg)
+        {
+            out.push(msg._file, strlen(msg._file));
+        }
+    };
+
+    struct StaticLineItem
+    {
+        static void format(std::ostream& out, const cpplogs::LogMsg& msg)
+        {
+            out << msg._line;
+        }
+        static void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg)
+        {
+            out.ensureEnoughSize(20);
+            out.moveWriter(cpplogs::util::Number::toChars(out.writeBegin(), static_cast<uint64_t>(msg._line)));
+        }
+    };
+
+    struct StaticThreadItem
+    {
+        static void format(std::ostream& out, const cpplogs::LogMsg& msg)
+        {
+            out << msg._tid;
+        }
+        static void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg)
+        {
+            out.ensureEnoughSize(20);
+            out.moveWriter(cpplogs::util::Number::toChars(out.writeBegin(), msg._tid));
+        }
+    };
+
+    struct StaticLoggerItem
+    {
+        static void format(std::ostream& out, const cpplogs::LogMsg& msg)
+        {
+            out << msg._logger;
+        }
+        static void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg)
+        {
+            out.push(msg._logger, strlen(msg._logger));
+        }
+    };
+
+    namespace detail
+    {
+        template<typename T>
+        struct always_false
+        {
+            static constexpr bool value = false;
+        };
+
+        //格式化字符 -> 格式化子项，Sub 为 {} 中的子格式
+        template<char Key, typename Sub>
+        struct KeyItem
+        {
+            static_assert(always_false<Sub>::value, "cpplogs: 没有对应的格式化字符.");
+            using type = void;
+        };
+        template<char... Ss>
+        struct KeyItem<'d', chars<Ss...>> { using type = StaticTimeItem<Ss...>; };
+        template<>
+        struct KeyItem<'d', chars<>> { using type = StaticTimeItem<'%', 'H', ':', '%', 'M', ':', '%', 'S'>; };
+        template<typename Sub> struct KeyItem<'t', Sub> { using type = StaticThreadItem; };
+        template<typename Sub> struct KeyItem<'c', Sub> { using type = StaticLoggerItem; };
+        template<typename Sub> struct KeyItem<'f', Sub> { using type = StaticFileItem; };
+        template<typename Sub> struct KeyItem<'l', Sub> { using type = StaticLineItem; };
+        template<typename Sub> struct KeyItem<'p', Sub> { using type = StaticLevelItem; };
+        template<typename Sub> struct KeyItem<'m', Sub> { using type = StaticMsgItem; };
+
+        //将未输出的字面量追加到子项列表
+        template<typename Items, typename Lit>
+        struct FlushLiteral;
+        template<typename... Is>
+        struct FlushLiteral<items<Is...>, chars<>>
+        {
+            using type = items<Is...>;
+        };
+        template<typename... Is, char... Ls>
+        struct FlushLiteral<items<Is...>, chars<Ls...>>
+        {
+            using type = items<Is..., StaticLiteralItem<Ls...>>;
+        };
+
+        template<typename Items, typename Item>
+        struct AppendItem;
+        template<typename... Is, typename Item>
+        struct AppendItem<items<Is...>, Item>
+        {
+            using type = items<Is..., Item>;
+        };
+
+        //处理一个格式化字符：%T、%n 并入字面量，其余先输出字面量再追加对应子项
+        template<typename Items, typename Lit, char Key, typename Sub>
+        struct Emit
+        {
+            using type = typename AppendItem<typename FlushLiteral<Items, Lit>::type, typename KeyItem<Key, Sub>::type>::type;
+            using literal = chars<>;
+        };
+        template<typename Items, char... Ls, typename Sub>
+        struct Emit<Items, chars<Ls...>, 'T', Sub>
+        {
+            using type = Items;
+            using literal = chars<Ls..., '\t'>;
+        };
+        template<typename Items, char... Ls, typename Sub>
+        struct Emit<Items, chars<Ls...>, 'n', Sub>
+        {
+            using type = Items;
+            using literal = chars<Ls..., '\n'>;
+        };
+
+        //读取 {} 中的子格式，Rest 为 '}' 之后的剩余字符
+        template<typename Sub, typename Input>
+        struct ReadSub
+        {
+            static_assert(always_false<Input>::value, "cpplogs: 子格式{}匹配出错.");
+            using sub = chars<>;
+            using rest = chars<>;
+        };
+        template<char... Ss, char... Rest>
+        struct ReadSub<chars<Ss...>, chars<'}', Rest...>>
+        {
+            using sub = chars<Ss...>;
+            using rest = chars<Rest...>;
+        };
+        template<char... Ss, char C, char... Rest>
+        struct ReadSub<chars<Ss...>, chars<C, Rest...>>
+        {
+            using inner = ReadSub<chars<Ss..., C>, chars<Rest...>>;
+            using sub = typename inner::sub;
+            using rest = typename inner::rest;
+        };
+
+        //格式化字符及其可选的子格式
+        template<typename Input>
+        struct ReadKey
+        {
+            using sub = chars<>;
+            using rest = Input;
+        };
+        template<char... Rest>
+        struct ReadKey<chars<'{', Rest...>>
+        {
+            using sub = typename ReadSub<chars<>, chars<Rest...>>::sub;
+            using rest = typename ReadSub<chars<>, chars<Rest...>>::rest;
+        };
+
+        //规则字符串解析：Items 为已解析的子项，Lit 为尚未输出的字面量，Input 为剩余字符
+        template<typename Items, typename Lit, typename Input>
+        struct Parse;
+        template<typename Items, typename Lit>
+        struct Parse<Items, Lit, chars<>>
+        {
+            using type = typename FlushLiteral<Items, Lit>::type;
+        };
+        template<typename Items, char... Ls, char C, char... Rest>
+        struct Parse<Items, chars<Ls...>, chars<C, Rest...>>
+        {
+            using type = typename Parse<Items, chars<Ls..., C>, chars<Rest...>>::type;
+        };
+        template<typename Items, char... Ls>
+        struct Parse<Items, chars<Ls...>, chars<'%'>>
+        {
+            static_assert(always_false<Items>::value, "cpplogs: 未匹配的%.");
+            using type = Items;
+        };
+        //%% 为 '%'（类似转义字符）
+        template<typename Items, char... Ls, char... Rest>
+        struct Parse<Items, chars<Ls...>, chars<'%', '%', Rest...>>
+        {
+            using type = typename Parse<Items, chars<Ls..., '%'>, chars<Rest...>>::type;
+        };
+        template<typename Items, char... Ls, char Key, char... Rest>
+        struct Parse<Items, chars<Ls...>, chars<'%', Key, Rest...>>
+        {
+            using key = ReadKey<chars<Rest...>>;
+            using emit = Emit<Items, chars<Ls...>, Key, typename key::sub>;
+            using type = typename Parse<typename emit::type, typename emit::literal, typename key::rest>::type;
+        };
+    }
+
+    //编译期特化的格式化器，Pattern 为规则字符串对应的字符列表
+    template<typename Pattern>
+    class StaticFormmatter;
+
+    template<char... Cs>
+    class StaticFormmatter<cpplogs::detail::chars<Cs...>> : public cpplogs::Formmatter
+    {
+    public:
+        using pattern_type = cpplogs::detail::chars<Cs...>;
+        using items_type = typename cpplogs::detail::Parse<cpplogs::detail::items<>, cpplogs::detail::chars<>, pattern_type>::type;
+
+        StaticFormmatter()
+        : cpplogs::Formmatter(pattern_type::value, cpplogs::Formmatter::NoParse())
+        {}
+
+        using cpplogs::Formmatter::format;
+        void format(std::ostream& out, const cpplogs::LogMsg& msg) override
+        {
+            formatItems(out, msg, items_type());
+        }
+        void format(cpplogs::Buffer& out, const cpplogs::LogMsg& msg) override
+        {
+            formatItems(out, msg, items_type());
+        }
+
+    private:
+        template<typename Out, typename... Is>
+        static void formatItems(Out& out, const cpplogs::LogMsg& msg, cpplogs::detail::items<Is...>)
+        {
+            int expand[] = { 0, (Is::format(out, msg), 0)... };
+            (void)expand;
+        }
+    };
+}
+
+//将字符串字面量展开为字符列表
+#define CPPLOGS_PATTERN_CHAR(s, i) ((i) < sizeof(s) ? (s)[(i) < sizeof(s) ? (i) : 0] : '\0')
+#define CPPLOGS_PATTERN_CHAR8(s, i) \
+    CPPLOGS_PATTERN_CHAR(s, i + 0), CPPLOGS_PATTERN_CHAR(s, i + 1), CPPLOGS_PATTERN_CHAR(s, i + 2), CPPLOGS_PATTERN_CHAR(s, i + 3), \
+    CPPLOGS_PATTERN_CHAR(s, i + 4), CPPLOGS_PATTERN_CHAR(s, i + 5), CPPLOGS_PATTERN_CHAR(s, i + 6), CPPLOGS_PATTERN_CHAR(s, i + 7)
+#define CPPLOGS_PATTERN_CHAR64(s, i) \
+    CPPLOGS_PATTERN_CHAR8(s, i + 0), CPPLOGS_PATTERN_CHAR8(s, i + 8), CPPLOGS_PATTERN_CHAR8(s, i + 16), CPPLOGS_PATTERN_CHAR8(s, i + 24), \
+    CPPLOGS_PATTERN_CHAR8(s, i + 32), CPPLOGS_PATTERN_CHAR8(s, i + 40), CPPLOGS_PATTERN_CHAR8(s, i + 48), CPPLOGS_PATTERN_CHAR8(s, i + 56)
+
+//字符串字面量 -> cpplogs::detail::chars<...>
+#define CPPLOGS_PATTERN(s) \
+    cpplogs::detail::PatternChars<sizeof(s), CPPLOGS_PATTERN_CHAR64(s, 0), CPPLOGS_PATTERN_CHAR64(s, 64)>::type
+
+//字符串字面量 -> 编译期特化的格式化器类型
+#define CPPLOGS_STATIC_FORMMATTER(s) cpplogs::StaticFormmatter<CPPLOGS_PATTERN(s)>
+
+#endif
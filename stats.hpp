@@ -0,0 +1,371 @@
+#ifndef __LOGS_STATS_H__
+#define __LOGS_STATS_H__
+
+/*
+ * stats.hpp 运行时统计
+ * 1. 计数器按线程分散到 16 个缓存行对齐的槽位（条带），线程独占槽位时写入不需要原子读-改-写指令，读取时汇总
+ *    槽位用 posix_memalign 单独分配（C++11 的 new 不保证超过 16 字节的对齐），每个日志器约 2KB、每个落地方向约 1KB
+ * 2. 日志器统计：各等级接受与被过滤的日志条数
+ *    被过滤的条数只在编译时定义 CPPLOGS_STATS_FILTERED=1（且统计开启）时统计，与 CPPLOGS_STATS 的取值无关；
+ *    默认不统计，被过滤的调用不访问线程私有变量、不更新计数器
+ * 3. 落地方向统计：落地次数、字节数、写入失败次数、滚动次数、落地耗时直方图，
+ *    带独立队列的落地方向（AsyncSink）另有丢弃条数、溢出到磁盘的字节数与当前排队的字节数
+ *    耗时按 1/CPPLOGS_STATS_SAMPLE 抽样，直方图按 2 的幂分桶（单位 ns）
+ * 4. stats() 返回快照，可转换为文本；StatsDumper（logger.hpp）定期将快照写入指定落地方向
+ * 5. 编译时定义 CPPLOGS_STATS=0 关闭统计，所有统计接口为空函数，没有任何开销
+*/
+
+#include "level.hpp"
+#include <atomic>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+
+#ifndef CPPLOGS_STATS
+#define CPPLOGS_STATS 1
+#endif
+#ifndef CPPLOGS_STATS_FILTERED
+#define CPPLOGS_STATS_FILTERED 0
+#endif
+
+namespace cpplogs
+{
+    #define CPPLOGS_STATS_STRIPES 16//计数器条带数（不超过 64）
+    #define CPPLOGS_STATS_BUCKETS 32//耗时直方图桶数，第 i 个桶为 [2^i, 2^(i+1)) ns
+    #define CPPLOGS_STATS_SAMPLE 32//耗时抽样间隔，必须是 2 的幂
+    #define CPPLOGS_STATS_LEVELS 7//日志等级数（UNKNOW ~ OFF）
+
+    //落地方向统计快照
+    struct SinkStatsSnapshot
+    {
+        std::string name;
+        uint64_t records;//落地调用次数（异步日志器一次落地整块数据）
+        uint64_t bytes;//落地字节数
+        uint64_t errors;//写入失败次数
+        uint64_t rolls;//滚动次数
+        uint64_t dropped;//队列满被丢弃的日志条数
+        uint64_t spilled;//队列满溢出到磁盘的字节数
+        uint64_t queued;//队列中等待写出的字节数
+        uint64_t latency[CPPLOGS_STATS_BUCKETS];//落地耗时直方图（抽样）
+
+        //耗时分位数的上界（ns），没有样本时返回 0
+        uint64_t latencyPercentile(double q) const
+        {
+            uint64_t total = 0;
+            for(size_t i = 0; i < CPPLOGS_STATS_BUCKETS; i++)
+            {
+                total += latency[i];
+            }
+            if(total == 0)
+            {
+                return 0;
+            }
+            uint64_t target = static_cast<uint64_t>(q * total);
+            uint64_t sum = 0;
+            for(size_t i = 0; i < CPPLOGS_STATS_BUCKETS; i++)
+            {
+                sum += latency[i];
+                if(sum > target)
+                {
+                    return static_cast<uint64_t>(1) << (i + 1);
+                }
+            }
+            return static_cast<uint64_t>(1) << CPPLOGS_STATS_BUCKETS;
+        }
+    };
+
+    //日志器统计快照
+    struct LoggerStatsSnapshot
+    {
+        std::string name;
+        uint64_t accepted[CPPLOGS_STATS_LEVELS];//各等级输出的日志条数
+        uint64_t filtered[CPPLOGS_STATS_LEVELS];//各等级因等级不足被过滤的日志条数
+        std::vector<cpplogs::SinkStatsSnapshot> sinks;
+
+        //转换为文本，每个日志器一行，每个落地方向一行
+        std::string toString() const
+        {
+            std::ostringstream out;
+            time_t now = time(nullptr);
+            struct tm st;
+            localtime_r(&now, &st);
+            char date[32];
+            strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &st);
+            out << "[" << date << "][STATS][" << name << "] accepted:";
+            for(int i = static_cast<int>(cpplogs::LogLevel::value::DEBUG); i < static_cast<int>(cpplogs::LogLevel::value::OFF); i++)
+            {
+                out << " " << cpplogs::LogLevel::toString(static_cast<cpplogs::LogLevel::value>(i)) << "=" << accepted[i];
+            }
+            out << " filtered:";
+            for(int i = static_cast<int>(cpplogs::LogLevel::value::DEBUG); i < static_cast<int>(cpplogs::LogLevel::value::OFF); i++)
+            {
+                out << " " << cpplogs::LogLevel::toString(static_cast<cpplogs::LogLevel::value>(i)) << "=" << filtered[i];
+            }
+            out << "\n";
+            for(auto& sink : sinks)
+            {
+                out << "[" << date << "][STATS][" << name << "] sink=" << sink.name
+                    << " records=" << sink.records << " bytes=" << sink.bytes
+                    << " errors=" << sink.errors << " rolls=" << sink.rolls
+                    << " dropped=" << sink.dropped << " spilled=" << sink.spilled << " queued=" << sink.queued
+                    << " p50<=" << sink.latencyPercentile(0.5) << "ns"
+                    << " p99<=" << sink.latencyPercentile(0.99) << "ns"
+                    << " p999<=" << sink.latencyPercentile(0.999) << "ns\n";
+            }
+            return out.str();
+        }
+    };
+
+#if CPPLOGS_STATS
+    namespace detail
+    {
+        //线程独占的计数器槽位：前 CPPLOGS_STATS_STRIPES - 1 个槽位由存活的线程独占，线程退出时归还
+        //独占槽位只有一个写者，用普通的读-加-写更新，不需要带锁前缀的原子指令
+        //槽位用完后其余线程共用最后一个槽位，退化为原子加
+        class ThreadSlot
+        {
+        public:
+            static const size_t SHARED = CPPLOGS_STATS_STRIPES - 1;
+            ThreadSlot()
+            : _index(acquire())
+            {}
+            ~ThreadSlot()
+            {
+                if(_index != SHARED)
+                {
+                    used().fetch_and(~(static_cast<uint64_t>(1) << _index), std::memory_order_release);
+                }
+            }
+            static size_t index()
+            {
+                static thread_local ThreadSlot slot;
+                return slot._index;
+            }
+        private:
+            static std::atomic<uint64_t>& used()
+            {
+                static std::atomic<uint64_t> bits(0);
+                return bits;
+            }
+            static size_t acquire()
+            {
+                uint64_t bits = used().load(std::memory_order_relaxed);
+                for(;;)
+                {
+                    size_t i = 0;
+                    while(i < SHARED && (bits & (static_cast<uint64_t>(1) << i)))
+                    {
+                        i++;
+                    }
+                    if(i == SHARED)
+                    {
+                        return SHARED;
+                    }
+                    if(used().compare_exchange_weak(bits, bits | (static_cast<uint64_t>(1) << i), std::memory_order_acquire))
+                    {
+                        return i;
+                    }
+                }
+            }
+            size_t _index;
+        };
+    }
+
+    //条带计数器组：每个槽位（缓存行对齐）保存 N 个计数器，同一线程的计数集中在一个槽位中
+    template<size_t N>
+    class StripedCounters
+    {
+    public:
+        StripedCounters()
+        : _values(nullptr)
+        {
+            void* mem = nullptr;
+            if(posix_memalign(&mem, 64, CPPLOGS_STATS_STRIPES * STRIDE * sizeof(std::atomic<uint64_t>)) != 0)
+            {
+                throw std::bad_alloc();
+            }
+            _values = static_cast<std::atomic<uint64_t>*>(mem);
+            for(size_t i = 0; i < CPPLOGS_STATS_STRIPES * STRIDE; i++)
+            {
+                new (&_values[i]) std::atomic<uint64_t>(0);
+            }
+        }
+        ~StripedCounters()
+        {
+            free(_values);
+        }
+        StripedCounters(const StripedCounters&) = delete;
+        StripedCounters& operator=(const StripedCounters&) = delete;
+
+        void add(size_t i, uint64_t n = 1)
+        {
+            size_t index = cpplogs::detail::ThreadSlot::index();
+            std::atomic<uint64_t>& value = _values[index * STRIDE + i];
+            if(index != cpplogs::detail::ThreadSlot::SHARED)
+            {
+                value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+            }
+            else
+            {
+                value.fetch_add(n, std::memory_order_relaxed);
+            }
+        }
+        uint64_t load(size_t i) const
+        {
+            uint64_t sum = 0;
+            for(size_t index = 0; index < CPPLOGS_STATS_STRIPES; index++)
+            {
+                sum += _values[index * STRIDE + i].load(std::memory_order_relaxed);
+            }
+            return sum;
+        }
+    private:
+        //每个槽位的计数器个数向上取整到整个缓存行
+        static const size_t STRIDE = (N + 7) / 8 * 8;
+        std::atomic<uint64_t>* _values;
+    };
+
+    class SinkStats
+    {
+    public:
+        SinkStats()
+        : _queued(0)
+        {
+            for(auto& bucket : _latency)
+            {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+        void onWrite(size_t bytes)
+        {
+            _counters.add(RECORDS);
+            _counters.add(BYTES, bytes);
+        }
+        void onError()
+        {
+            _counters.add(ERRORS);
+        }
+        void onRoll()
+        {
+            _counters.add(ROLLS);
+        }
+        void onDrop()
+        {
+            _counters.add(DROPS);
+        }
+        void onSpill(size_t bytes)
+        {
+            _counters.add(SPILLS, bytes);
+        }
+        void setQueued(size_t bytes)
+        {
+            _queued.store(bytes, std::memory_order_relaxed);
+        }
+        //本次落地是否需要计时（按线程抽样）
+        static bool sample()
+        {
+            static thread_local uint32_t count = 0;
+            return (++count & (CPPLOGS_STATS_SAMPLE - 1)) == 0;
+        }
+        void onLatency(uint64_t ns)
+        {
+            size_t bucket = 0;
+            while(ns > 1 && bucket + 1 < CPPLOGS_STATS_BUCKETS)
+            {
+                ns >>= 1;
+                bucket++;
+            }
+            _latency[bucket].fetch_add(1, std::memory_order_relaxed);
+        }
+        void snapshot(cpplogs::SinkStatsSnapshot& snap) const
+        {
+            snap.records = _counters.load(RECORDS);
+            snap.bytes = _counters.load(BYTES);
+            snap.errors = _counters.load(ERRORS);
+            snap.rolls = _counters.load(ROLLS);
+            snap.dropped = _counters.load(DROPS);
+            snap.spilled = _counters.load(SPILLS);
+            snap.queued = _queued.load(std::memory_order_relaxed);
+            for(size_t i = 0; i < CPPLOGS_STATS_BUCKETS; i++)
+            {
+                snap.latency[i] = _latency[i].load(std::memory_order_relaxed);
+            }
+        }
+    private:
+        enum { RECORDS, BYTES, ERRORS, ROLLS, DROPS, SPILLS, COUNTERS };
+        cpplogs::StripedCounters<COUNTERS> _counters;
+        std::atomic<uint64_t> _queued;
+        std::atomic<uint64_t> _latency[CPPLOGS_STATS_BUCKETS];
+    };
+
+    class LoggerStats
+    {
+    public:
+        void onAccept(cpplogs::LogLevel::value level)
+        {
+            _counters.add(static_cast<size_t>(level));
+        }
+        void onFilter(cpplogs::LogLevel::value level)
+        {
+#if CPPLOGS_STATS_FILTERED
+            _counters.add(CPPLOGS_STATS_LEVELS + static_cast<size_t>(level));
+#else
+            (void)level;
+#endif
+        }
+        void snapshot(cpplogs::LoggerStatsSnapshot& snap) const
+        {
+            for(size_t i = 0; i < CPPLOGS_STATS_LEVELS; i++)
+            {
+                snap.accepted[i] = _counters.load(i);
+                snap.filtered[i] = _counters.load(CPPLOGS_STATS_LEVELS + i);
+            }
+        }
+    private:
+        cpplogs::StripedCounters<CPPLOGS_STATS_LEVELS * 2> _counters;//前半为接受条数，后半为过滤条数
+    };
+#else
+    //统计关闭：接口保留，均为空函数
+    class SinkStats
+    {
+    public:
+        void onWrite(size_t) {}
+        void onError() {}
+        void onRoll() {}
+        void onDrop() {}
+        void onSpill(size_t) {}
+        void setQueued(size_t) {}
+        static bool sample() { return false; }
+        void onLatency(uint64_t) {}
+        void snapshot(cpplogs::SinkStatsSnapshot& snap) const
+        {
+            snap.records = snap.bytes = snap.errors = snap.rolls = 0;
+            snap.dropped = snap.spilled = snap.queued = 0;
+            for(auto& bucket : snap.latency)
+            {
+                bucket = 0;
+            }
+        }
+    };
+
+    class LoggerStats
+    {
+    public:
+        void onAccept(cpplogs::LogLevel::value) {}
+        void onFilter(cpplogs::LogLevel::value) {}
+        void snapshot(cpplogs::LoggerStatsSnapshot& snap) const
+        {
+            for(size_t i = 0; i < CPPLOGS_STATS_LEVELS; i++)
+            {
+                snap.accepted[i] = snap.filtered[i] = 0;
+            }
+        }
+    };
+#endif
+}
+
+#endif
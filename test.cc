@@ -1,8 +1,68 @@
+//编译期裁剪：低于 INFO 的 LOG_DEBUG 展开为空语句
+#define CPPLOGS_ACTIVE_LEVEL CPPLOGS_LEVEL_INFO
+#include "cpplogs.hpp"
 #include "util.hpp"
 #include "level.hpp"
 #include "message.hpp"
 #include "format.hpp"
+#include "static_format.hpp"
 #include "sink.hpp"
+#include "logger.hpp"
+#include "mmap_sink.hpp"
+#include "compress.hpp"
+#include "json_format.hpp"
+#include "reader.hpp"
+#include "flight_recorder.hpp"
+#include "async_sink.hpp"
+#include "parallel.hpp"
+#include "socket_sink.hpp"
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <dirent.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+//统计堆内存分配次数，用于验证零分配格式化
+static std::atomic<size_t> g_alloc_count(0);
+void* operator new(size_t size)
+{
+    g_alloc_count++;
+    void* ptr = malloc(size == 0 ? 1 : size);
+    if(ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+//自定义类型的 {} 格式化
+struct Point
+{
+    int x;
+    int y;
+};
+namespace cpplogs
+{
+    template<>
+    struct Formatter<Point>
+    {
+        static void format(cpplogs::Buffer& out, const Point& p)
+        {
+            out.push('(');
+            cpplogs::Formatter<int>::format(out, p.x);
+            out.push(',');
+            cpplogs::Formatter<int>::format(out, p.y);
+            out.push(')');
+        }
+    };
+}
 
 int main()
 {
@@ -26,6 +86,80 @@ int main()
     cpplogs::Formmatter fmt;
     std::string str = fmt.format(msg);
     std::cout << str << std::endl;
+    //编译期特化的格式化器，输出应与运行时解析的结果一致
+    CPPLOGS_STATIC_FORMMATTER("[%d{%H:%M:%S}][%t][%c][%f:%l][%p]%T%m%n") static_fmt;
+    assert(static_fmt.format(msg) == str);
+
+    //毫秒级时间：秒数不变时复用缓存，只替换小数部分
+    cpplogs::util::Date::setClock(cpplogs::util::ClockType::REALTIME_COARSE);
+    cpplogs::Formmatter ms_fmt("%d{%Y-%m-%d %H:%M:%S.%ms}|%d{%us}%n");
+    cpplogs::LogMsg ms_msg(cpplogs::LogLevel::value::INFO, __LINE__, __FILE__, "root", "TestTime");
+    std::string ms_str = ms_fmt.format(ms_msg);
+    assert(ms_str.size() == strlen("2025-01-01 00:00:00.000|000000\n"));
+    assert(ms_str == ms_fmt.format(ms_msg));
+    std::cout << ms_str;
+    cpplogs::util::Date::setClock(cpplogs::util::ClockType::REALTIME);
+
+    //零分配格式化：缓冲区复用后，format(Buffer&) 不应再分配内存
+    cpplogs::Buffer buf(256);
+    fmt.format(buf, msg);
+    assert(std::string(buf.begin(), buf.readAbleSize()) == str);
+    size_t alloc_before = g_alloc_count;
+    for(int i = 0; i < 10000; i++)
+    {
+        buf.reset();
+        fmt.format(buf, msg);
+        static_fmt.format(buf, msg);
+    }
+    std::cout << "format(Buffer&) 10000 次新增分配次数: " << g_alloc_count - alloc_before << std::endl;
+    assert(g_alloc_count == alloc_before);
+
+    //结构化输出：SIMD 查找的结果与逐字节实现一致，转义结果为合法的 JSON
+    {
+        char bytes[256];
+        srand(1);
+        for(int round = 0; round < 2000; round++)
+        {
+            for(auto& c : bytes)
+            {
+                c = rand() % 8 == 0 ? static_cast<char>(rand() % 256) : static_cast<char>('a' + rand() % 26);
+            }
+            size_t off = rand() % 64;
+            size_t len = rand() % (sizeof(bytes) - off);
+            assert(cpplogs::detail::plainPrefix(bytes + off, len) == cpplogs::detail::plainPrefixScalar(bytes + off, len));
+        }
+        cpplogs::Buffer json(256);
+        const char raw[] = "q\"b\\n\nt\tc\x01中文\xff\xe4\xb8" "end";
+        cpplogs::JsonEscape::escape(json, raw, sizeof(raw) - 1);
+        assert(std::string(json.begin(), json.readAbleSize()) == "q\\\"b\\\\n\\nt\\tc\\u0001中文\\ufffd\\ufffd\\ufffdend");
+
+        cpplogs::JsonFormmatter json_fmt("%Y");
+        cpplogs::LogfmtFormmatter logfmt_fmt("%Y");
+        cpplogs::LogMsg json_msg(cpplogs::LogLevel::value::WARN, 12, "a.cc", "root", "say \"hi\"");
+        json_msg._tid = 7;
+        json_msg._ctime = 0;
+        cpplogs::ScopedField request("request_id", "r-1");
+        {
+            cpplogs::ScopedField user("user", "bob smith");
+            std::string line = json_fmt.format(json_msg);
+            std::cout << line;
+            assert(line == "{\"time\":\"1970\",\"level\":\"WARN\",\"thread\":7,\"logger\":\"root\",\"file\":\"a.cc\",\"line\":12,"
+                "\"msg\":\"say \\\"hi\\\"\",\"request_id\":\"r-1\",\"user\":\"bob smith\"}\n");
+            line = logfmt_fmt.format(json_msg);
+            std::cout << line;
+            assert(line == "time=1970 level=WARN thread=7 logger=root file=a.cc line=12 msg=\"say \\\"hi\\\"\" request_id=r-1 user=\"bob smith\"\n");
+        }
+        assert(cpplogs::LogFields::size() == 1);
+        //字段的字符串在弹出后保留容量，格式化不分配内存
+        size_t before = g_alloc_count;
+        for(int i = 0; i < 1000; i++)
+        {
+            json.reset();
+            json_fmt.format(json, json_msg);
+            logfmt_fmt.format(json, json_msg);
+        }
+        assert(g_alloc_count == before);
+    }
 
     /*
     cpplogs::LogSink::ptr stdout_pls = cpplogs::SinkFactory::create<cpplogs::StdoutSink>();
@@ -51,6 +185,7 @@ int main()
         sleep(1);
     }
     */
+    /*
     cpplogs::LogSink::ptr time_pls = cpplogs::SinkFactory::create<cpplogs::RollSinkByTime>("./test_log/timeroll-", 5);
     time_t oldtime = cpplogs::util::Date::getTime();
     while(cpplogs::util::Date::getTime() < oldtime + 20)
@@ -58,5 +193,1249 @@ int main()
         time_pls->log(str.c_str(), str.size());
         sleep(1);
     }
+    */
+
+    //内存映射落地：滚动大小落在映射块中间时，关闭的文件被截断为实际长度
+    {
+        auto readFile = [](const std::string& pathname) {
+            std::ifstream ifs(pathname, std::ios::binary);
+            return std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        };
+        //清理上次运行留下的文件
+        cpplogs::util::File::createDirectory("./test_log/");
+        remove("./test_log/mmap.log");
+        DIR* dir = opendir("./test_log");
+        for(struct dirent* ent = dir == nullptr ? nullptr : readdir(dir); ent != nullptr; ent = readdir(dir))
+        {
+            if(strncmp(ent->d_name, "mmap-roll-", strlen("mmap-roll-")) == 0)
+            {
+                remove(("./test_log/" + std::string(ent->d_name)).c_str());
+            }
+        }
+        if(dir != nullptr)
+        {
+            closedir(dir);
+        }
+        const size_t count = 10000;
+        std::string expect;
+        for(size_t i = 0; i < count; i++)
+        {
+            expect += str;
+        }
+        {
+            cpplogs::LogSink::ptr mmap_pls = cpplogs::SinkFactory::create<cpplogs::MmapFileSink>("./test_log/mmap.log", 4096);
+            cpplogs::LogSink::ptr mmap_roll_pls = cpplogs::SinkFactory::create<cpplogs::MmapRollSinkBySize>("./test_log/mmap-roll-", 100 * 1024, 64 * 1024);
+            for(size_t i = 0; i < count; i++)
+            {
+                mmap_pls->log(str.c_str(), str.size());
+                mmap_roll_pls->log(str.c_str(), str.size());
+            }
+            //刷新不改变内容，映射区域的数据对读取者立即可见；打开期间文件长度是整块大小
+            mmap_pls->flush();
+            mmap_roll_pls->flush();
+            std::string data = readFile("./test_log/mmap.log");
+            assert(data.size() % 4096 == 0 && data.size() > expect.size() && data.compare(0, expect.size(), expect) == 0);
+        }
+        //关闭后文件长度等于写入的长度，预分配的块被截断
+        assert(readFile("./test_log/mmap.log") == expect);
+        //超过 100K 后在下一次写入前滚动（位于第二个 64K 块的中间），每个关闭的文件截断为整条日志的长度
+        const size_t per_file = (100 * 1024 + str.size() - 1) / str.size() * str.size();
+        std::vector<size_t> sizes;
+        dir = opendir("./test_log");
+        for(struct dirent* ent = dir == nullptr ? nullptr : readdir(dir); ent != nullptr; ent = readdir(dir))
+        {
+            if(strncmp(ent->d_name, "mmap-roll-", strlen("mmap-roll-")) == 0)
+            {
+                std::string data = readFile("./test_log/" + std::string(ent->d_name));
+                assert(data == expect.substr(0, data.size()));
+                sizes.push_back(data.size());
+            }
+        }
+        if(dir != nullptr)
+        {
+            closedir(dir);
+        }
+        std::sort(sizes.begin(), sizes.end());
+        assert(sizes.size() == (expect.size() + per_file - 1) / per_file);
+        assert(sizes[0] == expect.size() - (sizes.size() - 1) * per_file);
+        for(size_t i = 1; i < sizes.size(); i++)
+        {
+            assert(sizes[i] == per_file);
+        }
+        //上次未正常关闭：文件长度恰好是整块大小，再次打开时去掉末尾残留的 '\0' 后继续追加
+        {
+            std::ofstream ofs("./test_log/mmap.log", std::ios::binary | std::ios::trunc);
+            ofs << "before crash\n";
+        }
+        assert(truncate("./test_log/mmap.log", 8192) == 0);
+        {
+            cpplogs::MmapFileSink reopened("./test_log/mmap.log", 4096);
+            reopened.log("after reopen\n", strlen("after reopen\n"));
+        }
+        assert(readFile("./test_log/mmap.log") == "before crash\nafter reopen\n");
+    }
+
+    //刷新策略与批量写入
+    {
+        const std::string pathname = "./test_log/flush.log";
+        remove(pathname.c_str());
+        auto fileSize = [&pathname]() {
+            struct stat st;
+            return stat(pathname.c_str(), &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+        };
+        std::string line = "flush policy line\n";
+        cpplogs::FileSink fsink(pathname, cpplogs::FlushPolicy(4096, 3));
+        fsink.log(line.c_str(), line.size(), cpplogs::LogLevel::value::INFO);
+        fsink.log(line.c_str(), line.size(), cpplogs::LogLevel::value::INFO);
+        assert(fileSize() == 0);//未达到条数，仍在缓存中
+        fsink.log(line.c_str(), line.size(), cpplogs::LogLevel::value::INFO);
+        assert(fileSize() == 3 * line.size());//达到条数，写入文件
+        fsink.log(line.c_str(), line.size(), cpplogs::LogLevel::value::ERROR);
+        assert(fileSize() == 4 * line.size());//错误日志立即写入
+
+        std::vector<struct iovec> iov(100);
+        for(auto& v : iov)
+        {
+            v.iov_base = const_cast<char*>(line.c_str());
+            v.iov_len = line.size();
+        }
+        fsink.log(iov.data(), iov.size());
+        assert(fileSize() == 104 * line.size());//超过字节阈值，一次 writev 写入
+        fsink.log(iov.data(), 2);
+        fsink.flush();
+        assert(fileSize() == 106 * line.size());
+
+        //异步日志器按批次落地时同样遵守落地方向的刷新策略，析构时写出剩余的缓存
+        remove(pathname.c_str());
+        {
+            std::vector<cpplogs::LogSink::ptr> policy_sinks;
+            policy_sinks.push_back(cpplogs::SinkFactory::create<cpplogs::FileSink>(pathname, cpplogs::FlushPolicy(4096)));
+            cpplogs::AsyncLogger policy_logger("flush", cpplogs::LogLevel::value::DEBUG,
+                std::make_shared<cpplogs::Formmatter>("%m%n"), policy_sinks);
+            policy_logger.info(__FILE__, __LINE__, "%s", "flush policy line");
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            assert(fileSize() == 0);//批次已落地，未达到字节阈值，仍在缓存中
+            policy_logger.error(__FILE__, __LINE__, "%s", "flush policy line");
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            assert(fileSize() == 2 * line.size());//批次中有错误日志，立即写入
+            policy_logger.info(__FILE__, __LINE__, "%s", "flush policy line");
+        }
+        assert(fileSize() == 3 * line.size());
+    }
+
+    //滚动文件后台压缩与边写边压缩
+    {
+        std::string line = "compress line 0123456789 abcdefghijklmnopqrstuvwxyz\n";
+        cpplogs::Compressor::ptr compressor = std::make_shared<cpplogs::Compressor>();
+        {
+            cpplogs::RollSinkBySize roll_sink("./test_log/gz-roll-", 64 * 1024);
+            roll_sink.setRollCallback(cpplogs::Compressor::rollCallback(compressor));
+            for(int i = 0; i < 10000; i++)
+            {
+                roll_sink.log(line.c_str(), line.size());
+            }
+        }
+        compressor->wait();
+        cpplogs::CompressStats st = compressor->stats();
+        std::cout << "压缩文件数: " << st.compressed << ", " << st.bytes_in << " -> " << st.bytes_out << " 字节" << std::endl;
+        assert(st.compressed > 0 && st.compressed == st.submitted && st.failed == 0);
+        assert(st.bytes_out < st.bytes_in);
+
+        const std::string gz_path = "./test_log/stream.log.gz";
+        remove(gz_path.c_str());
+        {
+            cpplogs::GzipFileSink gz_sink(gz_path, cpplogs::FlushPolicy(4096));
+            for(int i = 0; i < 1000; i++)
+            {
+                gz_sink.log(line.c_str(), line.size());
+            }
+        }
+        //多个 gzip 成员连续解压，内容应与写入的一致
+        gzFile gz = gzopen(gz_path.c_str(), "rb");
+        assert(gz != nullptr);
+        std::string content;
+        char gz_buf[4096];
+        int n = 0;
+        while((n = gzread(gz, gz_buf, sizeof(gz_buf))) > 0)
+        {
+            content.append(gz_buf, n);
+        }
+        gzclose(gz);
+        assert(content.size() == 1000 * line.size());
+        assert(content.compare(0, line.size(), line) == 0);
+    }
+
+    //同步日志器
+    cpplogs::Formmatter::ptr fmt_ptr = std::make_shared<cpplogs::Formmatter>();
+    std::vector<cpplogs::LogSink::ptr> sinks;
+    sinks.push_back(cpplogs::SinkFactory::create<cpplogs::StdoutSink>());
+    sinks.push_back(cpplogs::SinkFactory::create<cpplogs::FileSink>("./test_log/sync.log"));
+    cpplogs::Logger::ptr sync_logger = std::make_shared<cpplogs::SyncLogger>("sync", cpplogs::LogLevel::value::INFO, fmt_ptr, sinks);
+    sync_logger->debug(__FILE__, __LINE__, "%s", "被过滤的调试日志");
+    sync_logger->info(__FILE__, __LINE__, "%s-%d", "同步日志", 1);
+    sync_logger->error(__FILE__, __LINE__, "%s-%d", "同步日志", 2);
+
+    //调用点宏：编译期裁剪的调试日志与运行期等级不足的日志都不求值参数
+    {
+        int evaluated = 0;
+        LOG_DEBUG(sync_logger, "%d", ++evaluated);//编译期裁剪
+        cpplogs::Logger* raw_logger = sync_logger.get();
+        raw_logger->setLevel(cpplogs::LogLevel::value::ERROR);
+        LOG_INFO(raw_logger, "%d", ++evaluated);//运行期跳过
+        assert(evaluated == 0);
+        LOG_ERROR(raw_logger, "%s-%d", "宏日志", ++evaluated);
+        assert(evaluated == 1);
+        raw_logger->setLevel(cpplogs::LogLevel::value::INFO);
+        LOG_WARN(sync_logger, "宏日志-无可变参数");
+    }
+
+    //运行时增删落地方向：记录日志的线程不受影响
+    {
+        struct CountSink : public cpplogs::LogSink
+        {
+            std::atomic<size_t> count{0};
+            void log(const char* data, size_t len) override
+            {
+                count++;
+            }
+        };
+        std::vector<cpplogs::LogSink::ptr> no_sinks;
+        cpplogs::SyncLogger rcu_logger("rcu", cpplogs::LogLevel::value::DEBUG, fmt_ptr, no_sinks);
+        std::shared_ptr<CountSink> count_sink = std::make_shared<CountSink>();
+        std::atomic<bool> running(true);
+        std::thread writer([&]() {
+            while(running)
+            {
+                rcu_logger.info(__FILE__, __LINE__, "%s", "快照替换");
+            }
+        });
+        for(int i = 0; i < 100; i++)
+        {
+            rcu_logger.addSink(count_sink);
+            rcu_logger.removeSink(count_sink);
+        }
+        rcu_logger.addSink(count_sink);
+        running = false;
+        writer.join();
+        assert(rcu_logger.sinks().size() == 1);
+        size_t before = count_sink->count;
+        rcu_logger.info(__FILE__, __LINE__, "%s", "快照替换");
+        assert(count_sink->count == before + 1);
+        //被移除的落地方向不再被任何快照引用，立即释放
+        assert(count_sink.use_count() == 2);
+        rcu_logger.removeSink(count_sink);
+        assert(count_sink.use_count() == 1);
+    }
+
+    //日志消息不持有字符串，同步日志器写文件的路径上稳定状态下不分配内存
+    {
+        std::vector<cpplogs::LogSink::ptr> file_sinks;
+        file_sinks.push_back(cpplogs::SinkFactory::create<cpplogs::FileSink>("./test_log/noalloc.log"));
+        cpplogs::SyncLogger file_logger("noalloc", cpplogs::LogLevel::value::DEBUG, fmt_ptr, file_sinks);
+        file_logger.info(__FILE__, __LINE__, "%s-%d", "预热", 0);
+        size_t before = g_alloc_count;
+        for(int i = 0; i < 1000; i++)
+        {
+            file_logger.info(__FILE__, __LINE__, "%s-%d", "零分配日志", i);
+        }
+        std::cout << "SyncLogger 1000 条日志新增分配次数: " << g_alloc_count - before << std::endl;
+        assert(g_alloc_count == before);
+    }
+
+    //{} 风格格式化：类型安全，直接写入缓冲区，支持自定义类型
+    {
+        static_assert(cpplogs::detail::countPlaceholders("a{}b{{c}}{}") == 2, "countPlaceholders");
+        static_assert(cpplogs::detail::countPlaceholders("a{b") == cpplogs::detail::INVALID_PLACEHOLDERS, "countPlaceholders");
+        cpplogs::Buffer brace(64);
+        std::string name = "cpplogs";
+        Point pt = { 3, -4 };
+        int value = 0x10;
+        cpplogs::BraceFormat::format(brace, "{} {} {} {} {} {{{}}} {} {} {} {}", 42, -7, 1.25, 0.1, true, name, "lit", 'c', pt, -1234567890123LL, 2.0f);
+        std::string result(brace.begin(), brace.readAbleSize());
+        std::cout << result << std::endl;
+        assert(result == "42 -7 1.25 0.1 true {cpplogs} lit c (3,-4) -1234567890123");
+        brace.reset();
+        cpplogs::BraceFormat::format(brace, "{} {} {}", 1e20, &value);
+        result.assign(brace.begin(), brace.readAbleSize());
+        assert(result.compare(0, 6, "1e+20 ") == 0 && result.compare(6, 2, "0x") == 0 && result.substr(result.size() - 3) == " {}");
+
+        std::vector<cpplogs::LogSink::ptr> fmt_sinks;
+        fmt_sinks.push_back(cpplogs::SinkFactory::create<cpplogs::FileSink>("./test_log/brace.log"));
+        cpplogs::SyncLogger brace_logger("brace", cpplogs::LogLevel::value::DEBUG, fmt_ptr, fmt_sinks);
+        brace_logger.info(cpplogs::Fmt("user {} took {} ms"), name, 12.5);
+        LOG_WARN_FMT(&brace_logger, "point {} id {}", pt, 7);
+        LOG_ERROR_FMT(sync_logger, "{{}} 宏日志 {}", 3);
+        size_t before = g_alloc_count;
+        for(int i = 0; i < 1000; i++)
+        {
+            LOG_INFO_FMT(&brace_logger, "零分配 {} {} {}", i, 0.5, "str");
+        }
+        std::cout << "{} 风格 1000 条日志新增分配次数: " << g_alloc_count - before << std::endl;
+        assert(g_alloc_count == before);
+    }
+
+    //二进制日志模式：./cpplogs-decode 还原的文本与文本模式的输出一致（多个线程同时首次使用调用点）
+    {
+        const std::string bin_pattern = "[%c][%f:%l][%p]%T%m%n";
+        auto emit = [](cpplogs::Logger& logger, int t) {
+            for(int i = 0; i < 3; i++)
+            {
+                logger.info(__FILE__, __LINE__, "int:%d long:%ld str:%s double:%.3f width:[%*d] 100%%", i, 1234567890123L, "abc", 3.14159, 5, t);
+                logger.warn(__FILE__, __LINE__, "%-8s|%08.2lf|%c|%p", "left", 2.5, 'x', (void*)0x1234);
+            }
+            logger.error(__FILE__, __LINE__, "无参数的日志 %d", t);
+            LOG_INFO_FMT(&logger, "{} 风格的日志 {} {}", "二进制模式", 1.5, t);
+        };
+        auto run = [&](cpplogs::Logger& logger) {
+            std::vector<std::thread> threads;
+            for(int t = 0; t < 4; t++)
+            {
+                threads.emplace_back([&, t](){ emit(logger, t); });
+            }
+            for(auto& th : threads)
+            {
+                th.join();
+            }
+        };
+        auto readLines = [](FILE* fp) {
+            std::vector<std::string> lines;
+            char line[1024];
+            while(fgets(line, sizeof(line), fp) != nullptr)
+            {
+                lines.push_back(line);
+            }
+            std::sort(lines.begin(), lines.end());
+            return lines;
+        };
+        remove("./test_log/binary.log");
+        remove("./test_log/binary.txt");
+        {
+            std::vector<cpplogs::LogSink::ptr> bin_sinks;
+            bin_sinks.push_back(cpplogs::SinkFactory::create<cpplogs::FileSink>("./test_log/binary.log"));
+            cpplogs::SyncLogger bin_logger("binary", cpplogs::LogLevel::value::DEBUG, std::make_shared<cpplogs::Formmatter>(bin_pattern), bin_sinks);
+            bin_logger.enableBinary();
+            run(bin_logger);
+            std::vector<cpplogs::LogSink::ptr> text_sinks;
+            text_sinks.push_back(cpplogs::SinkFactory::create<cpplogs::FileSink>("./test_log/binary.txt"));
+            cpplogs::SyncLogger text_logger("binary", cpplogs::LogLevel::value::DEBUG, std::make_shared<cpplogs::Formmatter>(bin_pattern), text_sinks);
+            run(text_logger);
+        }
+        FILE* decoded = popen(("./cpplogs-decode -p '" + bin_pattern + "' ./test_log/binary.log").c_str(), "r");
+        assert(decoded != nullptr);
+        std::vector<std::string> decoded_lines = readLines(decoded);
+        assert(pclose(decoded) == 0);
+        FILE* text = fopen("./test_log/binary.txt", "r");
+        assert(text != nullptr);
+        std::vector<std::string> text_lines = readLines(text);
+        fclose(text);
+        assert(text_lines.size() == 4 * 8);
+        assert(decoded_lines == text_lines);
+        //每个调用点只登记一次
+        std::ifstream ifs("./test_log/binary.log", std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        size_t sites = 0;
+        for(size_t pos = data.find("int:%d long:%ld"); pos != std::string::npos; pos = data.find("int:%d long:%ld", pos + 1))
+        {
+            sites++;
+        }
+        assert(sites == 1);
+    }
+
+    //运行时统计：各等级接受/过滤条数、落地字节数与滚动次数，StatsDumper 定期输出
+    {
+        std::vector<cpplogs::LogSink::ptr> stats_sinks;
+        stats_sinks.push_back(cpplogs::SinkFactory::create<cpplogs::RollSinkBySize>("./test_log/stats-", 4 * 1024));
+        cpplogs::Logger::ptr stats_logger = std::make_shared<cpplogs::SyncLogger>("stats", cpplogs::LogLevel::value::INFO, fmt_ptr, stats_sinks);
+        for(int i = 0; i < 100; i++)
+        {
+            LOG_INFO(stats_logger, "统计 %d", i);
+            LOG_WARN_FMT(stats_logger, "统计 {}", i);
+            stats_logger->debug(__FILE__, __LINE__, "被过滤 %d", i);
+        }
+        cpplogs::LoggerStatsSnapshot snap = stats_logger->stats();
+        assert(snap.sinks.size() == 1);
+#if CPPLOGS_STATS
+        assert(snap.accepted[static_cast<size_t>(cpplogs::LogLevel::value::INFO)] == 100);
+        assert(snap.accepted[static_cast<size_t>(cpplogs::LogLevel::value::WARN)] == 100);
+#if CPPLOGS_STATS_FILTERED
+        assert(snap.filtered[static_cast<size_t>(cpplogs::LogLevel::value::DEBUG)] == 100);
+#else
+        //默认不统计被过滤的日志
+        assert(snap.filtered[static_cast<size_t>(cpplogs::LogLevel::value::DEBUG)] == 0);
+#endif
+        assert(snap.sinks[0].records == 200);
+        assert(snap.sinks[0].bytes > 200);
+        assert(snap.sinks[0].rolls > 0);
+        assert(snap.sinks[0].errors == 0);
+#endif
+        {
+            cpplogs::StatsDumper dumper(stats_logger, cpplogs::SinkFactory::create<cpplogs::FileSink>("./test_log/stats.log"), 10);
+            std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        }
+        std::cout << snap.toString();
+    }
+
+    //稀疏索引：按等级跳过不含 ERROR 的块，按时间范围定位
+    {
+        {
+            std::shared_ptr<cpplogs::RollSinkBySize> index_sink = std::make_shared<cpplogs::RollSinkBySize>("./test_log/index-", 64 * 1024 * 1024);
+            index_sink->enableIndex(1024);
+            std::vector<cpplogs::LogSink::ptr> index_sinks(1, index_sink);
+            cpplogs::SyncLogger index_logger("index", cpplogs::LogLevel::value::DEBUG, fmt_ptr, index_sinks);
+            for(int i = 0; i < 1000; i++)
+            {
+                if(i == 500)
+                {
+                    index_logger.error(__FILE__, __LINE__, "索引-%d", i);
+                    continue;
+                }
+                index_logger.info(__FILE__, __LINE__, "索引-%d", i);
+            }
+        }
+        //落地方向析构时结束最后一个块
+        std::string index_log;
+        DIR* dir = opendir("./test_log");
+        for(struct dirent* ent = readdir(dir); ent != nullptr; ent = readdir(dir))
+        {
+            std::string name = ent->d_name;
+            if(name.compare(0, 6, "index-") == 0 && name.size() > 4 && name.compare(name.size() - 4, 4, ".log") == 0)
+            {
+                index_log = "./test_log/" + name;
+            }
+        }
+        closedir(dir);
+        cpplogs::LogIndex index;
+        assert(index.load(index_log));
+        assert(index.entries().size() > 10);
+        uint64_t now_ms = static_cast<uint64_t>(time(nullptr)) * 1000;
+        std::vector<cpplogs::IndexRange> ranges = index.find(0, now_ms + 1000, cpplogs::LogLevel::value::ERROR);
+        assert(ranges.size() == 1);
+        std::string block;
+        assert(cpplogs::LogIndex::read(index_log, ranges[0], block));
+        assert(block.find("[ERROR]\t索引-500") != std::string::npos);
+        assert(block.size() < 4096);
+        //时间范围之外没有块
+        assert(index.find(0, index.entries().front().time_ms - 2000).empty());
+    }
+
+    //按调用点限流：令牌桶、抽样、重复折叠，被丢弃的数量以报告输出
+    {
+        struct LineSink : public cpplogs::LogSink
+        {
+            std::vector<std::string> lines;
+            void log(const char* data, size_t len) override
+            {
+                lines.emplace_back(data, len);
+            }
+        };
+        std::shared_ptr<LineSink> line_sink = std::make_shared<LineSink>();
+        std::vector<cpplogs::LogSink::ptr> limit_sinks(1, line_sink);
+        {
+            cpplogs::SyncLogger limit_logger("limit", cpplogs::LogLevel::value::DEBUG, fmt_ptr, limit_sinks);
+            limit_logger.setLimit(cpplogs::LogLevel::value::WARN, cpplogs::LimitPolicy(1, 5));
+            limit_logger.setLimit(cpplogs::LogLevel::value::INFO, cpplogs::LimitPolicy(0, 0, 10));
+            limit_logger.setLimit(cpplogs::LogLevel::value::ERROR, cpplogs::LimitPolicy(0, 0, 0, true));
+            for(int i = 0; i < 1000; i++)
+            {
+                LOG_WARN(&limit_logger, "限流 %d", i);
+            }
+            assert(line_sink->lines.size() == 5);
+            line_sink->lines.clear();
+            for(int i = 0; i < 100; i++)
+            {
+                LOG_INFO_FMT(&limit_logger, "抽样 {}", i);
+            }
+            assert(line_sink->lines.size() == 10);
+            line_sink->lines.clear();
+            for(int i = 0; i < 51; i++)
+            {
+                LOG_ERROR(&limit_logger, "重复 %s", i < 50 ? "同一条消息" : "另一条消息");
+            }
+            assert(line_sink->lines.size() == 3);
+            assert(line_sink->lines[1].find("last message repeated 49 times") != std::string::npos);
+            line_sink->lines.clear();
+#if CPPLOGS_STATS
+            //报告与普通日志一样计入接受条数，被丢弃/折叠的日志不计入
+            cpplogs::LoggerStatsSnapshot limit_snap = limit_logger.stats();
+            assert(limit_snap.accepted[static_cast<size_t>(cpplogs::LogLevel::value::WARN)] == 5);
+            assert(limit_snap.accepted[static_cast<size_t>(cpplogs::LogLevel::value::INFO)] == 10);
+            assert(limit_snap.accepted[static_cast<size_t>(cpplogs::LogLevel::value::ERROR)] == 2 + 1);
+#endif
+        }
+        //析构时输出限流与抽样的报告，时长为窗口实际经过的时间
+        assert(line_sink->lines.size() == 2);
+        for(auto& line : line_sink->lines)
+        {
+            std::cout << line;
+            unsigned long long ms = 0, us = 0;
+            size_t pos = line.find("in last ");
+            assert(pos != std::string::npos && sscanf(line.c_str() + pos, "in last %llu.%3llu ms", &ms, &us) == 2);
+            assert(ms * 1000 + us > 0);
+        }
+        assert(line_sink->lines[0].find("suppressed 995 records") != std::string::npos
+            || line_sink->lines[1].find("suppressed 995 records") != std::string::npos);
+    }
+
+    //零拷贝读取：按顺序读取滚动文件集合，不完整的最后一行等写完后返回，跟踪写入与滚动
+    {
+        //清理上次运行留下的文件
+        DIR* dir = opendir("./test_log");
+        for(struct dirent* ent = dir == nullptr ? nullptr : readdir(dir); ent != nullptr; ent = readdir(dir))
+        {
+            std::string name = ent->d_name;
+            if(name.compare(0, 7, "reader-") == 0 || name == "reader.log")
+            {
+                unlink(("./test_log/" + name).c_str());
+            }
+        }
+        if(dir != nullptr)
+        {
+            closedir(dir);
+        }
+        auto expect = [](const cpplogs::LogRecordView& record, int i){
+            std::string tail = "\t读取-" + std::to_string(i);
+            return record.len >= tail.size() && std::string(record.data + record.len - tail.size(), tail.size()) == tail;
+        };
+        std::shared_ptr<cpplogs::RollSinkBySize> reader_sink = std::make_shared<cpplogs::RollSinkBySize>("./test_log/reader-", 4096,
+            cpplogs::FlushPolicy::immediate());
+        std::vector<cpplogs::LogSink::ptr> reader_sinks(1, reader_sink);
+        cpplogs::SyncLogger reader_logger("reader", cpplogs::LogLevel::value::DEBUG, fmt_ptr, reader_sinks);
+        for(int i = 0; i < 200; i++)
+        {
+            reader_logger.info(__FILE__, __LINE__, "读取-%d", i);
+        }
+        cpplogs::LogReader reader("./test_log/reader-");
+        assert(reader.files().size() > 1);
+        cpplogs::LogRecordView record;
+        int count = 0;
+        while(reader.next(record))
+        {
+            assert(expect(record, count));
+            count++;
+        }
+        assert(count == 200);
+        //修改时间被改变（压缩、备份、touch）不影响顺序，顺序只由文件名决定
+        {
+            std::vector<std::string> files = reader.files();
+            utimensat(AT_FDCWD, files.front().c_str(), nullptr, 0);
+            cpplogs::LogReader touched("./test_log/reader-");
+            assert(touched.files() == files);
+            int touched_count = 0;
+            while(touched.next(record))
+            {
+                assert(expect(record, touched_count));
+                touched_count++;
+            }
+            assert(touched_count == 200);
+        }
+        //跟踪：另一个线程继续写入，期间发生多次滚动
+        assert(reader.follow(0));
+        std::thread writer([&](){
+            for(int i = 200; i < 400; i++)
+            {
+                reader_logger.info(__FILE__, __LINE__, "读取-%d", i);
+                if(i % 20 == 0)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                }
+            }
+        });
+        while(count < 400)
+        {
+            if(reader.next(record))
+            {
+                assert(expect(record, count));
+                count++;
+                continue;
+            }
+            reader.follow(1000);
+        }
+        writer.join();
+        assert(!reader.next(record));
+
+        //正在写入的文件：最后一行没有换行符时不返回
+        cpplogs::FileSink partial_sink("./test_log/reader.log", cpplogs::FlushPolicy::immediate());
+        cpplogs::LogReader partial_reader("./test_log/reader.log");
+        partial_sink.log("完整的一行\n不完整", strlen("完整的一行\n不完整"));
+        assert(partial_reader.next(record) && std::string(record.data, record.len) == "完整的一行");
+        assert(!partial_reader.next(record));
+        partial_sink.log("的一行\n", strlen("的一行\n"));
+        assert(partial_reader.next(record) && std::string(record.data, record.len) == "不完整的一行");
+        assert(!partial_reader.next(record));
+    }
+
+    //飞行记录仪：日志只保留在内存中，ERROR 或显式触发时写出之前的日志；进程崩溃后下次启动时恢复
+    {
+        struct LineSink : public cpplogs::LogSink
+        {
+            std::vector<std::string> lines;
+            void log(const char* data, size_t len) override
+            {
+                lines.emplace_back(data, len);
+            }
+        };
+        std::shared_ptr<LineSink> line_sink = std::make_shared<LineSink>();
+        std::vector<cpplogs::LogSink::ptr> targets(1, line_sink);
+        unlink("./test_log/flight.rec");
+        {
+            cpplogs::FlightRecorderSink::ptr recorder = std::make_shared<cpplogs::FlightRecorderSink>("./test_log/flight.rec", 64 * 1024, 10, targets);
+            std::vector<cpplogs::LogSink::ptr> flight_sinks(1, recorder);
+            cpplogs::SyncLogger flight_logger("flight", cpplogs::LogLevel::value::DEBUG, fmt_ptr, flight_sinks);
+            for(int i = 0; i < 100; i++)
+            {
+                flight_logger.debug(__FILE__, __LINE__, "飞行-%d", i);
+            }
+            assert(line_sink->lines.empty());
+            assert(recorder->records() == 10);
+            flight_logger.error(__FILE__, __LINE__, "出错");
+            assert(line_sink->lines.size() == 10);
+            assert(line_sink->lines[0].find("\t飞行-91\n") != std::string::npos);
+            assert(line_sink->lines[9].find("[ERROR]\t出错") != std::string::npos);
+            assert(recorder->records() == 0);
+            //多次绕过缓冲区末尾后，保留的仍是最近的日志
+            line_sink->lines.clear();
+            for(int i = 0; i < 5000; i++)
+            {
+                flight_logger.debug(__FILE__, __LINE__, "飞行-%d", i);
+            }
+            recorder->trigger();
+            assert(line_sink->lines.size() == 10);
+            for(int i = 0; i < 10; i++)
+            {
+                assert(line_sink->lines[i].find("\t飞行-" + std::to_string(4990 + i) + "\n") != std::string::npos);
+            }
+        }
+        //子进程按字节数保留日志后崩溃
+        pid_t pid = fork();
+        if(pid == 0)
+        {
+            struct rlimit no_core = {0, 0};
+            setrlimit(RLIMIT_CORE, &no_core);
+            cpplogs::FlightRecorderSink::ptr recorder = std::make_shared<cpplogs::FlightRecorderSink>("./test_log/flight.rec", 4096, 0,
+                std::vector<cpplogs::LogSink::ptr>());
+            cpplogs::FlightRecorderSink::installCrashHandler();
+            std::vector<cpplogs::LogSink::ptr> flight_sinks(1, recorder);
+            cpplogs::SyncLogger flight_logger("flight", cpplogs::LogLevel::value::DEBUG, fmt_ptr, flight_sinks);
+            for(int i = 0; i < 1000; i++)
+            {
+                flight_logger.debug(__FILE__, __LINE__, "崩溃前-%d", i);
+            }
+            abort();
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        assert(WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT);
+        line_sink->lines.clear();
+        {
+            cpplogs::FlightRecorderSink recovered("./test_log/flight.rec", 4096, 0, targets);
+            assert(recovered.records() == 0);
+        }
+        assert(line_sink->lines.size() > 10);
+        assert(line_sink->lines[0].find("recovered " + std::to_string(line_sink->lines.size() - 1) + " records") != std::string::npos);
+        assert(line_sink->lines[0].find("(signal " + std::to_string(SIGABRT) + ")") != std::string::npos);
+        assert(line_sink->lines.back().find("\t崩溃前-999\n") != std::string::npos);
+        size_t recovered_bytes = 0;
+        for(size_t i = 1; i < line_sink->lines.size(); i++)
+        {
+            recovered_bytes += line_sink->lines[i].size();
+        }
+        assert(recovered_bytes <= 4096);
+        //正常析构后再次打开没有需要恢复的日志
+        line_sink->lines.clear();
+        {
+            cpplogs::FlightRecorderSink reopened("./test_log/flight.rec", 4096, 0, targets);
+        }
+        assert(line_sink->lines.empty());
+        //安装前已有的处理函数在同步映射区之后被调用（重复安装不覆盖保存的处理函数）
+        pid = fork();
+        if(pid == 0)
+        {
+            signal(SIGABRT, [](int){ _exit(42); });
+            cpplogs::FlightRecorderSink::ptr recorder = std::make_shared<cpplogs::FlightRecorderSink>("./test_log/flight.rec", 4096, 0,
+                std::vector<cpplogs::LogSink::ptr>());
+            cpplogs::FlightRecorderSink::installCrashHandler();
+            cpplogs::FlightRecorderSink::installCrashHandler();
+            recorder->log("原有处理函数\n", strlen("原有处理函数\n"));
+            raise(SIGABRT);
+            _exit(0);
+        }
+        waitpid(pid, &status, 0);
+        assert(WIFEXITED(status) && WEXITSTATUS(status) == 42);
+        {
+            cpplogs::FlightRecorderSink recovered("./test_log/flight.rec", 4096, 0, targets);
+        }
+        assert(line_sink->lines.size() == 2);
+        assert(line_sink->lines[0].find("(signal " + std::to_string(SIGABRT) + ")") != std::string::npos);
+        assert(line_sink->lines[1] == "原有处理函数\n");
+    }
+
+    //独立队列的落地方向：慢速的落地方向不会拖慢同一日志器的其他落地方向，队列满时按策略丢弃或溢出到磁盘
+    {
+        struct SlowSink : public cpplogs::LogSink
+        {
+            SlowSink(std::string* out)
+            : _out(out)
+            {}
+            void log(const char* data, size_t len) override
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                _out->append(data, len);
+            }
+            std::string* _out;
+        };
+        //按行取出日志的序号
+        auto numbers = [](const std::string& out){
+            std::vector<int> result;
+            size_t pos = 0;
+            while((pos = out.find("队列-", pos)) != std::string::npos)
+            {
+                pos += strlen("队列-");
+                result.push_back(atoi(out.c_str() + pos));
+            }
+            return result;
+        };
+        std::string drop_out, spill_out, below_out;
+        uint64_t dropped = 0;
+        size_t fast_lines = 0;
+        {
+            std::shared_ptr<cpplogs::AsyncSink<SlowSink>> drop_sink = std::make_shared<cpplogs::AsyncSink<SlowSink>>(
+                cpplogs::AsyncSinkPolicy::dropNewest(4096), &drop_out);
+            std::shared_ptr<cpplogs::AsyncSink<SlowSink>> spill_sink = std::make_shared<cpplogs::AsyncSink<SlowSink>>(
+                cpplogs::AsyncSinkPolicy::spill("./test_log/spill.tmp", 4096), &spill_out);
+            std::shared_ptr<cpplogs::AsyncSink<SlowSink>> below_sink = std::make_shared<cpplogs::AsyncSink<SlowSink>>(
+                cpplogs::AsyncSinkPolicy::dropBelow(cpplogs::LogLevel::value::WARN, 4096), &below_out);
+            cpplogs::LogSink::ptr fast_sink = cpplogs::SinkFactory::create<cpplogs::FileSink>("./test_log/queue.log");
+            std::vector<cpplogs::LogSink::ptr> queue_sinks = { drop_sink, spill_sink, below_sink, fast_sink };
+            cpplogs::SyncLogger queue_logger("queue", cpplogs::LogLevel::value::DEBUG, fmt_ptr, queue_sinks);
+            auto begin = std::chrono::steady_clock::now();
+            for(int i = 0; i < 2000; i++)
+            {
+                if(i % 100 == 99)
+                {
+                    queue_logger.warn(__FILE__, __LINE__, "队列-%d", i);
+                }
+                else
+                {
+                    queue_logger.info(__FILE__, __LINE__, "队列-%d", i);
+                }
+            }
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - begin).count();
+            //不经过队列时每条日志至少 5ms（共 10s 以上）
+            std::cout << "慢速落地方向 + 独立队列 2000 条日志耗时: " << elapsed << "ms" << std::endl;
+            assert(elapsed < 2000);
+            cpplogs::SinkStatsSnapshot snap;
+            drop_sink->stats().snapshot(snap);
+            dropped = snap.dropped;
+            assert(dropped > 0);
+            spill_sink->stats().snapshot(snap);
+            assert(snap.spilled > 0);
+            assert(drop_sink->name() == "async:sink");
+            fast_sink->stats().snapshot(snap);
+            fast_lines = snap.records;
+        }
+        //析构时队列与溢出文件中的日志全部写出
+        assert(fast_lines == 2000);
+        std::vector<int> drop_numbers = numbers(drop_out);
+        assert(drop_numbers.size() + dropped == 2000);
+        for(size_t i = 1; i < drop_numbers.size(); i++)
+        {
+            assert(drop_numbers[i] > drop_numbers[i - 1]);
+        }
+        std::vector<int> spill_numbers = numbers(spill_out);
+        assert(spill_numbers.size() == 2000);
+        for(int i = 0; i < 2000; i++)
+        {
+            assert(spill_numbers[i] == i);
+        }
+        assert(!cpplogs::util::File::exists("./test_log/spill.tmp"));
+        std::vector<int> below_numbers = numbers(below_out);
+        size_t warns = 0;
+        for(int n : below_numbers)
+        {
+            warns += n % 100 == 99;
+        }
+        assert(warns == 20);
+    }
+
+    //并行格式化：多个工作线程格式化批次，按追加顺序写出
+    {
+        struct StringSink : public cpplogs::LogSink
+        {
+            std::string data;
+            void log(const char* d, size_t len) override
+            {
+                data.append(d, len);
+            }
+        };
+        std::shared_ptr<StringSink> string_sink = std::make_shared<StringSink>();
+        std::vector<cpplogs::LogSink::ptr> parallel_sinks(1, string_sink);
+        {
+            //批次很小，保证每个工作线程都分到批次并发生窃取
+            cpplogs::ParallelAsyncLogger parallel_logger("parallel", cpplogs::LogLevel::value::DEBUG,
+                std::make_shared<cpplogs::Formmatter>("%c|%p|%m%n"), parallel_sinks, 4, cpplogs::AsyncType::ASYNC_BLOCK, 256);
+            std::vector<std::thread> threads;
+            for(int i = 0; i < 8; i++)
+            {
+                threads.emplace_back([&, i](){
+                    for(int j = 0; j < 5000; j++)
+                    {
+                        if(j % 1000 == 999)
+                        {
+                            LOG_WARN_FMT(&parallel_logger, "thread-{} count-{}", i, j);
+                        }
+                        else
+                        {
+                            LOG_INFO(&parallel_logger, "thread-%d count-%d", i, j);
+                        }
+                    }
+                });
+            }
+            for(auto& th : threads)
+            {
+                th.join();
+            }
+        }
+        //每个线程的日志保持调用顺序
+        std::vector<int> next(8, 0);
+        size_t lines = 0;
+        size_t pos = 0;
+        while(pos < string_sink->data.size())
+        {
+            size_t end = string_sink->data.find('\n', pos);
+            std::string line = string_sink->data.substr(pos, end - pos);
+            pos = end + 1;
+            int thread_id = -1, count = -1;
+            char level[8] = {0};
+            assert(sscanf(line.c_str(), "parallel|%7[A-Z]|thread-%d count-%d", level, &thread_id, &count) == 3);
+            assert(count == next[thread_id]++);
+            assert(std::string(level) == (count % 1000 == 999 ? "WARN" : "INFO"));
+            lines++;
+        }
+        assert(lines == 40000);
+
+        //调用者线程的字段随日志输出，工作线程格式化后不残留
+        string_sink->data.clear();
+        {
+            cpplogs::ParallelAsyncLogger json_logger("parallel", cpplogs::LogLevel::value::DEBUG,
+                std::make_shared<cpplogs::JsonFormmatter>("%Y"), parallel_sinks, 2, cpplogs::AsyncType::ASYNC_BLOCK, 256);
+            std::vector<std::thread> threads;
+            for(int i = 0; i < 4; i++)
+            {
+                threads.emplace_back([&, i](){
+                    cpplogs::ScopedField request("request_id", "r-" + std::to_string(i));
+                    for(int j = 0; j < 200; j++)
+                    {
+                        if(j % 2 == 0)
+                        {
+                            cpplogs::ScopedField user("user", "u" + std::to_string(j));
+                            LOG_INFO(&json_logger, "thread-%d count-%d", i, j);
+                        }
+                        else
+                        {
+                            LOG_INFO(&json_logger, "thread-%d count-%d", i, j);
+                        }
+                    }
+                });
+            }
+            for(auto& th : threads)
+            {
+                th.join();
+            }
+            LOG_INFO(&json_logger, "main");
+        }
+        lines = 0;
+        pos = 0;
+        while(pos < string_sink->data.size())
+        {
+            size_t end = string_sink->data.find('\n', pos);
+            std::string line = string_sink->data.substr(pos, end - pos);
+            pos = end + 1;
+            lines++;
+            int thread_id = -1, count = -1;
+            size_t msg = line.find("\"msg\":\"");
+            assert(msg != std::string::npos);
+            if(sscanf(line.c_str() + msg, "\"msg\":\"thread-%d count-%d\"", &thread_id, &count) != 2)
+            {
+                assert(line.substr(msg) == "\"msg\":\"main\"}");
+                continue;
+            }
+            std::string expect = "\"msg\":\"thread-" + std::to_string(thread_id) + " count-" + std::to_string(count)
+                + "\",\"request_id\":\"r-" + std::to_string(thread_id) + "\"";
+            if(count % 2 == 0)
+            {
+                expect += ",\"user\":\"u" + std::to_string(count) + "\"";
+            }
+            assert(line.substr(msg) == expect + "}");
+        }
+        assert(lines == 801);
+    }
+
+    //滚动辅助线程：下一个文件提前准备（切换前目录中不可见），旧文件在辅助线程中关闭并调用滚动回调；按时间滚动由辅助线程判断边界
+    {
+        auto list = [](const std::string& prefix){
+            std::vector<std::string> names;
+            DIR* dir = opendir("./test_log");
+            for(struct dirent* ent = dir == nullptr ? nullptr : readdir(dir); ent != nullptr; ent = readdir(dir))
+            {
+                std::string name = ent->d_name;
+                if(name.compare(0, prefix.size(), prefix) == 0)
+                {
+                    names.push_back("./test_log/" + name);
+                }
+            }
+            if(dir != nullptr)
+            {
+                closedir(dir);
+            }
+            return names;
+        };
+        for(auto& name : list("helper-"))
+        {
+            unlink(name.c_str());
+        }
+        std::mutex rolled_mutex;
+        std::vector<std::string> rolled;
+        bool rolled_in_caller = false;
+        std::thread::id caller = std::this_thread::get_id();
+        cpplogs::RollCallback roll_cb = [&](const std::string& pathname){
+            std::unique_lock<std::mutex> lock(rolled_mutex);
+            rolled.push_back(pathname);
+            rolled_in_caller = rolled_in_caller || std::this_thread::get_id() == caller;
+            //让辅助线程关闭之后的旧文件时明显晚于写入新文件的时间
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        };
+        std::string line(99, 'r');
+        line += '\n';
+        {
+            cpplogs::RollSinkBySize size_sink("./test_log/helper-size-", 4096, cpplogs::FlushPolicy::immediate());
+            size_sink.setRollCallback(roll_cb);
+            size_sink.setSyncOnRoll(true);
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            assert(list("helper-size-").size() == 1);//准备好的文件尚未使用，没有文件名
+            //准备文件之后过一段时间再切换：新文件名取切换的时间，而不是准备的时间
+            std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+            std::string switch_time = cpplogs::util::File::rollName("", time(nullptr), 0).substr(0, 14);
+            std::string first = list("helper-size-")[0];
+            for(int i = 0; i < 160; i++)
+            {
+                size_sink.log(line.c_str(), line.size());
+            }
+            for(auto& pathname : list("helper-size-"))
+            {
+                std::string file_time = pathname.substr(strlen("./test_log/helper-size-"), 14);
+                assert(pathname == first || file_time >= switch_time);
+            }
+        }
+        //4096 字节 41 条一个文件，160 条共 4 个文件，3 次滚动；析构时回调全部完成
+        assert(list("helper-size-").size() == 4);
+        assert(rolled.size() == 3);
+        struct timespec prev_mtime = { 0, 0 };
+        for(auto& pathname : rolled)
+        {
+            //释放预留空间不改变修改时间：已滚动的文件按滚动顺序不晚于之后的文件
+            struct stat st;
+            assert(stat(pathname.c_str(), &st) == 0 && st.st_size == 41 * 100);
+            assert(st.st_mtim.tv_sec > prev_mtime.tv_sec
+                || (st.st_mtim.tv_sec == prev_mtime.tv_sec && st.st_mtim.tv_nsec >= prev_mtime.tv_nsec));
+            prev_mtime = st.st_mtim;
+        }
+        for(auto& pathname : list("helper-size-"))
+        {
+            struct stat st;
+            if(std::find(rolled.begin(), rolled.end(), pathname) != rolled.end())
+            {
+                continue;
+            }
+            assert(stat(pathname.c_str(), &st) == 0);
+            assert(st.st_mtim.tv_sec > prev_mtime.tv_sec
+                || (st.st_mtim.tv_sec == prev_mtime.tv_sec && st.st_mtim.tv_nsec >= prev_mtime.tv_nsec));
+        }
+        {
+            cpplogs::RollSinkByTime time_sink("./test_log/helper-time-", 1, cpplogs::FlushPolicy::immediate());
+            time_sink.setRollCallback(roll_cb);
+            for(int i = 0; i < 25; i++)
+            {
+                time_sink.log(line.c_str(), line.size());
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+        }
+        std::vector<std::string> time_files = list("helper-time-");
+        assert(time_files.size() >= 3);
+        assert(rolled.size() == 3 + time_files.size() - 1);
+        assert(!rolled_in_caller);
+        size_t total = 0;
+        for(auto& pathname : time_files)
+        {
+            struct stat st;
+            assert(stat(pathname.c_str(), &st) == 0);
+            total += st.st_size;
+        }
+        assert(total == 25 * line.size());
+    }
+
+    //套接字落地：本机收集进程的替身接收数据，对端不存在时记录保留在队列中，连接后按顺序发送
+    {
+        auto bindUnix = [](int type, const std::string& path){
+            unlink(path.c_str());
+            int fd = socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
+            struct sockaddr_un addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            strcpy(addr.sun_path, path.c_str());
+            assert(fd >= 0 && bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0);
+            struct timeval tv = { 5, 0 };//接收超时，发送失败时测试不会一直等待
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            return fd;
+        };
+        //Unix 数据报：先写入，接收方后出现
+        {
+            std::string path = "./test_log/sock.dgram";
+            unlink(path.c_str());
+            cpplogs::SocketSink dgram_sink(cpplogs::SocketType::UNIX_DGRAM, path);
+            std::string batch;
+            for(int i = 0; i < 100; i++)
+            {
+                batch += "报文-" + std::to_string(i) + "\n";
+            }
+            dgram_sink.log(batch.c_str(), batch.size());//一批数据按行拆分为 100 个报文
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            int fd = bindUnix(SOCK_DGRAM, path);
+            for(int i = 0; i < 100; i++)
+            {
+                char buf[256];
+                ssize_t n = recv(fd, buf, sizeof(buf), 0);
+                assert(std::string(buf, n > 0 ? n : 0) == "报文-" + std::to_string(i));
+            }
+            ::close(fd);
+        }
+        //Unix 流 + 长度前缀：接收方断开后重连，之后的记录在新连接上收到
+        {
+            std::string path = "./test_log/sock.stream";
+            int listen_fd = bindUnix(SOCK_STREAM, path);
+            listen(listen_fd, 4);
+            auto readFrame = [](int fd, std::string& frame){
+                auto readAll = [&](char* p, size_t len){
+                    while(len > 0)
+                    {
+                        ssize_t n = ::read(fd, p, len);
+                        if(n <= 0)
+                        {
+                            return false;
+                        }
+                        p += n;
+                        len -= n;
+                    }
+                    return true;
+                };
+                uint32_t len;
+                if(!readAll(reinterpret_cast<char*>(&len), sizeof(len)))
+                {
+                    return false;
+                }
+                frame.resize(ntohl(len));
+                return readAll(&frame[0], frame.size());
+            };
+            std::shared_ptr<cpplogs::SocketSink> stream_sink = std::make_shared<cpplogs::SocketSink>(cpplogs::SocketType::UNIX_STREAM, path, true);
+            std::vector<cpplogs::LogSink::ptr> stream_sinks(1, stream_sink);
+            cpplogs::Formmatter::ptr msg_fmt = std::make_shared<cpplogs::Formmatter>("%m%n");
+            cpplogs::SyncLogger stream_logger("socket", cpplogs::LogLevel::value::DEBUG, msg_fmt, stream_sinks);
+            for(int i = 0; i < 1000; i++)
+            {
+                stream_logger.info(__FILE__, __LINE__, "帧-%d", i);
+            }
+            int conn = accept(listen_fd, nullptr, nullptr);
+            std::string frame;
+            for(int i = 0; i < 1000; i++)
+            {
+                assert(readFrame(conn, frame) && frame == "帧-" + std::to_string(i) + "\n");
+            }
+            //分帧时每次写入原样作为一条记录，不按换行符拆分
+            const char raw_record[] = "a\nb\0c\n";
+            stream_sink->log(raw_record, sizeof(raw_record) - 1);
+            assert(readFrame(conn, frame) && frame == std::string(raw_record, sizeof(raw_record) - 1));
+            ::close(conn);
+            //对端关闭后的第一次发送可能成功写入旧连接，随后发现断开并重连
+            conn = -1;
+            for(int i = 0; conn < 0 && i < 100; i++)
+            {
+                stream_logger.info(__FILE__, __LINE__, "重连-%d", i);
+                struct pollfd pfd = { listen_fd, POLLIN, 0 };
+                if(poll(&pfd, 1, 50) > 0)
+                {
+                    conn = accept(listen_fd, nullptr, nullptr);
+                }
+            }
+            assert(conn >= 0);
+            stream_logger.info(__FILE__, __LINE__, "%s", "重连之后");
+            bool found = false;
+            while(!found && readFrame(conn, frame))
+            {
+                found = frame == "重连之后\n";
+            }
+            assert(found);
+            ::close(conn);
+            ::close(listen_fd);
+        }
+        //UDP 回环
+        {
+            int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+            struct sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t addr_len = sizeof(addr);
+            assert(bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) == 0);
+            getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr), &addr_len);
+            struct timeval tv = { 5, 0 };
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            cpplogs::SocketSink udp_sink(cpplogs::SocketType::UDP, "127.0.0.1:" + std::to_string(ntohs(addr.sin_port)));
+            for(int i = 0; i < 50; i++)
+            {
+                std::string line = "udp-" + std::to_string(i) + "\n";
+                udp_sink.log(line.c_str(), line.size());
+            }
+            for(int i = 0; i < 50; i++)
+            {
+                char buf[256];
+                ssize_t n = recv(fd, buf, sizeof(buf), 0);
+                assert(std::string(buf, n > 0 ? n : 0) == "udp-" + std::to_string(i));
+            }
+            ::close(fd);
+        }
+        //对端一直不存在：队列有上限，超出的记录被丢弃，析构不等待
+        {
+            auto start = std::chrono::steady_clock::now();
+            {
+                cpplogs::SocketSink lost_sink(cpplogs::SocketType::UNIX_DGRAM, "./test_log/sock.none", false, 1024);
+                std::string line(99, 'x');
+                line += '\n';
+                for(int i = 0; i < 100; i++)
+                {
+                    lost_sink.log(line.c_str(), line.size());
+                }
+#if CPPLOGS_STATS
+                cpplogs::SinkStatsSnapshot snap;
+                lost_sink.stats().snapshot(snap);
+                assert(snap.dropped >= 100 - 2 * 1024 / 103);
+                assert(snap.queued <= 1024);
+#endif
+            }
+            assert(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(1000));
+        }
+    }
+
+    //全局日志器：建造者注册，无锁查找与线程缓存，按名称前缀修改等级时记录日志的线程不暂停
+    {
+        assert(cpplogs::rootLogger() && cpplogs::rootLogger()->name() == "root");
+        assert(cpplogs::getLogger("root") == cpplogs::rootLogger());
+        cpplogs::Logger::ptr http = cpplogs::GlobalLoggerBuilder().buildLoggerName("net.http")
+            .buildLoggerType(cpplogs::LoggerType::LOGGER_ASYNC).buildLoggerLevel(cpplogs::LogLevel::value::INFO)
+            .buildFormmater("[%c][%p]%T%m%n").buildSink<cpplogs::FileSink>("./test_log/manager.log").build();
+        cpplogs::GlobalLoggerBuilder().buildLoggerName("net.db").buildSink<cpplogs::FileSink>("./test_log/manager.log").build();
+        cpplogs::GlobalLoggerBuilder().buildLoggerName("disk").buildSink<cpplogs::FileSink>("./test_log/manager.log").build();
+        assert(cpplogs::getLogger("net.http") == http);
+        assert(cpplogs::getLogger(std::string("net.http")) == http);
+        assert(cpplogs::LoggerManager::getInstance().hasLogger("net.db"));
+        assert(!cpplogs::getLogger("net"));
+        LOG_INFO(cpplogs::getLogger("net.http"), "%s", "通过名称获取");
+        assert(cpplogs::LoggerManager::getInstance().setLevelByPrefix("net.", cpplogs::LogLevel::value::ERROR) == 2);
+        assert(http->level() == cpplogs::LogLevel::value::ERROR);
+        assert(cpplogs::getLogger("net.db")->level() == cpplogs::LogLevel::value::ERROR);
+        assert(cpplogs::getLogger("disk")->level() == cpplogs::LogLevel::value::DEBUG);
+        //查找与注册、修改等级同时进行：已注册的名称总能找到，线程缓存在表替换后不会返回旧的日志器
+        std::atomic<bool> done(false);
+        std::vector<std::thread> readers;
+        for(int t = 0; t < 4; t++)
+        {
+            readers.emplace_back([&](){
+                while(!done.load())
+                {
+                    const cpplogs::Logger::ptr& logger = cpplogs::getLogger("net.http");
+                    assert(logger && logger->name() == "net.http");
+                    LOG_DEBUG(logger, "%s", "等级不足");
+                }
+            });
+        }
+        for(int i = 0; i < 50; i++)
+        {
+            cpplogs::GlobalLoggerBuilder().buildLoggerName("worker." + std::to_string(i))
+                .buildSink<cpplogs::FileSink>("./test_log/manager.log").build();
+            cpplogs::LoggerManager::getInstance().setLevelByPrefix("net.", i % 2 ? cpplogs::LogLevel::value::WARN : cpplogs::LogLevel::value::ERROR);
+        }
+        done = true;
+        for(auto& reader : readers)
+        {
+            reader.join();
+        }
+        //std::string 版本不按地址缓存，内容不同的临时字符串复用同一地址时也能找到正确的日志器
+        for(int i = 0; i < 50; i++)
+        {
+            std::string name = "worker." + std::to_string(i);
+            assert(cpplogs::getLogger(name) && cpplogs::getLogger(name)->name() == name);
+        }
+        //同名的日志器再次注册时替换原来的日志器，线程缓存随之失效；旧表与被替换的日志器没有持有者后释放
+        cpplogs::Logger::ptr shared_disk = cpplogs::getSharedLogger("disk");
+        assert(shared_disk == cpplogs::getLogger("disk") && shared_disk.use_count() >= 2);
+        std::weak_ptr<cpplogs::Logger> old_disk = shared_disk;
+        shared_disk.reset();
+        cpplogs::Logger::ptr replaced = cpplogs::GlobalLoggerBuilder().buildLoggerName("disk")
+            .buildSink<cpplogs::FileSink>("./test_log/manager.log").build();
+        assert(cpplogs::getLogger("disk") == replaced);
+        assert(old_disk.expired());
+        assert(cpplogs::LoggerManager::getInstance().loggers().size() == 1 + 3 + 50);
+        //移除日志器：异步日志器随最后一个持有者析构，工作线程退出
+        std::weak_ptr<cpplogs::Logger> removed = http;
+        http.reset();
+        assert(cpplogs::LoggerManager::getInstance().removeLogger("net.http"));
+        assert(!cpplogs::getLogger("net.http"));
+        assert(removed.expired());
+        assert(!cpplogs::LoggerManager::getInstance().removeLogger("net.http"));
+        assert(!cpplogs::LoggerManager::getInstance().removeLogger("root"));
+        assert(cpplogs::LoggerManager::getInstance().loggers().size() == 1 + 2 + 50);
+    }
+
+    //异步日志器：多线程写入，析构时剩余日志全部落地；ASYNC_GROW 的缓冲区很小时扩容写入，不丢失日志
+    {
+        const cpplogs::AsyncType types[] = { cpplogs::AsyncType::ASYNC_BLOCK, cpplogs::AsyncType::ASYNC_GROW };
+        const size_t buffer_sizes[] = { 64 * 1024, 64 };
+        for(int t = 0; t < 2; t++)
+        {
+            const std::string pathname = "./test_log/async.log";
+            remove(pathname.c_str());
+            {
+                std::vector<cpplogs::LogSink::ptr> async_sinks;
+                async_sinks.push_back(cpplogs::SinkFactory::create<cpplogs::FileSink>(pathname));
+                cpplogs::Logger::ptr async_logger = std::make_shared<cpplogs::AsyncLogger>("async", cpplogs::LogLevel::value::DEBUG,
+                    std::make_shared<cpplogs::Formmatter>("%c|%m%n"), async_sinks, types[t], buffer_sizes[t]);
+                std::vector<std::thread> threads;
+                for(int i = 0; i < 8; i++)
+                {
+                    threads.emplace_back([&, i](){
+                        for(int j = 0; j < 10000; j++)
+                        {
+                            async_logger->info(__FILE__, __LINE__, "thread-%d count-%d", i, j);
+                        }
+                    });
+                }
+                for(auto& th : threads)
+                {
+                    th.join();
+                }
+            }
+            //日志器析构后读回：条数完整，每个线程的日志保持调用顺序
+            std::ifstream ifs(pathname);
+            std::vector<int> next(8, 0);
+            size_t lines = 0;
+            std::string line;
+            while(std::getline(ifs, line))
+            {
+                int thread_id = -1, count = -1;
+                assert(sscanf(line.c_str(), "async|thread-%d count-%d", &thread_id, &count) == 2);
+                assert(thread_id >= 0 && thread_id < 8 && count == next[thread_id]++);
+                lines++;
+            }
+            assert(lines == 80000);
+        }
+    }
     return 0;
 }
\ No newline at end of file
@@ -3,21 +3,35 @@
 
 /*
  * util.hpp 实用工具类的实现
- * 1. 获取系统时间
+ * 1. 获取系统时间（秒级，或通过可选时钟获取纳秒级时间）
  * 2. 判断文件是否存在
  * 3. 获取文件所在路径
  * 4. 创建目录
+ * 5. 整数转字符串（不经过 ostream，不分配内存）
+ * 6. 获取线程ID
 */
 
 #include <iostream>
 #include <ctime>
+#include <atomic>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <pthread.h>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
 
 namespace cpplogs
 {
     namespace util
     {
+        //时间源：REALTIME 精度高；REALTIME_COARSE 只读取内核缓存的时间，开销更小，精度为一个时钟节拍（通常 1~4ms）
+        enum class ClockType
+        {
+            REALTIME,
+            REALTIME_COARSE
+        };
+
         class Date
         {
         public:
@@ -26,6 +40,88 @@ namespace cpplogs
             {
                 return time(nullptr);
             }
+            //获取带纳秒部分的时间，使用 setClock 选择的时间源
+            static struct timespec getTimeSpec()
+            {
+                struct timespec ts;
+                clock_gettime(clockId().load(std::memory_order_relaxed), &ts);
+                return ts;
+            }
+            //设置 getTimeSpec 使用的时间源，全局生效
+            static void setClock(cpplogs::util::ClockType type)
+            {
+                clockId().store(type == cpplogs::util::ClockType::REALTIME_COARSE ? CLOCK_REALTIME_COARSE : CLOCK_REALTIME,
+                    std::memory_order_relaxed);
+            }
+        private:
+            static std::atomic<clockid_t>& clockId()
+            {
+                static std::atomic<clockid_t> clock_id(CLOCK_REALTIME);
+                return clock_id;
+            }
+        };
+
+        class Thread
+        {
+        public:
+            //当前线程ID，取 pthread_t 的值，与 std::thread::id 通过 ostream 输出的结果相同
+            static uint64_t id()
+            {
+                return static_cast<uint64_t>(pthread_self());
+            }
+        };
+
+        class Number
+        {
+        public:
+            //无符号整数转十进制字符串，写入 out（至少 20 字节），返回写入长度
+            static size_t toChars(char* out, uint64_t value)
+            {
+                static const char digits[] =
+                    "00010203040506070809"
+                    "10111213141516171819"
+                    "20212223242526272829"
+                    "30313233343536373839"
+                    "40414243444546474849"
+                    "50515253545556575859"
+                    "60616263646566676869"
+                    "70717273747576777879"
+                    "80818283848586878889"
+                    "90919293949596979899";
+                char tmp[20];
+                char* p = tmp + sizeof(tmp);
+                //每次处理两位数字，减少除法次数
+                while(value >= 100)
+                {
+                    size_t idx = (value % 100) * 2;
+                    value /= 100;
+                    *--p = digits[idx + 1];
+                    *--p = digits[idx];
+                }
+                if(value >= 10)
+                {
+                    size_t idx = value * 2;
+                    *--p = digits[idx + 1];
+                    *--p = digits[idx];
+                }
+                else
+                {
+                    *--p = static_cast<char>('0' + value);
+                }
+                size_t len = tmp + sizeof(tmp) - p;
+                memcpy(out, p, len);
+                return len;
+            }
+            //有符号整数转十进制字符串，写入 out（至少 21 字节），返回写入长度
+            static size_t toChars(char* out, int64_t value)
+            {
+                if(value >= 0)
+                {
+                    return toChars(out, static_cast<uint64_t>(value));
+                }
+                *out = '-';
+                return 1 + toChars(out + 1, static_cast<uint64_t>(0) - static_cast<uint64_t>(value));
+            }
         };
 
         class File
@@ -88,6 +184,22 @@ namespace cpplogs
                     }
                 }
             }
+
+            //滚动文件名：基础文件名 + 补零的本地时间 YYYYmmddHHMMSS + 序号（为 0 时省略）+ .log
+            //文件名按字典序即为滚动顺序（同一时间按序号），LogReader 据此排序
+            static std::string rollName(const std::string& basename, time_t t, size_t seq)
+            {
+                struct tm st;
+                localtime_r(&t, &st);
+                char buf[64];
+                int len = snprintf(buf, sizeof(buf), "%04d%02d%02d%02d%02d%02d", st.tm_year + 1900, st.tm_mon + 1,
+                    st.tm_mday, st.tm_hour, st.tm_min, st.tm_sec);
+                if(seq != 0)
+                {
+                    snprintf(buf + len, sizeof(buf) - len, "-%zu", seq);
+                }
+                return basename + buf + ".log";
+            }
         };
     }
 }